@@ -3,11 +3,17 @@ precision highp float;
 
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 color;
+layout (location = 2) in vec3 instance;  // offset and scale
+
+layout (std140) uniform frame {
+  mat4 view_projection;
+  vec4 tint;
+};
 
 out vec3 vertex_color;
 
 void main()
 {
-  gl_Position = vec4(position, 1.0);
-  vertex_color = color;
+  gl_Position = view_projection * vec4(position * instance.z + vec3(instance.xy, 0.0), 1.0);
+  vertex_color = color * tint.rgb;
 }
@@ -1,11 +1,30 @@
 #include "client.h"
 #include <ice/archive.h>
 #include <ice/exception.h>
+#include <algorithm>
 #include <array>
+#include <cmath>
 #include <cstdint>
+#include <cstring>
 
-client::client(const std::filesystem::path& path, GLsizei cx, GLsizei cy, GLint dpi) :
-  time_point_(clock::now())
+namespace {
+
+// Maximum number of damaged regions before they are merged into their bounding box.
+constexpr std::size_t max_damage = 8;
+
+// View projection matrix.
+constexpr GLfloat view_projection[] = {
+  1.0f, 0.0f, 0.0f, 0.0f,
+  0.0f, 1.0f, 0.0f, 0.0f,
+  0.0f, 0.0f, 1.0f, 0.0f,
+  0.0f, 0.0f, 0.0f, 1.0f,
+};
+
+}  // namespace
+
+client::client(const std::filesystem::path& path, GLsizei cx, GLsizei cy, GLint dpi, std::size_t objects) :
+  time_point_(clock::now()), cx_(cx), cy_(cy), uniforms_(4 * 1024),
+  scene_(&jobs_, 0.1f / std::sqrt(static_cast<float>(std::max(objects, std::size_t(1)))))
 {
   glViewport(0, 0, cx, cy);
   glClearColor(0.2f, 0.4f, 0.6f, 1.0f);
@@ -16,29 +35,53 @@ client::client(const std::filesystem::path& path, GLsizei cx, GLsizei cy, GLint
     gl::shader(archive.load<std::string>(u8"shaders/triangle.vert"), GL_VERTEX_SHADER),
     gl::shader(archive.load<std::string>(u8"shaders/triangle.frag"), GL_FRAGMENT_SHADER)
   };
+  frame_.attach(program_, "frame");
 
-  GLfloat vertices[] = {
-    // positions         // colors
-     0.5f, -0.5f, 0.0f,  1.0f, 0.0f, 0.0f,  // bottom right
-    -0.5f, -0.5f, 0.0f,  0.0f, 1.0f, 0.0f,  // bottom left
-     0.0f,  0.5f, 0.0f,  0.0f, 0.0f, 1.0f   // top
-  };
+  const auto data = archive.load<ice::archive::buffer>(u8"meshes/triangle.mesh");
+  mesh_ = gl::mesh(ice::mesh_view(data->data(), data->size()));
+
+  // Bounding sphere radius around the mesh origin.
+  const auto center = mesh_.center();
+  const auto radius = std::sqrt(center[0] * center[0] + center[1] * center[1] + center[2] * center[2]) + mesh_.radius();
 
-  vbo_ = gl::buffer(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+  // Create the scene. A single object is placed at the origin. More objects are placed on a grid
+  // of rows that is twice as wide and high as the view, so that about a quarter of them is visible.
+  if (objects <= 1) {
+    const auto entity = scene_.create();
+    scene_.mesh(entity, 0, 0, radius);
+  } else {
+    const auto side = static_cast<std::size_t>(std::ceil(std::sqrt(static_cast<double>(objects))));
+    const auto spacing = 4.0f / side;
+    for (std::size_t y = 0, count = 0; count < objects; y++) {
+      const auto row = scene_.create();
+      scene_.position(row, spacing * 0.5f - 2.0f, spacing * (y + 0.5f) - 2.0f, 0.0f);
+      for (std::size_t x = 0; x < side && count < objects; x++, count++) {
+        const auto entity = scene_.create(row);
+        scene_.position(entity, spacing * x, 0.0f, 0.0f);
+        scene_.scale(entity, spacing * 0.8f);
+        scene_.mesh(entity, 0, 0, radius);
+      }
+    }
+  }
+
+  // Instance offset and scale attributes.
+  instances_ = gl::stream(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(std::min(objects, std::size_t(4096)) * 3 * sizeof(GLfloat)));
 
   vao_ = gl::vao([&]() {
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+    // Position and color attributes.
+    mesh_.attributes();
+
+    glBindBuffer(GL_ARRAY_BUFFER, instances_);
 
-    // Position attribute.
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), reinterpret_cast<GLvoid*>(0));
-    glEnableVertexAttribArray(0);
+    // Instance offset and scale attribute.
+    gl::vertex_attribute(2, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), 0, 1);
 
-    // Color attribute.
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), reinterpret_cast<GLvoid*>(3 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(1);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
   });
 
   glReleaseShaderCompiler();
+
+  invalidate();
 }
 
 void client::render()
@@ -46,18 +89,122 @@ void client::render()
   auto tp = clock::now();
   auto dt = tp - time_point_.exchange(tp);
 
+  if (damage_.empty()) {
+    return;
+  }
+
+  // Restrict rendering to the damaged part of the frame.
+  const auto box = bounds();
+  const auto partial = box.x > 0 || box.y > 0 || box.cx < cx_ || box.cy < cy_;
+  if (partial) {
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(box.x, box.y, box.cx, box.cy);
+  }
+
+  // Cull the scene and stream the visible instances in draw order.
+  scene_.update();
+  queue_.clear();
+  scene_.cull(view_projection, queue_);
+  queue_.sort();
+  instance_data_.clear();
+  auto scale = 0.0f;
+  for (const auto& item : queue_.items()) {
+    const auto transform = scene_.world(item.entity);
+    instance_data_.push_back(transform.x);
+    instance_data_.push_back(transform.y);
+    instance_data_.push_back(transform.scale);
+    scale = std::max(scale, transform.scale);
+  }
+  instance_count_ = static_cast<GLsizei>(queue_.items().size());
+  if (instance_count_ > 0) {
+    instances_.write(instance_data_.data(), static_cast<GLsizeiptr>(instance_data_.size() * sizeof(GLfloat)));
+  }
+
   glClear(GL_COLOR_BUFFER_BIT);
 
-  glUseProgram(program_);
-  glBindVertexArray(vao_);
-  glDrawArrays(GL_TRIANGLES, 0, 3);
-  glBindVertexArray(0);
+  if (instance_count_ > 0) {
+    // Select the level of detail with an error below one pixel for the largest instance.
+    const auto lod = mesh_.select(2.0f / (cy_ * scale));
+
+    // Stage the frame uniforms in the next uniform buffer segment.
+    frame_block frame = {};
+    std::memcpy(&frame.view_projection, view_projection, sizeof(view_projection));
+    frame.tint = { 1.0f, 1.0f, 1.0f, 1.0f };
+    uniforms_.begin();
+    frame_.bind(uniforms_, frame_.push(uniforms_, frame));
+    uniforms_.flush();
+
+    glUseProgram(program_);
+    mesh_.draw(vao_, lod, instance_count_);
+    uniforms_.end();
+  }
+
+  if (partial) {
+    glDisable(GL_SCISSOR_TEST);
+  }
+  damage_.clear();
 }
 
 void client::resize(GLsizei cx, GLsizei cy)
 {
+  cx_ = cx;
+  cy_ = cy;
   glViewport(0, 0, cx, cy);
+  invalidate();
 }
 
 void client::scale(GLint dpi)
-{}
+{
+  invalidate();
+}
+
+void client::invalidate()
+{
+  invalidate({ 0, 0, cx_, cy_ });
+}
+
+void client::invalidate(const region& region)
+{
+  // Clip the region to the frame.
+  const auto x0 = std::max(region.x, 0);
+  const auto y0 = std::max(region.y, 0);
+  const auto x1 = std::min(region.x + region.cx, cx_);
+  const auto y1 = std::min(region.y + region.cy, cy_);
+  if (x1 <= x0 || y1 <= y0) {
+    return;
+  }
+
+  // Add the region and merge the regions when there are too many.
+  const auto clean = damage_.empty();
+  damage_.push_back({ x0, y0, x1 - x0, y1 - y0 });
+  if (damage_.size() > max_damage || (x1 - x0 == cx_ && y1 - y0 == cy_)) {
+    auto box = bounds();
+    damage_.assign(1, box);
+  }
+  if (clean && on_damage_) {
+    on_damage_();
+  }
+}
+
+client::region client::bounds() const noexcept
+{
+  if (damage_.empty()) {
+    return{};
+  }
+  auto x0 = damage_.front().x;
+  auto y0 = damage_.front().y;
+  auto x1 = x0 + damage_.front().cx;
+  auto y1 = y0 + damage_.front().cy;
+  for (const auto& region : damage_) {
+    x0 = std::min(x0, region.x);
+    y0 = std::min(y0, region.y);
+    x1 = std::max(x1, region.x + region.cx);
+    y1 = std::max(y1, region.y + region.cy);
+  }
+  return{ x0, y0, x1 - x0, y1 - y0 };
+}
+
+void client::on_damage(std::function<void()> handler)
+{
+  on_damage_ = std::move(handler);
+}
@@ -1,27 +1,95 @@
 #pragma once
 #include <gl/opengl.h>
-#include <gl/buffer.h>
+#include <gl/mesh.h>
 #include <gl/program.h>
+#include <gl/stream.h>
+#include <gl/uniform.h>
 #include <gl/vao.h>
+#include <ice/jobs.h>
+#include <ice/scene.h>
 #include <atomic>
 #include <chrono>
 #include <filesystem>
+#include <functional>
 #include <string>
+#include <vector>
+#include <cstddef>
 
 class client {
 public:
   using clock = std::chrono::high_resolution_clock;
 
-  client(const std::filesystem::path& path, GLsizei cx, GLsizei cy, GLint dpi);
+  // Frame buffer region with the origin at the bottom left.
+  struct region {
+    GLint x;
+    GLint y;
+    GLsizei cx;
+    GLsizei cy;
+  };
 
+  // Creates a client that draws the given number of objects. Larger scenes extend beyond the visible area.
+  client(const std::filesystem::path& path, GLsizei cx, GLsizei cy, GLint dpi, std::size_t objects = 1);
+
+  // Renders the damaged regions and clears the damage.
   void render();
   void resize(GLsizei cx, GLsizei cy);
 
   void scale(GLint dpi);
 
+  // Marks the whole frame or a region as changed.
+  void invalidate();
+  void invalidate(const region& region);
+
+  // Returns true if the next frame differs from the last rendered frame.
+  bool dirty() const noexcept
+  {
+    return !damage_.empty();
+  }
+
+  // Returns the regions that changed since the last rendered frame.
+  const std::vector<region>& damage() const noexcept
+  {
+    return damage_;
+  }
+
+  // Returns the bounding box of the damaged regions.
+  region bounds() const noexcept;
+
+  // Sets a handler that is called when a clean frame becomes dirty.
+  void on_damage(std::function<void()> handler);
+
+  // Returns the job scheduler of the render thread.
+  ice::jobs& jobs() noexcept
+  {
+    return jobs_;
+  }
+
 private:
+  // Per-frame uniform block of the triangle shader.
+  struct frame_block {
+    gl::std140::mat4 view_projection;
+    gl::std140::vec4 tint;
+  };
+
+  static_assert(gl::std140::member<decltype(frame_block::view_projection)>(offsetof(frame_block, view_projection)),
+    "Invalid std140 member: view_projection");
+  static_assert(gl::std140::member<decltype(frame_block::tint)>(offsetof(frame_block, tint)),
+    "Invalid std140 member: tint");
+
   std::atomic<clock::time_point> time_point_;
+  GLsizei cx_ = 0;
+  GLsizei cy_ = 0;
+  std::vector<region> damage_;
+  std::function<void()> on_damage_;
   gl::program program_;
-  gl::buffer vbo_;
+  gl::uniform_buffer uniforms_;
+  gl::uniform_block<frame_block> frame_{ 0 };
+  gl::mesh mesh_;
+  gl::stream instances_;
+  GLsizei instance_count_ = 0;
   gl::vao vao_;
+  ice::jobs jobs_;
+  ice::scene scene_;  // culling margin scales with the object spacing
+  ice::render_queue queue_;
+  std::vector<GLfloat> instance_data_;
 };
@@ -0,0 +1,261 @@
+#pragma once
+#include <gl/opengl.h>
+#include <gl/image.h>
+#include <ice/jobs.h>
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+namespace gl {
+
+// Reads frame buffer regions back asynchronously through a ring of pixel pack buffers.
+// read() queues the copy of a region into a free pack buffer followed by a fence and update() maps the
+// buffers whose fence signaled and passes the pixels to the handler on a worker thread of the job scheduler.
+// Buffers stay mapped until the handler returned and are then unmapped and reused by update(). When all
+// buffers are in use, read() waits for the oldest frame, so frames are never dropped.
+class capture {
+public:
+  // Receives the frame number and a view of the RGBA pixels with the bottom row first.
+  // The view is only valid until the handler returns.
+  using handler = std::function<void(std::size_t frame, const gl::image& image)>;
+
+  explicit capture(ice::jobs& jobs, handler handler, std::size_t count = 4) :
+    jobs_(jobs), handler_(std::move(handler)), slots_(std::max(count, std::size_t(1)))
+  {
+    // Reset the error information.
+    glGetError();
+
+    // Create the pack buffers.
+    for (auto& slot : slots_) {
+      glGenBuffers(1, &slot.buffer);
+    }
+    if (auto ec = gl::make_error()) {
+      destroy();
+      throw ice::runtime_error("Could not create the frame capture buffers.")
+        << ec.message() << "\nBuffers: " << slots_.size();
+    }
+  }
+
+  capture(capture&& other) = delete;
+  capture(const capture& other) = delete;
+
+  capture& operator=(capture&& other) = delete;
+  capture& operator=(const capture& other) = delete;
+
+  ~capture()
+  {
+    // Wait for the handlers, which use the mapped buffers.
+    for (auto& slot : slots_) {
+      if (slot.status == state::handling) {
+        try {
+          jobs_.wait(slot.handle);
+        }
+        catch (...) {
+        }
+      }
+    }
+    destroy();
+  }
+
+  // Queues a read of the region of the bound read frame buffer. Must be called on the render thread.
+  // Rethrows the exception of a handler if this call had to wait for it.
+  void read(GLint x, GLint y, GLsizei cx, GLsizei cy)
+  {
+    if (cx < 1 || cy < 1) {
+      return;
+    }
+
+    // Find a free buffer or wait for the oldest frame.
+    auto it = std::find_if(slots_.begin(), slots_.end(), [](const slot& slot) {
+      return slot.status == state::free;
+    });
+    if (it == slots_.end()) {
+      it = std::min_element(slots_.begin(), slots_.end(), [](const slot& lhs, const slot& rhs) {
+        return lhs.frame < rhs.frame;
+      });
+      stalls_++;
+      retire(*it);
+    }
+    auto& slot = *it;
+
+    // Reset the error information.
+    glGetError();
+
+    // Copy the pixels into the pack buffer and insert a fence after the copy.
+    const auto size = static_cast<GLsizeiptr>(cx) * cy * 4;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    if (slot.size < size) {
+      glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+      slot.size = size;
+    }
+    glReadPixels(x, y, cx, cy, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (auto ec = gl::make_error()) {
+      if (slot.fence) {
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+      }
+      slot.size = 0;
+      throw ice::runtime_error("Could not read the frame buffer into a capture buffer.")
+        << ec.message() << "\nRegion: " << x << ' ' << y << ' ' << cx << 'x' << cy;
+    }
+    slot.cx = cx;
+    slot.cy = cy;
+    slot.frame = frames_++;
+    slot.status = state::reading;
+  }
+
+  // Hands finished reads to the job scheduler and recycles buffers whose handler returned.
+  // Must be called on the render thread, e.g. once per frame. Rethrows the exceptions of handlers.
+  void update()
+  {
+    for (auto& slot : slots_) {
+      if (slot.status == state::reading) {
+        poll(slot, 0);
+      }
+    }
+    for (auto& slot : slots_) {
+      if (slot.status == state::handling && slot.handle->done()) {
+        retire(slot);
+      }
+    }
+  }
+
+  // Waits until all queued frames were handled. Rethrows the exception of the first failed handler.
+  void finish()
+  {
+    std::vector<slot*> pending;
+    for (auto& slot : slots_) {
+      if (slot.status != state::free) {
+        pending.push_back(&slot);
+      }
+    }
+    std::sort(pending.begin(), pending.end(), [](const slot* lhs, const slot* rhs) {
+      return lhs->frame < rhs->frame;
+    });
+    for (auto slot : pending) {
+      retire(*slot);
+    }
+  }
+
+  // Returns the number of queued frames.
+  std::size_t frames() const noexcept
+  {
+    return frames_;
+  }
+
+  // Returns the number of reads that had to wait for a free buffer.
+  // Use more buffers or more worker threads when this number grows.
+  std::size_t stalls() const noexcept
+  {
+    return stalls_;
+  }
+
+private:
+  enum class state {
+    free,      // unmapped and unused
+    reading,   // written by the GPU until the fence signals
+    handling,  // mapped and read by the handler
+  };
+
+  struct slot {
+    GLuint buffer = 0;
+    GLsizeiptr size = 0;
+    GLsync fence = nullptr;
+    void* data = nullptr;
+    GLsizei cx = 0;
+    GLsizei cy = 0;
+    std::size_t frame = 0;
+    ice::jobs::handle handle;
+    state status = state::free;
+  };
+
+  // Maps the buffer and starts the handler when the fence signals within the timeout in nanoseconds.
+  bool poll(slot& slot, GLuint64 timeout)
+  {
+    auto result = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+    if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) {
+      if (result == GL_WAIT_FAILED) {
+        auto ec = gl::make_error();
+        throw ice::runtime_error("Could not wait for a frame capture fence.") << ec.message();
+      }
+      return false;
+    }
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+
+    // Map the pixels for the handler.
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    const auto size = static_cast<GLsizeiptr>(slot.cx) * slot.cy * 4;
+    slot.data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (!slot.data) {
+      auto ec = gl::make_error();
+      slot.status = state::free;
+      throw ice::runtime_error("Could not map a frame capture buffer.") << ec.message();
+    }
+    const auto data = slot.data;
+    const auto cx = slot.cx;
+    const auto cy = slot.cy;
+    const auto frame = slot.frame;
+    slot.handle = jobs_.run([this, data, cx, cy, frame]() {
+      handler_(frame, gl::image(cx, cy, GL_RGBA, GL_UNSIGNED_BYTE, static_cast<const void*>(data)));
+    });
+    slot.status = state::handling;
+    return true;
+  }
+
+  // Waits for the frame in the buffer and frees the buffer. Rethrows the exception of the handler.
+  void retire(slot& slot)
+  {
+    if (slot.status == state::reading) {
+      while (!poll(slot, 1000000)) {
+      }
+    }
+    auto handle = std::move(slot.handle);
+    try {
+      jobs_.wait(handle);
+    }
+    catch (...) {
+      unmap(slot);
+      throw;
+    }
+    unmap(slot);
+  }
+
+  void unmap(slot& slot)
+  {
+    if (slot.data) {
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+      glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+      slot.data = nullptr;
+    }
+    slot.status = state::free;
+  }
+
+  void destroy()
+  {
+    for (auto& slot : slots_) {
+      unmap(slot);
+      if (slot.fence) {
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+      }
+      if (glIsBuffer(slot.buffer)) {
+        glDeleteBuffers(1, &slot.buffer);
+      }
+      slot.buffer = 0;
+      slot.size = 0;
+    }
+  }
+
+  ice::jobs& jobs_;
+  handler handler_;
+  std::vector<slot> slots_;
+  std::size_t frames_ = 0;
+  std::size_t stalls_ = 0;
+};
+
+}  // namespace gl
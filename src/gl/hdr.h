@@ -0,0 +1,31 @@
+#pragma once
+#include <gl/opengl.h>
+#include <gl/image.h>
+#include <ice/hdr.h>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace gl {
+
+// Decodes a Radiance RGBE image (.hdr) into a GL_RGB image of the given type, which should be
+// GL_UNSIGNED_INT_5_9_9_9_REV or GL_UNSIGNED_INT_10F_11F_11F_REV for lighting data (4 bytes per pixel),
+// GL_HALF_FLOAT or GL_FLOAT. Rows are converted as they are decoded and stored from top to bottom.
+// Throws ice::runtime_error if the data is invalid or the type is not supported.
+inline gl::image read_hdr(const std::uint8_t* data, std::size_t size, GLenum type = GL_UNSIGNED_INT_5_9_9_9_REV)
+{
+  ice::hdr_reader reader(data, size);
+  const auto cx = static_cast<GLsizei>(reader.cx());
+  const auto cy = static_cast<GLsizei>(reader.cy());
+  gl::image image(cx, cy, GL_RGB, type);
+  std::vector<float> row(reader.cx() * 3);
+  const gl::image src(cx, 1, GL_RGB, GL_FLOAT, static_cast<const void*>(row.data()));
+  for (GLsizei y = 0; y < cy; y++) {
+    reader.read(row.data());
+    auto dst = image.region(0, y, cx, 1);
+    gl::blit(src, dst);
+  }
+  return image;
+}
+
+}  // namespace gl
@@ -1,27 +1,127 @@
 #pragma once
 #include <gl/opengl.h>
+#include <ice/pixels.h>
+#include <ice/resample.h>
 #include <iomanip>
 #include <ostream>
 #include <vector>
+#include <cstddef>
 #include <cstdint>
 
 namespace gl {
 
-// Format             | Type                      | Data     | Size
-// -------------------+---------------------------+----------+---------------------------
-// GL_ALPHA           | GL_UNSIGNED_BYTE          | uint8_t  | cx * cy
-// -------------------+---------------------------+----------+---------------------------
-// GL_RGB             | GL_UNSIGNED_BYTE          | uint8_t  | cx * cy * 3
-//                    | GL_UNSIGNED_SHORT_5_6_5   | uint16_t | cx * cy * sizeof(uint16_t)
-// -------------------+---------------------------+----------+----------------------------
-// GL_RGBA            | GL_UNSIGNED_BYTE          | uint8_t  | cx * cy * 4
-//                    | GL_UNSIGNED_SHORT_4_4_4_4 | uint16_t | cx * cy * sizeof(uint16_t)
-//                    | GL_UNSIGNED_SHORT_5_5_5_1 | uint16_t | cx * cy * sizeof(uint16_t)
-// -------------------+---------------------------+----------+----------------------------
-// GL_LUMINANCE_ALPHA | GL_UNSIGNED_BYTE          | uint8_t  | cx * cy * 2
-// -------------------+---------------------------+----------+----------------------------
-// GL_LUMINANCE       | GL_UNSIGNED_BYTE          | uint8_t  | cx * cy
+// Format             | Type                            | Data     | Size
+// -------------------+---------------------------------+----------+-------------------------------
+// GL_ALPHA           | GL_UNSIGNED_BYTE                | uint8_t  | cx * cy
+// -------------------+---------------------------------+----------+-------------------------------
+// GL_RED             | GL_UNSIGNED_BYTE                | uint8_t  | cx * cy
+//                    | GL_HALF_FLOAT                   | uint16_t | cx * cy * sizeof(uint16_t)
+//                    | GL_FLOAT                        | float    | cx * cy * sizeof(float)
+// -------------------+---------------------------------+----------+-------------------------------
+// GL_RG              | GL_UNSIGNED_BYTE                | uint8_t  | cx * cy * 2
+//                    | GL_HALF_FLOAT                   | uint16_t | cx * cy * 2 * sizeof(uint16_t)
+//                    | GL_FLOAT                        | float    | cx * cy * 2 * sizeof(float)
+// -------------------+---------------------------------+----------+-------------------------------
+// GL_RGB             | GL_UNSIGNED_BYTE                | uint8_t  | cx * cy * 3
+//                    | GL_UNSIGNED_SHORT_5_6_5         | uint16_t | cx * cy * sizeof(uint16_t)
+//                    | GL_UNSIGNED_INT_10F_11F_11F_REV | uint32_t | cx * cy * sizeof(uint32_t)
+//                    | GL_UNSIGNED_INT_5_9_9_9_REV     | uint32_t | cx * cy * sizeof(uint32_t)
+//                    | GL_HALF_FLOAT                   | uint16_t | cx * cy * 3 * sizeof(uint16_t)
+//                    | GL_FLOAT                        | float    | cx * cy * 3 * sizeof(float)
+// -------------------+---------------------------------+----------+-------------------------------
+// GL_RGBA            | GL_UNSIGNED_BYTE                | uint8_t  | cx * cy * 4
+//                    | GL_UNSIGNED_SHORT_4_4_4_4       | uint16_t | cx * cy * sizeof(uint16_t)
+//                    | GL_UNSIGNED_SHORT_5_5_5_1       | uint16_t | cx * cy * sizeof(uint16_t)
+//                    | GL_HALF_FLOAT                   | uint16_t | cx * cy * 4 * sizeof(uint16_t)
+//                    | GL_FLOAT                        | float    | cx * cy * 4 * sizeof(float)
+// -------------------+---------------------------------+----------+-------------------------------
+// GL_LUMINANCE_ALPHA | GL_UNSIGNED_BYTE                | uint8_t  | cx * cy * 2
+// -------------------+---------------------------------+----------+-------------------------------
+// GL_LUMINANCE       | GL_UNSIGNED_BYTE                | uint8_t  | cx * cy
 
+// Returns the size of a pixel in bytes or 0 if the format and type are not supported.
+inline std::size_t pixel_size(GLenum format, GLenum type) noexcept
+{
+  switch (type) {
+  case GL_UNSIGNED_BYTE:
+    switch (format) {
+    case GL_ALPHA:
+    case GL_LUMINANCE:
+    case GL_RED:
+      return 1;
+    case GL_LUMINANCE_ALPHA:
+    case GL_RG:
+      return 2;
+    case GL_RGB:
+      return 3;
+    case GL_RGBA:
+      return 4;
+    }
+    break;
+  case GL_UNSIGNED_SHORT_5_6_5:
+    return format == GL_RGB ? sizeof(std::uint16_t) : 0;
+  case GL_UNSIGNED_SHORT_4_4_4_4:
+  case GL_UNSIGNED_SHORT_5_5_5_1:
+    return format == GL_RGBA ? sizeof(std::uint16_t) : 0;
+  case GL_UNSIGNED_INT_10F_11F_11F_REV:
+  case GL_UNSIGNED_INT_5_9_9_9_REV:
+    return format == GL_RGB ? sizeof(std::uint32_t) : 0;
+  case GL_HALF_FLOAT:
+  case GL_FLOAT:
+    const auto size = type == GL_FLOAT ? sizeof(float) : sizeof(std::uint16_t);
+    switch (format) {
+    case GL_RED: return size;
+    case GL_RG: return size * 2;
+    case GL_RGB: return size * 3;
+    case GL_RGBA: return size * 4;
+    }
+    break;
+  }
+  return 0;
+}
+
+// Returns the sized internal format for a format and type or the format for unsized formats
+// (GL_ALPHA, GL_LUMINANCE and GL_LUMINANCE_ALPHA).
+inline GLenum internal_format(GLenum format, GLenum type) noexcept
+{
+  switch (type) {
+  case GL_UNSIGNED_BYTE:
+    switch (format) {
+    case GL_RED: return GL_R8;
+    case GL_RG: return GL_RG8;
+    case GL_RGB: return GL_RGB8;
+    case GL_RGBA: return GL_RGBA8;
+    }
+    break;
+  case GL_UNSIGNED_SHORT_5_6_5: return GL_RGB565;
+  case GL_UNSIGNED_SHORT_4_4_4_4: return GL_RGBA4;
+  case GL_UNSIGNED_SHORT_5_5_5_1: return GL_RGB5_A1;
+  case GL_UNSIGNED_INT_10F_11F_11F_REV: return GL_R11F_G11F_B10F;
+  case GL_UNSIGNED_INT_5_9_9_9_REV: return GL_RGB9_E5;
+  case GL_HALF_FLOAT:
+    switch (format) {
+    case GL_RED: return GL_R16F;
+    case GL_RG: return GL_RG16F;
+    case GL_RGB: return GL_RGB16F;
+    case GL_RGBA: return GL_RGBA16F;
+    }
+    break;
+  case GL_FLOAT:
+    switch (format) {
+    case GL_RED: return GL_R32F;
+    case GL_RG: return GL_RG32F;
+    case GL_RGB: return GL_RGB32F;
+    case GL_RGBA: return GL_RGBA32F;
+    }
+    break;
+  }
+  return format;
+}
+
+// Image with one or more layers (array layers, cube map faces or volume slices) of cy rows each.
+// Images either own tightly packed pixels or are views of external memory with an explicit row stride.
+// Views do not keep the memory alive and are read only unless they were created from mutable memory.
+// Compressed views have no type and no row stride.
 class image {
 public:
   image() :
@@ -31,61 +131,49 @@ public:
   explicit image(GLsizei cx, GLsizei cy, GLenum format, GLenum type) :
     cx_(cx), cy_(cy), format_(format), type_(type)
   {
-    switch (format_) {
-    case GL_ALPHA:
-    case GL_LUMINANCE:
-      switch (type_) {
-      case GL_UNSIGNED_BYTE:
-        data_.resize(cx_ * cy_, 0);
-        break;
-      default:
-        throw ice::runtime_error("Invalid image type.") << *this;
-        break;
-      }
-      break;
-    case GL_LUMINANCE_ALPHA:
-      switch (type_) {
-      case GL_UNSIGNED_BYTE:
-        data_.resize(cx_ * cy_ * 2, 0);
-        break;
-      default:
-        throw ice::runtime_error("Invalid image type.") << *this;
-        break;
-      }
-      break;
-    case GL_RGB:
-      switch (type_) {
-      case GL_UNSIGNED_BYTE:
-        data_.resize(cx_ * cy_ * 3, 0);
-        break;
-      case GL_UNSIGNED_SHORT_5_6_5:
-        data_.resize(cx_ * cy_ * sizeof(std::uint16_t), 0);
-        break;
-      default:
-        throw ice::runtime_error("Invalid image type.") << *this;
-        break;
-      }
-      break;
-    case GL_RGBA:
-      switch (type_) {
-      case GL_UNSIGNED_BYTE:
-        data_.resize(cx_ * cy_ * 4, 0);
-        break;
-      case GL_UNSIGNED_SHORT_4_4_4_4:
-      case GL_UNSIGNED_SHORT_5_5_5_1:
-        data_.resize(cx_ * cy_ * sizeof(std::uint16_t), 0);
-        break;
-      default:
-        throw ice::runtime_error("Invalid image type.") << *this;
-        break;
-      }
-      break;
-    default:
+    const auto pixel = pixel_size(format_, type_);
+    if (!pixel) {
+      throw ice::runtime_error("Invalid image format.") << *this;
+    }
+    stride_ = static_cast<std::size_t>(cx_) * pixel;
+    data_.resize(stride_ * static_cast<std::size_t>(cy_), 0);
+    size_ = data_.size();
+  }
+
+  // Creates a view of uncompressed pixels. Rows are stride bytes apart (tightly packed if 0)
+  // and layers are cy rows apart.
+  explicit image(GLsizei cx, GLsizei cy, GLenum format, GLenum type, void* data,
+    std::size_t stride = 0, GLsizei layers = 1) :
+    image(cx, cy, format, type, static_cast<const void*>(data), stride, layers)
+  {
+    readonly_ = false;
+  }
+
+  explicit image(GLsizei cx, GLsizei cy, GLenum format, GLenum type, const void* data,
+    std::size_t stride = 0, GLsizei layers = 1) :
+    cx_(cx), cy_(cy), format_(format), type_(type), layers_(layers),
+    view_(static_cast<std::uint8_t*>(const_cast<void*>(data)))
+  {
+    const auto pixel = pixel_size(format_, type_);
+    if (!pixel) {
       throw ice::runtime_error("Invalid image format.") << *this;
-      break;
     }
+    const auto row = static_cast<std::size_t>(cx_) * pixel;
+    stride_ = stride ? stride : row;
+    if (stride_ < row || stride_ % pixel) {
+      throw ice::runtime_error("Invalid image stride.") << *this << "\nStride: " << stride_;
+    }
+    const auto rows = static_cast<std::size_t>(cy_) * static_cast<std::size_t>(layers_);
+    size_ = rows ? stride_ * (rows - 1) + row : 0;
   }
 
+  // Creates a view of compressed blocks. The size covers all layers, which must have the same size.
+  explicit image(GLsizei cx, GLsizei cy, GLenum internalformat, const void* data, std::size_t size,
+    GLsizei layers = 1) :
+    cx_(cx), cy_(cy), format_(internalformat), type_(0), size_(size), layers_(layers),
+    view_(static_cast<std::uint8_t*>(const_cast<void*>(data)))
+  {}
+
   GLsizei cx() const noexcept
   {
     return cx_;
@@ -96,36 +184,115 @@ public:
     return cy_;
   }
 
+  // Returns the internal format for compressed images.
   GLenum format() const noexcept
   {
     return format_;
   }
 
+  // Returns 0 for compressed images.
   GLenum type() const noexcept
   {
     return type_;
   }
 
+  bool compressed() const noexcept
+  {
+    return type_ == 0 && format_ != 0;
+  }
+
+  // Returns the distance between rows in bytes or 0 for compressed images.
+  std::size_t stride() const noexcept
+  {
+    return stride_;
+  }
+
+  GLsizei layers() const noexcept
+  {
+    return layers_;
+  }
+
+  // Returns the distance between layers in bytes.
+  std::size_t layer_size() const noexcept
+  {
+    if (compressed()) {
+      return layers_ > 0 ? size_ / static_cast<std::size_t>(layers_) : 0;
+    }
+    return stride_ * static_cast<std::size_t>(cy_);
+  }
+
+  // Returns a read only view of a single layer.
+  image layer(GLsizei index) const
+  {
+    const auto data = static_cast<const std::uint8_t*>(this->data()) + layer_size() * static_cast<std::size_t>(index);
+    if (compressed()) {
+      return image(cx_, cy_, format_, data, layer_size());
+    }
+    return image(cx_, cy_, format_, type_, data, stride_);
+  }
+
+  // Returns a read only view of a rectangle in the first layer that shares the row stride.
+  // Throws ice::runtime_error for compressed images and rectangles that are out of bounds.
+  image region(GLint x, GLint y, GLsizei cx, GLsizei cy) const
+  {
+    const auto offset = region_offset(x, y, cx, cy);
+    return image(cx, cy, format_, type_, static_cast<const std::uint8_t*>(data()) + offset, stride_);
+  }
+
+  // Returns a view of a rectangle in the first layer that is writable unless this image is a read only view.
+  image region(GLint x, GLint y, GLsizei cx, GLsizei cy)
+  {
+    const auto offset = region_offset(x, y, cx, cy);
+    if (const auto data = static_cast<std::uint8_t*>(this->data())) {
+      return image(cx, cy, format_, type_, static_cast<void*>(data + offset), stride_);
+    }
+    return static_cast<const image&>(*this).region(x, y, cx, cy);
+  }
+
+  bool view() const noexcept
+  {
+    return view_ != nullptr;
+  }
+
+  // Returns nullptr for read only views.
   void* data() noexcept
   {
+    if (view_) {
+      return readonly_ ? nullptr : view_;
+    }
     return data_.data();
   }
 
   const void* data() const noexcept
   {
-    return data_.data();
+    return view_ ? view_ : data_.data();
   }
 
+  // Returns the number of bytes from the first pixel to the end of the last row.
   std::size_t size() const noexcept
   {
-    return data_.size();
+    return size_;
   }
 
 private:
+  std::size_t region_offset(GLint x, GLint y, GLsizei cx, GLsizei cy) const
+  {
+    if (compressed() || x < 0 || y < 0 || cx < 0 || cy < 0 || cx > cx_ - x || cy > cy_ - y) {
+      throw ice::runtime_error("Invalid image region.")
+        << "Image: " << *this << "\nRegion: " << x << ' ' << y << ' ' << cx << ' ' << cy;
+    }
+    return stride_ * static_cast<std::size_t>(y) + gl::pixel_size(format_, type_) * static_cast<std::size_t>(x);
+  }
+
   GLsizei cx_;
   GLsizei cy_;
   GLenum format_;
   GLenum type_;
+  std::size_t stride_ = 0;
+  std::size_t size_ = 0;
+  GLsizei layers_ = 1;
+  std::uint8_t* view_ = nullptr;
+  bool readonly_ = true;
   std::vector<std::uint8_t> data_;
 };
 
@@ -135,6 +302,8 @@ inline std::ostream& operator<<(std::ostream& os, const gl::image& image)
   os << std::dec << image.cx() << ' ' << image.cy() << ' ';
   switch (image.format()) {
   case GL_ALPHA: os << "ALPHA"; break;
+  case GL_RED: os << "RED"; break;
+  case GL_RG: os << "RG"; break;
   case GL_RGB: os << "RGB"; break;
   case GL_RGBA: os << "RGBA"; break;
   case GL_LUMINANCE_ALPHA: os << "LUMINANCE_ALPHA"; break;
@@ -147,11 +316,78 @@ inline std::ostream& operator<<(std::ostream& os, const gl::image& image)
   case GL_UNSIGNED_SHORT_5_6_5: os << "UNSIGNED_SHORT_5_6_5"; break;
   case GL_UNSIGNED_SHORT_4_4_4_4: os << "UNSIGNED_SHORT_4_4_4_4"; break;
   case GL_UNSIGNED_SHORT_5_5_5_1: os << "UNSIGNED_SHORT_5_5_5_1"; break;
+  case GL_UNSIGNED_INT_10F_11F_11F_REV: os << "UNSIGNED_INT_10F_11F_11F_REV"; break;
+  case GL_UNSIGNED_INT_5_9_9_9_REV: os << "UNSIGNED_INT_5_9_9_9_REV"; break;
+  case GL_HALF_FLOAT: os << "HALF_FLOAT"; break;
+  case GL_FLOAT: os << "FLOAT"; break;
   default: os << "0x" << std::setfill('0') << std::hex << std::setw(4) << image.type() << std::dec;
   }
+  if (image.layers() != 1) {
+    os << " x " << image.layers();
+  }
   os << " (" << image.size() << " bytes)";
   os.flags(flags);
   return os;
 }
 
+// Copies the pixels of the first layer of src into dst, which must have the same size.
+// Supports images with the same format and type, the expansion of GL_RGB to GL_RGBA (unsigned bytes),
+// conversions between GL_FLOAT and GL_HALF_FLOAT and the packing of GL_RGB floats into
+// GL_UNSIGNED_INT_10F_11F_11F_REV or GL_UNSIGNED_INT_5_9_9_9_REV.
+// Throws ice::runtime_error if dst is read only or the formats are not supported.
+inline void blit(const gl::image& src, gl::image& dst)
+{
+  const auto data = static_cast<std::uint8_t*>(dst.data());
+  if (!data || src.cx() != dst.cx() || src.cy() != dst.cy() || src.compressed() || dst.compressed()) {
+    throw ice::runtime_error("Invalid image blit.") << "Source: " << src << "\nTarget: " << dst;
+  }
+  const auto cx = static_cast<std::size_t>(src.cx());
+  const auto cy = static_cast<std::size_t>(src.cy());
+  const auto pixels = static_cast<const std::uint8_t*>(src.data());
+  if (src.format() == dst.format() && src.type() == dst.type()) {
+    ice::copy_rows(pixels, src.stride(), data, dst.stride(), cx * gl::pixel_size(src.format(), src.type()), cy);
+  } else if (src.format() == GL_RGB && dst.format() == GL_RGBA && src.type() == GL_UNSIGNED_BYTE &&
+    dst.type() == GL_UNSIGNED_BYTE) {
+    ice::expand_rows(pixels, src.stride(), data, dst.stride(), cx, cy);
+  } else if (src.format() == dst.format() && src.type() == GL_FLOAT && dst.type() == GL_HALF_FLOAT) {
+    const auto count = cx * gl::pixel_size(src.format(), GL_FLOAT) / sizeof(float);
+    for (std::size_t y = 0; y < cy; y++) {
+      ice::to_half(reinterpret_cast<const float*>(pixels + src.stride() * y),
+        reinterpret_cast<std::uint16_t*>(data + dst.stride() * y), count);
+    }
+  } else if (src.format() == dst.format() && src.type() == GL_HALF_FLOAT && dst.type() == GL_FLOAT) {
+    const auto count = cx * gl::pixel_size(src.format(), GL_FLOAT) / sizeof(float);
+    for (std::size_t y = 0; y < cy; y++) {
+      ice::from_half(reinterpret_cast<const std::uint16_t*>(pixels + src.stride() * y),
+        reinterpret_cast<float*>(data + dst.stride() * y), count);
+    }
+  } else if (src.format() == GL_RGB && dst.format() == GL_RGB && src.type() == GL_FLOAT &&
+    (dst.type() == GL_UNSIGNED_INT_10F_11F_11F_REV || dst.type() == GL_UNSIGNED_INT_5_9_9_9_REV)) {
+    const auto pack = dst.type() == GL_UNSIGNED_INT_5_9_9_9_REV ? ice::to_rgb9e5 : ice::to_r11g11b10;
+    for (std::size_t y = 0; y < cy; y++) {
+      pack(reinterpret_cast<const float*>(pixels + src.stride() * y),
+        reinterpret_cast<std::uint32_t*>(data + dst.stride() * y), cx);
+    }
+  } else {
+    throw ice::runtime_error("Unsupported image blit.") << "Source: " << src << "\nTarget: " << dst;
+  }
+}
+
+// Resamples the first layer of src into dst, which must have the same format and unsigned bytes.
+// Use an ice::resampler directly to reuse the filter weights for images of the same size.
+// Throws ice::runtime_error if dst is read only or the formats are not supported.
+inline void resample(const gl::image& src, gl::image& dst, ice::resample_filter filter = ice::resample_filter::lanczos3,
+  ice::jobs* jobs = nullptr)
+{
+  const auto data = static_cast<std::uint8_t*>(dst.data());
+  if (!data || src.format() != dst.format() || src.type() != GL_UNSIGNED_BYTE || dst.type() != GL_UNSIGNED_BYTE ||
+    src.cx() < 1 || src.cy() < 1 || dst.cx() < 1 || dst.cy() < 1) {
+    throw ice::runtime_error("Invalid image resample.") << "Source: " << src << "\nTarget: " << dst;
+  }
+  const ice::resampler resampler(static_cast<std::size_t>(src.cx()), static_cast<std::size_t>(src.cy()),
+    static_cast<std::size_t>(dst.cx()), static_cast<std::size_t>(dst.cy()), gl::pixel_size(src.format(), src.type()),
+    filter);
+  resampler.run(static_cast<const std::uint8_t*>(src.data()), src.stride(), data, dst.stride(), jobs);
+}
+
 }  // namespace gl
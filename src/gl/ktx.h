@@ -0,0 +1,217 @@
+#pragma once
+#include <gl/opengl.h>
+#include <gl/image.h>
+#include <GLES2/gl2ext.h>
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace gl {
+
+// KTX 2.0 texture container.
+// The level images are views into the container data, which is kept alive by the owner (e.g. an ice::archive::view
+// of a stored archive entry). Supercompressed (Basis Universal, zstd) containers are not supported.
+class ktx {
+public:
+  // Throws ice::runtime_error if the data is not a supported KTX 2.0 container.
+  explicit ktx(const std::uint8_t* data, std::size_t size, std::shared_ptr<const void> owner = {}) :
+    owner_(std::move(owner))
+  {
+    static const std::uint8_t identifier[12] = {
+      0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+    };
+    constexpr std::size_t header_size = 80;
+    constexpr std::size_t level_size = 24;
+    if (!data || size < header_size || std::memcmp(data, identifier, sizeof(identifier)) != 0) {
+      throw ice::runtime_error("Invalid KTX 2.0 identifier.");
+    }
+
+    // Read the header.
+    const auto vk_format = read<std::uint32_t>(data + 12);
+    const auto cx = read<std::uint32_t>(data + 20);
+    const auto cy = read<std::uint32_t>(data + 24);
+    const auto depth = read<std::uint32_t>(data + 28);
+    const auto layers = read<std::uint32_t>(data + 32);
+    const auto faces = read<std::uint32_t>(data + 36);
+    const auto levels = std::max(read<std::uint32_t>(data + 40), std::uint32_t(1));
+    const auto supercompression = read<std::uint32_t>(data + 44);
+    if (supercompression != 0) {
+      throw ice::runtime_error("Unsupported KTX 2.0 supercompression scheme.") << "Scheme: " << supercompression;
+    }
+    if (!format(vk_format)) {
+      throw ice::runtime_error("Unsupported KTX 2.0 format.") << "Format: " << vk_format;
+    }
+    if (cx < 1 || cy < 1 || (faces != 1 && faces != 6) || (faces == 6 && depth > 1) || (depth > 1 && layers > 0) ||
+      levels > 32 || header_size + level_size * levels > size) {
+      throw ice::runtime_error("Invalid KTX 2.0 header.")
+        << "Size: " << cx << 'x' << cy << 'x' << depth << "\nLayers: " << layers << "\nFaces: " << faces
+        << "\nLevels: " << levels;
+    }
+    cx_ = static_cast<GLsizei>(cx);
+    cy_ = static_cast<GLsizei>(cy);
+    depth_ = static_cast<GLsizei>(std::max(depth, std::uint32_t(1)));
+    layers_ = static_cast<GLsizei>(std::max(layers, std::uint32_t(1)));
+    faces_ = static_cast<GLsizei>(faces);
+    if (depth > 1) {
+      target_ = GL_TEXTURE_3D;
+    } else if (faces == 6) {
+      target_ = layers > 0 ? GL_TEXTURE_CUBE_MAP_ARRAY : GL_TEXTURE_CUBE_MAP;
+    } else {
+      target_ = layers > 0 ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+    }
+
+    // Create views of all levels. Every level contains the layers, faces and volume slices in this order.
+    for (std::uint32_t i = 0; i < levels; i++) {
+      const auto entry = data + header_size + level_size * i;
+      const auto offset = read<std::uint64_t>(entry);
+      const auto length = read<std::uint64_t>(entry + 8);
+      if (offset > size || length > size - offset) {
+        throw ice::runtime_error("Invalid KTX 2.0 level index.") << "Level: " << i;
+      }
+      const auto level_cx = std::max(cx_ >> i, 1);
+      const auto level_cy = std::max(cy_ >> i, 1);
+      const auto level_depth = target_ == GL_TEXTURE_3D ? std::max(depth_ >> i, 1) : 1;
+      const auto count = layers_ * faces_ * level_depth;
+      const auto src = data + offset;
+      const auto bytes = static_cast<std::size_t>(length);
+      if (type_) {
+        images_.emplace_back(level_cx, level_cy, format_, type_, src, 0, count);
+      } else {
+        images_.emplace_back(level_cx, level_cy, internalformat_, src, bytes, count);
+      }
+      if (images_.back().size() > bytes || (type_ == 0 && bytes % static_cast<std::size_t>(count))) {
+        throw ice::runtime_error("Invalid KTX 2.0 level size.") << "Level: " << i << "\nImage: " << images_.back();
+      }
+    }
+  }
+
+  // Returns GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_3D, GL_TEXTURE_CUBE_MAP or GL_TEXTURE_CUBE_MAP_ARRAY.
+  GLenum target() const noexcept
+  {
+    return target_;
+  }
+
+  GLenum internalformat() const noexcept
+  {
+    return internalformat_;
+  }
+
+  // Returns true if the levels contain compressed blocks.
+  bool compressed() const noexcept
+  {
+    return type_ == 0;
+  }
+
+  GLsizei cx() const noexcept
+  {
+    return cx_;
+  }
+
+  GLsizei cy() const noexcept
+  {
+    return cy_;
+  }
+
+  // Returns the number of volume slices of the first level.
+  GLsizei depth() const noexcept
+  {
+    return depth_;
+  }
+
+  // Returns the number of array layers (1 for textures that are not arrays).
+  GLsizei layers() const noexcept
+  {
+    return layers_;
+  }
+
+  // Returns 6 for cube maps and 1 otherwise.
+  GLsizei faces() const noexcept
+  {
+    return faces_;
+  }
+
+  GLsizei levels() const noexcept
+  {
+    return static_cast<GLsizei>(images_.size());
+  }
+
+  // Returns a view of a level. Image layers are array layers, cube map faces or volume slices.
+  const gl::image& level(GLsizei index) const noexcept
+  {
+    return images_[static_cast<std::size_t>(index)];
+  }
+
+  const std::shared_ptr<const void>& owner() const noexcept
+  {
+    return owner_;
+  }
+
+private:
+  template <typename T>
+  static T read(const std::uint8_t* data) noexcept
+  {
+    T value = 0;
+    for (std::size_t i = 0; i < sizeof(T); i++) {
+      value = static_cast<T>(value | static_cast<T>(data[i]) << (i * 8));
+    }
+    return value;
+  }
+
+  // Maps a Vulkan format to an OpenGL ES format. Returns false if the format is not supported.
+  bool format(std::uint32_t vk_format) noexcept
+  {
+    const auto set = [this](GLenum internalformat, GLenum format, GLenum type) {
+      internalformat_ = internalformat;
+      format_ = format;
+      type_ = type;
+    };
+    switch (vk_format) {
+    case 9: set(GL_R8, GL_RED, GL_UNSIGNED_BYTE); break;
+    case 16: set(GL_RG8, GL_RG, GL_UNSIGNED_BYTE); break;
+    case 23: set(GL_RGB8, GL_RGB, GL_UNSIGNED_BYTE); break;
+    case 29: set(GL_SRGB8, GL_RGB, GL_UNSIGNED_BYTE); break;
+    case 37: set(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE); break;
+    case 43: set(GL_SRGB8_ALPHA8, GL_RGBA, GL_UNSIGNED_BYTE); break;
+    case 76: set(GL_R16F, GL_RED, GL_HALF_FLOAT); break;
+    case 83: set(GL_RG16F, GL_RG, GL_HALF_FLOAT); break;
+    case 90: set(GL_RGB16F, GL_RGB, GL_HALF_FLOAT); break;
+    case 97: set(GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT); break;
+    case 100: set(GL_R32F, GL_RED, GL_FLOAT); break;
+    case 103: set(GL_RG32F, GL_RG, GL_FLOAT); break;
+    case 106: set(GL_RGB32F, GL_RGB, GL_FLOAT); break;
+    case 109: set(GL_RGBA32F, GL_RGBA, GL_FLOAT); break;
+    case 122: set(GL_R11F_G11F_B10F, GL_RGB, GL_UNSIGNED_INT_10F_11F_11F_REV); break;
+    case 123: set(GL_RGB9_E5, GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV); break;
+    case 131: set(GL_COMPRESSED_RGB_S3TC_DXT1_EXT, 0, 0); break;
+    case 133: set(GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 0, 0); break;
+    case 135: set(GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, 0, 0); break;
+    case 137: set(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 0, 0); break;
+    case 147: set(GL_COMPRESSED_RGB8_ETC2, 0, 0); break;
+    case 148: set(GL_COMPRESSED_SRGB8_ETC2, 0, 0); break;
+    case 151: set(GL_COMPRESSED_RGBA8_ETC2_EAC, 0, 0); break;
+    case 152: set(GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC, 0, 0); break;
+    case 153: set(GL_COMPRESSED_R11_EAC, 0, 0); break;
+    case 155: set(GL_COMPRESSED_RG11_EAC, 0, 0); break;
+    default: return false;
+    }
+    return true;
+  }
+
+  GLenum target_ = GL_TEXTURE_2D;
+  GLenum internalformat_ = 0;
+  GLenum format_ = 0;
+  GLenum type_ = 0;
+  GLsizei cx_ = 0;
+  GLsizei cy_ = 0;
+  GLsizei depth_ = 1;
+  GLsizei layers_ = 1;
+  GLsizei faces_ = 1;
+  std::vector<gl::image> images_;
+  std::shared_ptr<const void> owner_;
+};
+
+}  // namespace gl
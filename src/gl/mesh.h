@@ -0,0 +1,127 @@
+#pragma once
+#include <gl/opengl.h>
+#include <gl/buffer.h>
+#include <gl/vao.h>
+#include <ice/mesh.h>
+#include <utility>
+#include <vector>
+
+namespace gl {
+
+// Vertex and index buffers of a mesh file (see ice::mesh_view).
+// The quantized vertices are uploaded as they are stored and decoded by the vertex attribute formats.
+class mesh {
+public:
+  // Vertex attribute locations. Location 2 is reserved for per-instance data.
+  enum location : GLuint {
+    position = 0,
+    color = 1,
+    normal = 3,
+    uv = 4,
+  };
+
+  mesh() = default;
+
+  explicit mesh(const ice::mesh_view& view) :
+    vbo_(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(view.header().vertices) * view.header().stride,
+      view.vertices(), GL_STATIC_DRAW),
+    ibo_(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(view.header().indices) * view.header().index_size,
+      view.indices(), GL_STATIC_DRAW),
+    lods_(view.lods(), view.lods() + view.header().lods),
+    attributes_(view.header().attributes), stride_(static_cast<GLsizei>(view.header().stride)),
+    index_size_(view.header().index_size), radius_(view.header().radius)
+  {
+    const auto& header = view.header();
+    center_[0] = header.center[0];
+    center_[1] = header.center[1];
+    center_[2] = header.center[2];
+  }
+
+  mesh(mesh&& other)
+  {
+    swap(other);
+  }
+
+  mesh& operator=(mesh&& other)
+  {
+    swap(other);
+    return *this;
+  }
+
+  // Binds the buffers and specifies the vertex attributes. Call this function in a gl::vao initializer.
+  void attributes() const
+  {
+    using ice::mesh_attribute_offset;
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_);
+    gl::vertex_attribute(position, 4, GL_HALF_FLOAT, GL_FALSE, stride_, mesh_attribute_offset(attributes_, ice::mesh_position));
+    if (attributes_ & ice::mesh_normal) {
+      gl::vertex_attribute(normal, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride_, mesh_attribute_offset(attributes_, ice::mesh_normal));
+    }
+    if (attributes_ & ice::mesh_uv) {
+      gl::vertex_attribute(uv, 2, GL_HALF_FLOAT, GL_FALSE, stride_, mesh_attribute_offset(attributes_, ice::mesh_uv));
+    }
+    if (attributes_ & ice::mesh_color) {
+      gl::vertex_attribute(color, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride_, mesh_attribute_offset(attributes_, ice::mesh_color));
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+
+  // Draws a level of detail with a vertex array that was initialized with attributes().
+  void draw(const gl::vao& vao, std::size_t lod, GLsizei instances = 1) const
+  {
+    const auto& range = lods_[lod];
+    const auto type = index_size_ == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    vao.draw_elements(GL_TRIANGLES, static_cast<GLsizei>(range.count), type, std::size_t(range.first) * index_size_, instances);
+  }
+
+  // Returns the coarsest level of detail whose error does not exceed the given error in model units.
+  std::size_t select(float error) const noexcept
+  {
+    std::size_t lod = 0;
+    while (lod + 1 < lods_.size() && lods_[lod + 1].error <= error) {
+      lod++;
+    }
+    return lod;
+  }
+
+  std::size_t lods() const noexcept
+  {
+    return lods_.size();
+  }
+
+  // Returns the bounding sphere.
+  const GLfloat* center() const noexcept
+  {
+    return center_;
+  }
+
+  GLfloat radius() const noexcept
+  {
+    return radius_;
+  }
+
+private:
+  void swap(mesh& other) noexcept
+  {
+    std::swap(vbo_, other.vbo_);
+    std::swap(ibo_, other.ibo_);
+    std::swap(lods_, other.lods_);
+    std::swap(attributes_, other.attributes_);
+    std::swap(stride_, other.stride_);
+    std::swap(index_size_, other.index_size_);
+    std::swap(center_, other.center_);
+    std::swap(radius_, other.radius_);
+  }
+
+  gl::buffer vbo_;
+  gl::buffer ibo_;
+  std::vector<ice::mesh_lod> lods_;
+  std::uint32_t attributes_ = 0;
+  GLsizei stride_ = 0;
+  std::uint32_t index_size_ = 2;
+  GLfloat center_[3] = {};
+  GLfloat radius_ = 0.0f;
+};
+
+}  // namespace gl
@@ -3,6 +3,7 @@
 #include <GLES3/gl32.h>
 #include <stdexcept>
 #include <string>
+#include <cstring>
 
 namespace gl {
 
@@ -57,6 +58,27 @@ inline std::error_code make_error()
   return make_error(glGetError());
 }
 
+// Returns true if the space separated extensions string contains the given extension.
+inline bool has_extension(const char* extensions, const char* name)
+{
+  if (!extensions) {
+    return false;
+  }
+  const auto size = std::strlen(name);
+  for (auto pos = std::strstr(extensions, name); pos; pos = std::strstr(pos + size, name)) {
+    if ((pos == extensions || pos[-1] == ' ') && (pos[size] == ' ' || pos[size] == '\0')) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns true if the current context supports the given extension.
+inline bool has_extension(const char* name)
+{
+  return has_extension(reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS)), name);
+}
+
 }  // namespace gl
 
 namespace std {
@@ -1,11 +1,26 @@
 #pragma once
 #include <gl/opengl.h>
 #include <gl/shader.h>
+#include <algorithm>
 #include <initializer_list>
+#include <string>
 #include <utility>
+#include <vector>
+#include <cstdint>
+#include <cstring>
 
 namespace gl {
 
+// Returns the FNV-1a hash of a uniform, uniform block or attribute name.
+// Hash names in constant expressions (e.g. constexpr variables) so that draws never hash strings.
+constexpr std::uint32_t hash(const char* name, std::uint32_t value = 2166136261u) noexcept
+{
+  return *name ? hash(name + 1, static_cast<std::uint32_t>((value ^ static_cast<std::uint8_t>(*name)) * 16777619ull)) :
+    value;
+}
+
+// Linked program with the reflection of its active uniforms, uniform blocks and attributes.
+// The reflection is queried once after linkage and stored in small hash tables keyed by gl::hash values.
 class program {
 public:
   program() = default;
@@ -77,16 +92,33 @@ public:
       throw ice::runtime_error("Program linkage failed.")
         << info;
     }
+
+    // Reflect the active variables.
+    try {
+      reflect();
+    }
+    catch (...) {
+      glDeleteProgram(program_);
+      throw;
+    }
   }
 
   program(program&& other)
   {
     std::swap(program_, other.program_);
+    std::swap(uniforms_, other.uniforms_);
+    std::swap(blocks_, other.blocks_);
+    std::swap(attributes_, other.attributes_);
+    std::swap(values_, other.values_);
   }
 
   program& operator=(program&& other)
   {
     std::swap(program_, other.program_);
+    std::swap(uniforms_, other.uniforms_);
+    std::swap(blocks_, other.blocks_);
+    std::swap(attributes_, other.attributes_);
+    std::swap(values_, other.values_);
     return *this;
   }
 
@@ -102,8 +134,319 @@ public:
     return program_;
   }
 
+  // Returns the location of the uniform or -1. Arrays are named without the "[0]" suffix.
+  GLint uniform_location(std::uint32_t name) const noexcept
+  {
+    const auto uniform = uniforms_.find(name);
+    return uniform ? uniform->location : -1;
+  }
+
+  // Sets uniform values from the given number of floats, integers or unsigned integers.
+  // Arrays are set from the first element and the size is truncated to whole elements. Values that equal the
+  // values last set through this function are not uploaded again; other uniform updates (e.g. glUniform1f)
+  // make this cache stale. The program must be in use. Unknown names are ignored like location -1.
+  // Samplers and booleans take integers. Throws ice::runtime_error if the value type does not match.
+  void uniform(std::uint32_t name, const GLfloat* values, std::size_t size)
+  {
+    set(name, GL_FLOAT, values, size);
+  }
+
+  void uniform(std::uint32_t name, const GLint* values, std::size_t size)
+  {
+    set(name, GL_INT, values, size);
+  }
+
+  void uniform(std::uint32_t name, const GLuint* values, std::size_t size)
+  {
+    set(name, GL_UNSIGNED_INT, values, size);
+  }
+
+  void uniform(std::uint32_t name, GLfloat value)
+  {
+    set(name, GL_FLOAT, &value, 1);
+  }
+
+  void uniform(std::uint32_t name, GLint value)
+  {
+    set(name, GL_INT, &value, 1);
+  }
+
+  void uniform(std::uint32_t name, GLuint value)
+  {
+    set(name, GL_UNSIGNED_INT, &value, 1);
+  }
+
+  // Returns the index of the uniform block or GL_INVALID_INDEX.
+  GLuint uniform_block(std::uint32_t name) const noexcept
+  {
+    const auto block = blocks_.find(name);
+    return block ? static_cast<GLuint>(block->location) : GL_INVALID_INDEX;
+  }
+
+  GLuint uniform_block(const std::string& name) const noexcept
+  {
+    return uniform_block(gl::hash(name.c_str()));
+  }
+
+  // Returns the location of the vertex attribute or -1.
+  GLint attribute_location(std::uint32_t name) const noexcept
+  {
+    const auto attribute = attributes_.find(name);
+    return attribute ? attribute->location : -1;
+  }
+
 private:
+  // Active uniform, uniform block or attribute.
+  struct variable {
+    std::string name;
+    std::uint32_t hash = 0;
+    GLint location = -1;     // uniform or attribute location, or uniform block index
+    GLenum type = 0;         // uniform or attribute type (0 for uniform blocks)
+    GLint size = 0;          // number of array elements (0 for unused table entries)
+    std::size_t offset = 0;  // offset of the cached uniform values
+  };
+
+  // Open addressing hash table with linear probing and a power of two size.
+  class table {
+  public:
+    // Throws ice::runtime_error if two names have the same hash.
+    void build(const std::vector<variable>& variables)
+    {
+      entries_.clear();
+      if (variables.empty()) {
+        return;
+      }
+      std::size_t size = 4;
+      while (size < variables.size() * 2) {
+        size *= 2;
+      }
+      entries_.resize(size);
+      for (const auto& v : variables) {
+        auto i = v.hash & (size - 1);
+        while (entries_[i].size) {
+          if (entries_[i].hash == v.hash) {
+            throw ice::runtime_error("Program variable names have the same hash.")
+              << entries_[i].name << '\n' << v.name;
+          }
+          i = (i + 1) & (size - 1);
+        }
+        entries_[i] = v;
+      }
+    }
+
+    const variable* find(std::uint32_t hash) const noexcept
+    {
+      if (entries_.empty()) {
+        return nullptr;
+      }
+      const auto mask = entries_.size() - 1;
+      for (auto i = hash & mask;; i = (i + 1) & mask) {
+        const auto& entry = entries_[i];
+        if (!entry.size) {
+          return nullptr;
+        }
+        if (entry.hash == hash) {
+          return &entry;
+        }
+      }
+    }
+
+  private:
+    std::vector<variable> entries_;
+  };
+
+  // Returns the component type (GL_FLOAT, GL_INT or GL_UNSIGNED_INT) and count of a uniform type.
+  // Booleans, samplers and images are set as integers.
+  static std::pair<GLenum, GLint> components(GLenum type) noexcept
+  {
+    switch (type) {
+    case GL_FLOAT: return { GL_FLOAT, 1 };
+    case GL_FLOAT_VEC2: return { GL_FLOAT, 2 };
+    case GL_FLOAT_VEC3: return { GL_FLOAT, 3 };
+    case GL_FLOAT_VEC4: return { GL_FLOAT, 4 };
+    case GL_FLOAT_MAT2: return { GL_FLOAT, 4 };
+    case GL_FLOAT_MAT3: return { GL_FLOAT, 9 };
+    case GL_FLOAT_MAT4: return { GL_FLOAT, 16 };
+    case GL_FLOAT_MAT2x3: return { GL_FLOAT, 6 };
+    case GL_FLOAT_MAT2x4: return { GL_FLOAT, 8 };
+    case GL_FLOAT_MAT3x2: return { GL_FLOAT, 6 };
+    case GL_FLOAT_MAT3x4: return { GL_FLOAT, 12 };
+    case GL_FLOAT_MAT4x2: return { GL_FLOAT, 8 };
+    case GL_FLOAT_MAT4x3: return { GL_FLOAT, 12 };
+    case GL_INT_VEC2: return { GL_INT, 2 };
+    case GL_INT_VEC3: return { GL_INT, 3 };
+    case GL_INT_VEC4: return { GL_INT, 4 };
+    case GL_BOOL_VEC2: return { GL_INT, 2 };
+    case GL_BOOL_VEC3: return { GL_INT, 3 };
+    case GL_BOOL_VEC4: return { GL_INT, 4 };
+    case GL_UNSIGNED_INT: return { GL_UNSIGNED_INT, 1 };
+    case GL_UNSIGNED_INT_VEC2: return { GL_UNSIGNED_INT, 2 };
+    case GL_UNSIGNED_INT_VEC3: return { GL_UNSIGNED_INT, 3 };
+    case GL_UNSIGNED_INT_VEC4: return { GL_UNSIGNED_INT, 4 };
+    default: return { GL_INT, 1 };
+    }
+  }
+
+  template <typename T>
+  void set(std::uint32_t name, GLenum component, const T* values, std::size_t size)
+  {
+    const auto uniform = uniforms_.find(name);
+    if (!uniform) {
+      return;
+    }
+    const auto info = components(uniform->type);
+    if (info.first != component) {
+      throw ice::runtime_error("Invalid uniform value type.")
+        << "Uniform: " << uniform->name << "\nType: " << uniform->type;
+    }
+    const auto count = std::min(size / static_cast<std::size_t>(info.second), static_cast<std::size_t>(uniform->size));
+    if (!count) {
+      return;
+    }
+
+    // Compare the values with the cache.
+    const auto bytes = sizeof(T) * static_cast<std::size_t>(info.second) * count;
+    const auto cache = values_.data() + uniform->offset;
+    if (std::memcmp(cache, values, bytes) == 0) {
+      return;
+    }
+    std::memcpy(cache, values, bytes);
+    upload(*uniform, static_cast<GLsizei>(count), values);
+  }
+
+  static void upload(const variable& uniform, GLsizei count, const GLfloat* values) noexcept
+  {
+    switch (uniform.type) {
+    case GL_FLOAT: glUniform1fv(uniform.location, count, values); break;
+    case GL_FLOAT_VEC2: glUniform2fv(uniform.location, count, values); break;
+    case GL_FLOAT_VEC3: glUniform3fv(uniform.location, count, values); break;
+    case GL_FLOAT_VEC4: glUniform4fv(uniform.location, count, values); break;
+    case GL_FLOAT_MAT2: glUniformMatrix2fv(uniform.location, count, GL_FALSE, values); break;
+    case GL_FLOAT_MAT3: glUniformMatrix3fv(uniform.location, count, GL_FALSE, values); break;
+    case GL_FLOAT_MAT4: glUniformMatrix4fv(uniform.location, count, GL_FALSE, values); break;
+    case GL_FLOAT_MAT2x3: glUniformMatrix2x3fv(uniform.location, count, GL_FALSE, values); break;
+    case GL_FLOAT_MAT2x4: glUniformMatrix2x4fv(uniform.location, count, GL_FALSE, values); break;
+    case GL_FLOAT_MAT3x2: glUniformMatrix3x2fv(uniform.location, count, GL_FALSE, values); break;
+    case GL_FLOAT_MAT3x4: glUniformMatrix3x4fv(uniform.location, count, GL_FALSE, values); break;
+    case GL_FLOAT_MAT4x2: glUniformMatrix4x2fv(uniform.location, count, GL_FALSE, values); break;
+    case GL_FLOAT_MAT4x3: glUniformMatrix4x3fv(uniform.location, count, GL_FALSE, values); break;
+    }
+  }
+
+  static void upload(const variable& uniform, GLsizei count, const GLint* values) noexcept
+  {
+    switch (components(uniform.type).second) {
+    case 1: glUniform1iv(uniform.location, count, values); break;
+    case 2: glUniform2iv(uniform.location, count, values); break;
+    case 3: glUniform3iv(uniform.location, count, values); break;
+    case 4: glUniform4iv(uniform.location, count, values); break;
+    }
+  }
+
+  static void upload(const variable& uniform, GLsizei count, const GLuint* values) noexcept
+  {
+    switch (components(uniform.type).second) {
+    case 1: glUniform1uiv(uniform.location, count, values); break;
+    case 2: glUniform2uiv(uniform.location, count, values); break;
+    case 3: glUniform3uiv(uniform.location, count, values); break;
+    case 4: glUniform4uiv(uniform.location, count, values); break;
+    }
+  }
+
+  void reflect()
+  {
+    // Reset the error information.
+    glGetError();
+
+    // Get the number of active variables and the maximum name lengths.
+    GLint uniforms = 0;
+    GLint blocks = 0;
+    GLint attributes = 0;
+    GLint length = 0;
+    GLint max_length = 1;
+    glGetProgramiv(program_, GL_ACTIVE_UNIFORMS, &uniforms);
+    glGetProgramiv(program_, GL_ACTIVE_UNIFORM_BLOCKS, &blocks);
+    glGetProgramiv(program_, GL_ACTIVE_ATTRIBUTES, &attributes);
+    const GLenum lengths[] = {
+      GL_ACTIVE_UNIFORM_MAX_LENGTH, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH
+    };
+    for (auto pname : lengths) {
+      glGetProgramiv(program_, pname, &length);
+      max_length = std::max(max_length, length);
+    }
+    if (auto ec = make_error()) {
+      throw ice::runtime_error("Could not get the active program variables.")
+        << ec.message();
+    }
+    std::vector<GLchar> buffer(static_cast<std::size_t>(max_length) + 1);
+    std::vector<variable> variables;
+
+    // Reflect the uniforms outside of uniform blocks and assign their cache ranges.
+    // The initial values of uniforms are zero, so the zero filled cache matches the program.
+    std::size_t cache_size = 0;
+    for (GLint i = 0; i < uniforms; i++) {
+      GLsizei size = 0;
+      variable uniform;
+      glGetActiveUniform(program_, static_cast<GLuint>(i), max_length, &size, &uniform.size, &uniform.type, buffer.data());
+      buffer[static_cast<std::size_t>(size)] = '\0';
+      uniform.location = glGetUniformLocation(program_, buffer.data());
+      if (uniform.location < 0) {
+        continue;
+      }
+      uniform.name.assign(buffer.data(), static_cast<std::size_t>(size));
+      if (uniform.name.size() > 3 && uniform.name.compare(uniform.name.size() - 3, 3, "[0]") == 0) {
+        uniform.name.resize(uniform.name.size() - 3);
+      }
+      uniform.hash = gl::hash(uniform.name.c_str());
+      uniform.offset = cache_size;
+      cache_size += 4 * static_cast<std::size_t>(components(uniform.type).second) * static_cast<std::size_t>(uniform.size);
+      variables.push_back(std::move(uniform));
+    }
+    uniforms_.build(variables);
+    values_.assign(cache_size, 0);
+
+    // Reflect the uniform blocks.
+    variables.clear();
+    for (GLint i = 0; i < blocks; i++) {
+      GLsizei size = 0;
+      variable block;
+      glGetActiveUniformBlockName(program_, static_cast<GLuint>(i), max_length, &size, buffer.data());
+      block.location = i;
+      block.size = 1;
+      block.name.assign(buffer.data(), static_cast<std::size_t>(size));
+      block.hash = gl::hash(block.name.c_str());
+      variables.push_back(std::move(block));
+    }
+    blocks_.build(variables);
+
+    // Reflect the vertex attributes.
+    variables.clear();
+    for (GLint i = 0; i < attributes; i++) {
+      GLsizei size = 0;
+      variable attribute;
+      glGetActiveAttrib(program_, static_cast<GLuint>(i), max_length, &size, &attribute.size, &attribute.type, buffer.data());
+      buffer[static_cast<std::size_t>(size)] = '\0';
+      attribute.location = glGetAttribLocation(program_, buffer.data());
+      if (attribute.location < 0) {
+        continue;
+      }
+      attribute.name.assign(buffer.data(), static_cast<std::size_t>(size));
+      attribute.hash = gl::hash(attribute.name.c_str());
+      variables.push_back(std::move(attribute));
+    }
+    attributes_.build(variables);
+
+    if (auto ec = make_error()) {
+      throw ice::runtime_error("Could not reflect the active program variables.")
+        << ec.message();
+    }
+  }
+
   GLuint program_ = 0;
+  table uniforms_;
+  table blocks_;
+  table attributes_;
+  std::vector<std::uint8_t> values_;
 };
 
 }  // namespace gl
@@ -0,0 +1,114 @@
+#pragma once
+#include <gl/opengl.h>
+#include <algorithm>
+#include <utility>
+
+namespace gl {
+
+// A buffer object whose contents are replaced every frame, e.g. per-instance attributes.
+// Every write orphans the data store so that it never waits for draw calls that still
+// read the previous contents. The data store grows when a write does not fit.
+class stream {
+public:
+  stream() = default;
+
+  explicit stream(GLenum target, GLsizeiptr capacity = 64 * 1024) :
+    target_(target), capacity_(std::max(capacity, GLsizeiptr(1)))
+  {
+    // Reset the error information.
+    glGetError();
+
+    // Generate a named buffer object.
+    glGenBuffers(1, &buffer_);
+    if (auto ec = gl::make_error()) {
+      throw ice::runtime_error("Could not generate a named buffer object.")
+        << ec.message();
+    }
+
+    // Bind a named buffer object.
+    glBindBuffer(target_, buffer_);
+    if (auto ec = gl::make_error()) {
+      glDeleteBuffers(1, &buffer_);
+      throw ice::runtime_error("Could not bind a named buffer object.")
+        << ec.message();
+    }
+
+    // Create a buffer object's data store.
+    glBufferData(target_, capacity_, nullptr, GL_STREAM_DRAW);
+    if (auto ec = gl::make_error()) {
+      glDeleteBuffers(1, &buffer_);
+      throw ice::runtime_error("Could not create a buffer object's data store.")
+        << ec.message() << "\nSize: " << capacity_;
+    }
+
+    // Break the existing named buffer object binding.
+    glBindBuffer(target_, 0);
+    if (auto ec = gl::make_error()) {
+      glDeleteBuffers(1, &buffer_);
+      throw ice::runtime_error("Could not break the existing named buffer object binding.")
+        << ec.message();
+    }
+  }
+
+  stream(stream&& other)
+  {
+    std::swap(target_, other.target_);
+    std::swap(capacity_, other.capacity_);
+    std::swap(buffer_, other.buffer_);
+  }
+
+  stream& operator=(stream&& other)
+  {
+    std::swap(target_, other.target_);
+    std::swap(capacity_, other.capacity_);
+    std::swap(buffer_, other.buffer_);
+    return *this;
+  }
+
+  ~stream()
+  {
+    if (glIsBuffer(buffer_)) {
+      glDeleteBuffers(1, &buffer_);
+    }
+  }
+
+  operator GLuint() const noexcept
+  {
+    return buffer_;
+  }
+
+  // Replaces the buffer contents.
+  // Breaks the target binding afterwards; do not stream element arrays while a vertex array is bound.
+  void write(const void* data, GLsizeiptr size)
+  {
+    // Reset the error information.
+    glGetError();
+
+    // Orphan the data store and grow it when necessary.
+    glBindBuffer(target_, buffer_);
+    if (size > capacity_) {
+      capacity_ = std::max(size, capacity_ * 2);
+    }
+    glBufferData(target_, capacity_, nullptr, GL_STREAM_DRAW);
+
+    // Update the data store.
+    glBufferSubData(target_, 0, size, data);
+    glBindBuffer(target_, 0);
+    if (auto ec = gl::make_error()) {
+      throw ice::runtime_error("Could not write to a stream buffer object.")
+        << ec.message() << "\nSize: " << size << "\nCapacity: " << capacity_;
+    }
+  }
+
+  GLsizeiptr capacity() const noexcept
+  {
+    return capacity_;
+  }
+
+private:
+  GLenum target_ = GL_ARRAY_BUFFER;
+  GLsizeiptr capacity_ = 0;
+  GLuint buffer_ = 0;
+};
+
+}  // namespace gl
@@ -0,0 +1,176 @@
+#pragma once
+#include <gl/opengl.h>
+#include <GLES2/gl2ext.h>
+#include <ice/exception.h>
+#include <ice/pool.h>
+#include <algorithm>
+#include <list>
+
+namespace gl {
+
+// A frame buffer with a single color attachment.
+// The color attachment is a texture when the target uses multisampled render to texture
+// and a render buffer otherwise. The allocated size can be larger than the requested size.
+struct render_target {
+  GLuint fbo = 0;
+  GLuint rbo = 0;
+  GLuint texture = 0;
+  GLsizei cx = 0;
+  GLsizei cy = 0;
+  GLenum format = GL_RGBA8;
+  GLsizei samples = 0;
+};
+
+// Hands out frame buffers in size buckets and recycles them between frames.
+// Targets that were not acquired for the given number of frames are deleted.
+// The target handles are list nodes from a small object pool, so recycling them does not use the heap.
+class target_pool {
+public:
+  explicit target_pool(GLsizei granularity = 256, unsigned lifetime = 60,
+    PFNGLFRAMEBUFFERTEXTURE2DMULTISAMPLEEXTPROC render_to_texture = nullptr) :
+    granularity_(std::max(granularity, GLsizei(1))), lifetime_(lifetime), render_to_texture_(render_to_texture)
+  {}
+
+  target_pool(target_pool&& other) = delete;
+  target_pool(const target_pool& other) = delete;
+
+  target_pool& operator=(target_pool&& other) = delete;
+  target_pool& operator=(const target_pool& other) = delete;
+
+  ~target_pool()
+  {
+    clear();
+  }
+
+  // Returns the bucket size for the requested size.
+  GLsizei bucket(GLsizei size) const noexcept
+  {
+    return (std::max(size, GLsizei(1)) + granularity_ - 1) / granularity_ * granularity_;
+  }
+
+  // Returns an unused target that is at least cx x cy large.
+  // The target stays valid until it is released and the pool deleted it after the lifetime.
+  const render_target& acquire(GLsizei cx, GLsizei cy, GLenum format, GLsizei samples)
+  {
+    const auto bx = bucket(cx);
+    const auto by = bucket(cy);
+    for (auto& entry : entries_) {
+      const auto& target = entry.target;
+      if (!entry.used && target.cx == bx && target.cy == by && target.format == format && target.samples == samples) {
+        entry.used = true;
+        entry.frame = frame_;
+        return target;
+      }
+    }
+    pool_entry entry;
+    create(entry.target, bx, by, format, samples);
+    entry.used = true;
+    entry.frame = frame_;
+    entries_.push_back(entry);
+    return entries_.back().target;
+  }
+
+  // Returns a target to the pool.
+  void release(const render_target& target)
+  {
+    for (auto& entry : entries_) {
+      if (&entry.target == &target) {
+        entry.used = false;
+        entry.frame = frame_;
+        return;
+      }
+    }
+  }
+
+  // Advances the frame counter and deletes targets that exceeded their lifetime.
+  void frame()
+  {
+    frame_++;
+    entries_.remove_if([this](pool_entry& entry) {
+      if (entry.used || frame_ - entry.frame <= lifetime_) {
+        return false;
+      }
+      destroy(entry.target);
+      return true;
+    });
+  }
+
+  // Deletes all targets.
+  void clear()
+  {
+    for (auto& entry : entries_) {
+      destroy(entry.target);
+    }
+    entries_.clear();
+  }
+
+private:
+  struct pool_entry {
+    render_target target;
+    bool used = false;
+    unsigned frame = 0;
+  };
+
+  void create(render_target& target, GLsizei cx, GLsizei cy, GLenum format, GLsizei samples)
+  {
+    target.cx = cx;
+    target.cy = cy;
+    target.format = format;
+    target.samples = samples;
+
+    // Reset the error information.
+    glGetError();
+
+    // Create the color attachment.
+    glGenFramebuffers(1, &target.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+    if (samples > 1 && render_to_texture_) {
+      glGenTextures(1, &target.texture);
+      glBindTexture(GL_TEXTURE_2D, target.texture);
+      glTexStorage2D(GL_TEXTURE_2D, 1, format, cx, cy);
+      glBindTexture(GL_TEXTURE_2D, 0);
+      render_to_texture_(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.texture, 0, samples);
+    } else {
+      glGenRenderbuffers(1, &target.rbo);
+      glBindRenderbuffer(GL_RENDERBUFFER, target.rbo);
+      if (samples > 1) {
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, format, cx, cy);
+      } else {
+        glRenderbufferStorage(GL_RENDERBUFFER, format, cx, cy);
+      }
+      glBindRenderbuffer(GL_RENDERBUFFER, 0);
+      glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target.rbo);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (auto ec = gl::make_error()) {
+      destroy(target);
+      throw ice::runtime_error("Could not create a render target.")
+        << ec.message() << "\nSize: " << cx << 'x' << cy << "\nSamples: " << samples;
+    }
+  }
+
+  void destroy(render_target& target)
+  {
+    if (target.fbo) {
+      glDeleteFramebuffers(1, &target.fbo);
+      target.fbo = 0;
+    }
+    if (target.texture) {
+      glDeleteTextures(1, &target.texture);
+      target.texture = 0;
+    }
+    if (target.rbo) {
+      glDeleteRenderbuffers(1, &target.rbo);
+      target.rbo = 0;
+    }
+  }
+
+  GLsizei granularity_ = 256;
+  unsigned lifetime_ = 60;
+  unsigned frame_ = 0;
+  PFNGLFRAMEBUFFERTEXTURE2DMULTISAMPLEEXTPROC render_to_texture_ = nullptr;
+  ice::pool memory_{ 4 * 1024 };
+  std::list<pool_entry, ice::pool_allocator<pool_entry>> entries_{ ice::pool_allocator<pool_entry>(memory_) };
+};
+
+}  // namespace gl
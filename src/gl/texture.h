@@ -1,6 +1,7 @@
 #pragma once
 #include <gl/opengl.h>
 #include <gl/image.h>
+#include <gl/ktx.h>
 #include <utility>
 
 namespace gl {
@@ -9,7 +10,8 @@ class texture {
 public:
   texture() = default;
 
-  explicit texture(GLenum target, GLint level, const gl::image& image)
+  explicit texture(GLenum target, GLint level, const gl::image& image) :
+    cx_(image.cx()), cy_(image.cy())
   {
     // Reset the error information.
     glGetError();
@@ -30,7 +32,10 @@ public:
     }
 
     // Specify a texture image.
-    glTexImage2D(target, level, image.format(), image.cx(), image.cy(), 0, image.format(), image.type(), image.data());
+    unpack(image);
+    const auto internalformat = static_cast<GLint>(gl::internal_format(image.format(), image.type()));
+    glTexImage2D(target, level, internalformat, image.cx(), image.cy(), 0, image.format(), image.type(), image.data());
+    unpack();
     if (auto ec = gl::make_error()) {
       glDeleteTextures(1, &texture_);
       throw ice::runtime_error("Could not specify a texture image.")
@@ -46,13 +51,138 @@ public:
     }
   }
 
+  // Creates a texture with immutable storage for all levels.
+  // The contents are undefined until they are specified with glTexSubImage2D or a gl::uploader.
+  explicit texture(GLenum target, GLsizei levels, GLenum internalformat, GLsizei cx, GLsizei cy) :
+    cx_(cx), cy_(cy)
+  {
+    // Reset the error information.
+    glGetError();
+
+    // Generate a texture object.
+    glGenTextures(1, &texture_);
+    if (auto ec = gl::make_error()) {
+      throw ice::runtime_error("Could not generate a texture object.")
+        << ec.message();
+    }
+
+    // Bind a texture object.
+    glBindTexture(target, texture_);
+    if (auto ec = gl::make_error()) {
+      glDeleteTextures(1, &texture_);
+      throw ice::runtime_error("Could not bind a texture object.")
+        << ec.message();
+    }
+
+    // Specify the texture storage.
+    glTexStorage2D(target, levels, internalformat, cx, cy);
+    if (auto ec = gl::make_error()) {
+      glDeleteTextures(1, &texture_);
+      throw ice::runtime_error("Could not specify the texture storage.")
+        << ec.message() << "\nSize: " << cx << 'x' << cy << "\nLevels: " << levels;
+    }
+
+    // Break the existing texture object binding.
+    glBindTexture(target, 0);
+    if (auto ec = gl::make_error()) {
+      glDeleteTextures(1, &texture_);
+      throw ice::runtime_error("Could not break the existing texture object binding.")
+        << ec.message();
+    }
+  }
+
+  // Creates a texture with immutable storage and specifies all levels directly from the container data.
+  // Image views of memory mapped archive entries are uploaded without intermediate copies.
+  explicit texture(const gl::ktx& ktx) :
+    cx_(ktx.cx()), cy_(ktx.cy())
+  {
+    // Reset the error information.
+    glGetError();
+
+    // Generate a texture object.
+    glGenTextures(1, &texture_);
+    if (auto ec = gl::make_error()) {
+      throw ice::runtime_error("Could not generate a texture object.")
+        << ec.message();
+    }
+
+    // Bind a texture object.
+    const auto target = ktx.target();
+    glBindTexture(target, texture_);
+    if (auto ec = gl::make_error()) {
+      glDeleteTextures(1, &texture_);
+      throw ice::runtime_error("Could not bind a texture object.")
+        << ec.message();
+    }
+
+    // Specify the texture storage.
+    const auto cube = target == GL_TEXTURE_CUBE_MAP;
+    const auto layered = target == GL_TEXTURE_2D_ARRAY || target == GL_TEXTURE_3D || target == GL_TEXTURE_CUBE_MAP_ARRAY;
+    const auto depth = target == GL_TEXTURE_3D ? ktx.depth() : ktx.layers() * ktx.faces();
+    if (layered) {
+      glTexStorage3D(target, ktx.levels(), ktx.internalformat(), ktx.cx(), ktx.cy(), depth);
+    } else {
+      glTexStorage2D(target, ktx.levels(), ktx.internalformat(), ktx.cx(), ktx.cy());
+    }
+    if (auto ec = gl::make_error()) {
+      glDeleteTextures(1, &texture_);
+      throw ice::runtime_error("Could not specify the texture storage.")
+        << ec.message() << "\nSize: " << ktx.cx() << 'x' << ktx.cy() << 'x' << depth << "\nLevels: " << ktx.levels();
+    }
+
+    // Specify the texture levels.
+    for (GLsizei level = 0; level < ktx.levels(); level++) {
+      const auto& image = ktx.level(level);
+      unpack(image);
+      if (layered) {
+        if (image.compressed()) {
+          glCompressedTexSubImage3D(target, level, 0, 0, 0, image.cx(), image.cy(), image.layers(), image.format(),
+            static_cast<GLsizei>(image.size()), image.data());
+        } else {
+          glTexSubImage3D(target, level, 0, 0, 0, image.cx(), image.cy(), image.layers(), image.format(), image.type(),
+            image.data());
+        }
+      } else {
+        for (GLsizei face = 0; face < image.layers(); face++) {
+          const auto layer = image.layer(face);
+          const auto face_target = cube ? static_cast<GLenum>(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face) : target;
+          if (layer.compressed()) {
+            glCompressedTexSubImage2D(face_target, level, 0, 0, layer.cx(), layer.cy(), layer.format(),
+              static_cast<GLsizei>(layer.size()), layer.data());
+          } else {
+            glTexSubImage2D(face_target, level, 0, 0, layer.cx(), layer.cy(), layer.format(), layer.type(), layer.data());
+          }
+        }
+      }
+      unpack();
+      if (auto ec = gl::make_error()) {
+        glBindTexture(target, 0);
+        glDeleteTextures(1, &texture_);
+        throw ice::runtime_error("Could not specify a texture level.")
+          << ec.message() << "\nLevel: " << level << "\nImage: " << image;
+      }
+    }
+
+    // Break the existing texture object binding.
+    glBindTexture(target, 0);
+    if (auto ec = gl::make_error()) {
+      glDeleteTextures(1, &texture_);
+      throw ice::runtime_error("Could not break the existing texture object binding.")
+        << ec.message();
+    }
+  }
+
   texture(texture&& other)
   {
+    std::swap(cx_, other.cx_);
+    std::swap(cy_, other.cy_);
     std::swap(texture_, other.texture_);
   }
 
   texture& operator=(texture&& other)
   {
+    std::swap(cx_, other.cx_);
+    std::swap(cy_, other.cy_);
     std::swap(texture_, other.texture_);
     return *this;
   }
@@ -79,7 +209,43 @@ public:
     return cy_;
   }
 
+  // Specifies a texture sub-image at the given offset. Strided image views (e.g. regions of a larger
+  // image) are uploaded directly with GL_UNPACK_ROW_LENGTH. Only the first layer is uploaded.
+  void upload(GLenum target, GLint level, GLint x, GLint y, const gl::image& image)
+  {
+    // Reset the error information.
+    glGetError();
+
+    // Specify a texture sub-image. Cube map faces are bound as cube maps.
+    const auto face = target >= GL_TEXTURE_CUBE_MAP_POSITIVE_X && target <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z;
+    const auto binding = face ? static_cast<GLenum>(GL_TEXTURE_CUBE_MAP) : target;
+    glBindTexture(binding, texture_);
+    if (image.compressed()) {
+      const auto layer = image.layer(0);
+      glCompressedTexSubImage2D(target, level, x, y, layer.cx(), layer.cy(), layer.format(),
+        static_cast<GLsizei>(layer.size()), layer.data());
+    } else {
+      unpack(image);
+      glTexSubImage2D(target, level, x, y, image.cx(), image.cy(), image.format(), image.type(), image.data());
+      unpack();
+    }
+    glBindTexture(binding, 0);
+    if (auto ec = gl::make_error()) {
+      throw ice::runtime_error("Could not specify a texture sub-image.")
+        << ec.message() << "\nOffset: " << x << ' ' << y << "\nLevel: " << level << "\nImage: " << image;
+    }
+  }
+
 private:
+  // Sets the pixel storage modes for the image rows or restores the defaults.
+  static void unpack(const gl::image& image = {}) noexcept
+  {
+    const auto pixel = gl::pixel_size(image.format(), image.type());
+    const auto tight = image.stride() == static_cast<std::size_t>(image.cx()) * pixel;
+    glPixelStorei(GL_UNPACK_ALIGNMENT, pixel ? 1 : 4);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, pixel && !tight ? static_cast<GLint>(image.stride() / pixel) : 0);
+  }
+
   GLsizei cx_ = 0;
   GLsizei cy_ = 0;
   GLuint texture_ = 0;
@@ -0,0 +1,323 @@
+#pragma once
+#include <gl/opengl.h>
+#include <gl/program.h>
+#include <algorithm>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace gl {
+namespace std140 {
+
+// Types with the std140 base alignment of the corresponding GLSL types.
+// Scalars map to GLfloat, GLint and GLuint (use GLuint for bool).
+// There is no vec3 type because a std140 vec3 is 16 byte aligned but only 12 bytes large,
+// which can not be expressed with a C++ type. Use vec4 instead.
+
+struct alignas(8) vec2 {
+  GLfloat x, y;
+};
+
+struct alignas(16) vec4 {
+  GLfloat x, y, z, w;
+};
+
+struct alignas(8) ivec2 {
+  GLint x, y;
+};
+
+struct alignas(16) ivec4 {
+  GLint x, y, z, w;
+};
+
+struct alignas(8) uvec2 {
+  GLuint x, y;
+};
+
+struct alignas(16) uvec4 {
+  GLuint x, y, z, w;
+};
+
+// Column major matrices. Every column is padded to a vec4.
+struct alignas(16) mat3 {
+  vec4 columns[3];
+};
+
+struct alignas(16) mat4 {
+  vec4 columns[4];
+};
+
+// Array with the std140 element stride of 16 bytes.
+template <typename T, std::size_t N>
+struct alignas(16) array {
+  struct alignas(16) element {
+    T value;
+  };
+
+  T& operator[](std::size_t index) noexcept
+  {
+    return elements[index].value;
+  }
+
+  const T& operator[](std::size_t index) const noexcept
+  {
+    return elements[index].value;
+  }
+
+  element elements[N];
+};
+
+// The std140 base alignment of a member type or 0 for types without a std140 equivalent.
+template <typename T>
+struct alignment : std::integral_constant<std::size_t, 0> {};
+
+template <> struct alignment<GLfloat> : std::integral_constant<std::size_t, 4> {};
+template <> struct alignment<GLint> : std::integral_constant<std::size_t, 4> {};
+template <> struct alignment<GLuint> : std::integral_constant<std::size_t, 4> {};
+template <> struct alignment<vec2> : std::integral_constant<std::size_t, 8> {};
+template <> struct alignment<ivec2> : std::integral_constant<std::size_t, 8> {};
+template <> struct alignment<uvec2> : std::integral_constant<std::size_t, 8> {};
+template <> struct alignment<vec4> : std::integral_constant<std::size_t, 16> {};
+template <> struct alignment<ivec4> : std::integral_constant<std::size_t, 16> {};
+template <> struct alignment<uvec4> : std::integral_constant<std::size_t, 16> {};
+template <> struct alignment<mat3> : std::integral_constant<std::size_t, 16> {};
+template <> struct alignment<mat4> : std::integral_constant<std::size_t, 16> {};
+
+template <typename T, std::size_t N>
+struct alignment<array<T, N>> : std::integral_constant<std::size_t, alignment<T>::value ? 16 : 0> {};
+
+// Returns true if a member of the given type at the given offset has a std140 type and offset.
+// The C++ alignment and size of the types above match std140, so a block whose members all pass
+// this check has the std140 member offsets. Check every member of a block struct, e.g.
+// static_assert(gl::std140::member<decltype(block::color)>(offsetof(block, color)), "...");
+template <typename T>
+constexpr bool member(std::size_t offset) noexcept
+{
+  return alignment<T>::value != 0 && alignof(T) == alignment<T>::value && offset % alignment<T>::value == 0;
+}
+
+}  // namespace std140
+
+// A large uniform buffer object that is suballocated for per-draw uniform data.
+// The buffer is split into segments that are used round robin, one per frame, and every
+// segment is protected by a fence so that data is never written while the GPU reads it.
+// Data is staged with push() and uploaded with a single glBufferSubData call in flush().
+class uniform_buffer {
+public:
+  explicit uniform_buffer(GLsizeiptr size, std::size_t segments = 3) :
+    fences_(std::max(segments, std::size_t(1)), nullptr)
+  {
+    // Reset the error information.
+    glGetError();
+
+    // Get the uniform buffer offset alignment.
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment_);
+    if (auto ec = gl::make_error()) {
+      throw ice::runtime_error("Could not get the uniform buffer offset alignment.")
+        << ec.message();
+    }
+    alignment_ = std::max(alignment_, GLint(1));
+    segment_ = size / static_cast<GLsizeiptr>(fences_.size()) / alignment_ * alignment_;
+    if (segment_ < 1) {
+      throw ice::runtime_error("Invalid uniform buffer size.")
+        << "Size: " << size << "\nSegments: " << fences_.size() << "\nAlignment: " << alignment_;
+    }
+    data_.resize(static_cast<std::size_t>(segment_));
+
+    // Generate a named buffer object.
+    glGenBuffers(1, &buffer_);
+    if (auto ec = gl::make_error()) {
+      throw ice::runtime_error("Could not generate a named buffer object.")
+        << ec.message();
+    }
+
+    // Bind a named buffer object.
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+    if (auto ec = gl::make_error()) {
+      glDeleteBuffers(1, &buffer_);
+      throw ice::runtime_error("Could not bind a named buffer object.")
+        << ec.message();
+    }
+
+    // Create the buffer object's data store.
+    glBufferData(GL_UNIFORM_BUFFER, segment_ * static_cast<GLsizeiptr>(fences_.size()), nullptr, GL_DYNAMIC_DRAW);
+    if (auto ec = gl::make_error()) {
+      glDeleteBuffers(1, &buffer_);
+      throw ice::runtime_error("Could not create a buffer object's data store.")
+        << ec.message() << "\nSize: " << segment_ * static_cast<GLsizeiptr>(fences_.size());
+    }
+
+    // Break the existing named buffer object binding.
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    if (auto ec = gl::make_error()) {
+      glDeleteBuffers(1, &buffer_);
+      throw ice::runtime_error("Could not break the existing named buffer object binding.")
+        << ec.message();
+    }
+  }
+
+  uniform_buffer(uniform_buffer&& other) = delete;
+  uniform_buffer(const uniform_buffer& other) = delete;
+
+  uniform_buffer& operator=(uniform_buffer&& other) = delete;
+  uniform_buffer& operator=(const uniform_buffer& other) = delete;
+
+  ~uniform_buffer()
+  {
+    for (auto fence : fences_) {
+      if (fence) {
+        glDeleteSync(fence);
+      }
+    }
+    if (glIsBuffer(buffer_)) {
+      glDeleteBuffers(1, &buffer_);
+    }
+  }
+
+  operator GLuint() const noexcept
+  {
+    return buffer_;
+  }
+
+  // Starts a new frame with the next segment.
+  // Waits until the GPU finished reading the segment when it was used less than segments frames ago.
+  void begin()
+  {
+    index_ = (index_ + 1) % fences_.size();
+    if (auto& fence = fences_[index_]) {
+      glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+      glDeleteSync(fence);
+      fence = nullptr;
+    }
+    used_ = 0;
+    flushed_ = 0;
+  }
+
+  // Copies the data into the current segment and returns its buffer offset.
+  GLintptr push(const void* data, GLsizeiptr size)
+  {
+    const auto offset = (used_ + alignment_ - 1) / alignment_ * alignment_;
+    if (offset + size > segment_) {
+      throw ice::runtime_error("The uniform buffer segment is full.")
+        << "Segment size: " << segment_ << "\nRequested size: " << size;
+    }
+    std::memcpy(data_.data() + offset, data, static_cast<std::size_t>(size));
+    used_ = offset + size;
+    return base() + offset;
+  }
+
+  // Uploads the data pushed since the last flush.
+  // Must be called before the draw calls that use the data.
+  void flush()
+  {
+    if (used_ > flushed_) {
+      glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+      glBufferSubData(GL_UNIFORM_BUFFER, base() + flushed_, used_ - flushed_, data_.data() + flushed_);
+      glBindBuffer(GL_UNIFORM_BUFFER, 0);
+      flushed_ = used_;
+    }
+  }
+
+  // Flushes the pushed data and protects the segment with a fence.
+  void end()
+  {
+    flush();
+    fences_[index_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  }
+
+  // Binds a range of the buffer to the uniform buffer binding point.
+  void bind(GLuint binding, GLintptr offset, GLsizeiptr size) const
+  {
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer_, offset, size);
+  }
+
+private:
+  GLintptr base() const noexcept
+  {
+    return static_cast<GLintptr>(index_) * segment_;
+  }
+
+  GLuint buffer_ = 0;
+  GLint alignment_ = 256;
+  GLsizeiptr segment_ = 0;
+  GLsizeiptr used_ = 0;
+  GLsizeiptr flushed_ = 0;
+  std::size_t index_ = 0;
+  std::vector<GLsync> fences_;
+  std::vector<std::uint8_t> data_;
+};
+
+// A uniform block described by a C++ struct with std140 layout.
+// The struct must be composed of the gl::std140 types and scalars so that the C++ member
+// offsets match the std140 offsets; verify every member with gl::std140::member().
+// The size is checked at compile time and verified against the program block size.
+template <typename T>
+class uniform_block {
+public:
+  static_assert(std::is_standard_layout<T>::value, "Uniform blocks must have a standard layout.");
+  static_assert(std::is_trivially_copyable<T>::value, "Uniform blocks must be trivially copyable.");
+  static_assert(sizeof(T) % 16 == 0, "Uniform blocks must be padded to a multiple of 16 bytes (std140).");
+
+  uniform_block() = default;
+
+  explicit uniform_block(GLuint binding) : binding_(binding)
+  {}
+
+  // Assigns the binding point to the named block of the program.
+  void attach(const gl::program& program, const std::string& name) const
+  {
+    // Reset the error information.
+    glGetError();
+
+    // Get the uniform block index.
+    const auto index = program.uniform_block(name);
+    if (index == GL_INVALID_INDEX) {
+      throw ice::runtime_error("Could not find the uniform block.")
+        << name;
+    }
+
+    // Verify the uniform block size.
+    GLint size = 0;
+    glGetActiveUniformBlockiv(program, index, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+    if (auto ec = gl::make_error()) {
+      throw ice::runtime_error("Could not get the uniform block size.")
+        << ec.message() << '\n' << name;
+    }
+    if (static_cast<std::size_t>(size) != sizeof(T)) {
+      throw ice::runtime_error("Invalid uniform block size.")
+        << name << "\nProgram: " << size << " bytes\nStruct: " << sizeof(T) << " bytes";
+    }
+
+    // Assign the binding point.
+    glUniformBlockBinding(program, index, binding_);
+    if (auto ec = gl::make_error()) {
+      throw ice::runtime_error("Could not assign the uniform block binding point.")
+        << ec.message() << '\n' << name << "\nBinding: " << binding_;
+    }
+  }
+
+  // Stages the value in the uniform buffer and returns its offset.
+  GLintptr push(gl::uniform_buffer& buffer, const T& value) const
+  {
+    return buffer.push(&value, sizeof(T));
+  }
+
+  // Binds the value at the given offset to the binding point.
+  void bind(const gl::uniform_buffer& buffer, GLintptr offset) const
+  {
+    buffer.bind(binding_, offset, sizeof(T));
+  }
+
+  GLuint binding() const noexcept
+  {
+    return binding_;
+  }
+
+private:
+  GLuint binding_ = 0;
+};
+
+}  // namespace gl
@@ -0,0 +1,290 @@
+#pragma once
+#include <gl/opengl.h>
+#include <gl/image.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <cstring>
+
+namespace gl {
+
+// Uploads texture images through a ring of pixel unpack buffers.
+// Loader threads copy image rows into mapped staging buffers with upload() and the render
+// thread calls update() once per frame, which unmaps filled buffers, specifies the texture
+// sub-images from them and maps buffers again after their fence signaled.
+// Target textures should use immutable storage (see gl::texture).
+// The destructor wakes loader threads that wait for staging memory and waits for copies in progress.
+class uploader {
+public:
+  explicit uploader(std::size_t count = 4, GLsizeiptr size = 4 * 1024 * 1024) :
+    slots_(std::max(count, std::size_t(1))), size_(size)
+  {
+    // Reset the error information.
+    glGetError();
+
+    // Create the staging buffers.
+    for (auto& slot : slots_) {
+      glGenBuffers(1, &slot.buffer);
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+      glBufferData(GL_PIXEL_UNPACK_BUFFER, size_, nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (auto ec = gl::make_error()) {
+      destroy();
+      throw ice::runtime_error("Could not create the texture upload buffers.")
+        << ec.message() << "\nBuffers: " << slots_.size() << "\nSize: " << size_;
+    }
+
+    // Map the staging buffers.
+    try {
+      update();
+    }
+    catch (...) {
+      destroy();
+      throw;
+    }
+  }
+
+  uploader(uploader&& other) = delete;
+  uploader(const uploader& other) = delete;
+
+  uploader& operator=(uploader&& other) = delete;
+  uploader& operator=(const uploader& other) = delete;
+
+  ~uploader()
+  {
+    // Release waiting loader threads and wait for the ones that copy into mapped buffers.
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_ = true;
+    cv_.notify_all();
+    cv_.wait(lock, [this]() {
+      return waiters_ == 0 && std::none_of(slots_.begin(), slots_.end(), [](const slot& slot) {
+        return slot.status == state::filling;
+      });
+    });
+    lock.unlock();
+    destroy();
+  }
+
+  // Copies the image into staging buffers and queues the upload to the given texture level and offset.
+  // Images that do not fit into a single staging buffer are split into bands of rows.
+  // Blocks until staging memory is available; do not call this function on the render thread.
+  // Throws ice::runtime_error when the uploader is destroyed while waiting.
+  void upload(GLuint texture, GLenum target, GLint level, GLint x, GLint y, const gl::image& image)
+  {
+    if (image.cx() < 1 || image.cy() < 1) {
+      return;
+    }
+    if (image.compressed() || image.layers() != 1) {
+      throw ice::runtime_error("Could not stage a compressed or layered texture image.") << "Image: " << image;
+    }
+    const auto stride = static_cast<std::size_t>(image.cx()) * gl::pixel_size(image.format(), image.type());
+    const auto rows = static_cast<GLsizei>(static_cast<std::size_t>(size_) / stride);
+    if (rows < 1) {
+      throw ice::runtime_error("Could not stage a texture image row.")
+        << "Image: " << image << "\nBuffer size: " << size_;
+    }
+    auto src = reinterpret_cast<const std::uint8_t*>(image.data());
+    for (GLsizei row = 0; row < image.cy(); row += rows) {
+      const auto cy = std::min(rows, image.cy() - row);
+
+      // Wait for a mapped staging buffer.
+      std::unique_lock<std::mutex> lock(mutex_);
+      waiters_++;
+      cv_.wait(lock, [this]() { return stop_ || !mapped_.empty(); });
+      waiters_--;
+      if (stop_) {
+        cv_.notify_all();
+        throw ice::runtime_error("Could not stage a texture image.")
+          << "The uploader was destroyed.\nImage: " << image;
+      }
+      auto slot = mapped_.front();
+      mapped_.pop_front();
+      slot->status = state::filling;
+      lock.unlock();
+
+      // Copy the rows without holding the lock and remove the padding of strided views.
+      if (image.stride() == stride) {
+        std::memcpy(slot->data, src + stride * row, stride * cy);
+      } else {
+        auto dst = static_cast<std::uint8_t*>(slot->data);
+        for (GLsizei i = 0; i < cy; i++) {
+          std::memcpy(dst + stride * i, src + image.stride() * (row + i), stride);
+        }
+      }
+
+      // Queue the upload.
+      lock.lock();
+      slot->texture = texture;
+      slot->target = target;
+      slot->level = level;
+      slot->x = x;
+      slot->y = y + row;
+      slot->cx = image.cx();
+      slot->cy = cy;
+      slot->format = image.format();
+      slot->type = image.type();
+      slot->status = state::filled;
+      filled_.push_back(slot);
+      if (stop_) {
+        cv_.notify_all();
+        return;
+      }
+    }
+  }
+
+  // Returns the number of staging buffers that are being filled or wait for the next update.
+  std::size_t pending() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<std::size_t>(std::count_if(slots_.begin(), slots_.end(), [](const slot& slot) {
+      return slot.status == state::filling || slot.status == state::filled;
+    }));
+  }
+
+  // Recycles staging buffers, specifies queued texture sub-images and maps free staging buffers.
+  // Must be called on the render thread. Throws ice::runtime_error after the other uploads when the
+  // contents of a staging buffer were lost (e.g. after a display mode change); upload them again.
+  void update()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Reset the error information.
+    glGetError();
+
+    // Recycle staging buffers that are no longer used by the GPU.
+    for (auto& slot : slots_) {
+      if (slot.status == state::busy) {
+        auto result = glClientWaitSync(slot.fence, 0, 0);
+        if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED) {
+          glDeleteSync(slot.fence);
+          slot.fence = nullptr;
+          slot.status = state::free;
+        }
+      }
+    }
+
+    // Specify the texture sub-images from the filled staging buffers.
+    std::size_t lost = 0;
+    GLuint lost_texture = 0;
+    if (!filled_.empty()) {
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+      for (auto slot : filled_) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot->buffer);
+        const auto unmapped = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        slot->data = nullptr;
+        if (unmapped == GL_FALSE) {
+          lost++;
+          lost_texture = slot->texture;
+          slot->status = state::free;
+          continue;
+        }
+        if (glIsTexture(slot->texture)) {
+          glBindTexture(slot->target, slot->texture);
+          glTexSubImage2D(slot->target, slot->level, slot->x, slot->y, slot->cx, slot->cy, slot->format, slot->type, nullptr);
+          glBindTexture(slot->target, 0);
+        }
+        slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot->status = state::busy;
+      }
+      filled_.clear();
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+      if (auto ec = gl::make_error()) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        throw ice::runtime_error("Could not specify a texture sub-image from a staging buffer.")
+          << ec.message();
+      }
+    }
+
+    // Map the free staging buffers for the loader threads.
+    auto mapped = false;
+    for (auto& slot : slots_) {
+      if (slot.status == state::free) {
+        const auto access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+        slot.data = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size_, access);
+        if (!slot.data) {
+          auto ec = gl::make_error();
+          glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+          throw ice::runtime_error("Could not map a texture upload buffer.")
+            << ec.message();
+        }
+        slot.status = state::mapped;
+        mapped_.push_back(&slot);
+        mapped = true;
+      }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (mapped) {
+      cv_.notify_all();
+    }
+    if (lost) {
+      throw ice::runtime_error("Could not unmap a texture upload buffer.")
+        << "The staged data was lost.\nUploads: " << lost << "\nTexture: " << lost_texture;
+    }
+  }
+
+private:
+  enum class state {
+    free,     // unmapped and not used by the GPU
+    mapped,   // mapped and waiting for a loader thread
+    filling,  // mapped and written by a loader thread
+    filled,   // mapped and waiting for the next update
+    busy,     // unmapped and read by the GPU until the fence signals
+  };
+
+  struct slot {
+    GLuint buffer = 0;
+    GLsync fence = nullptr;
+    void* data = nullptr;
+    state status = state::free;
+
+    GLuint texture = 0;
+    GLenum target = GL_TEXTURE_2D;
+    GLint level = 0;
+    GLint x = 0;
+    GLint y = 0;
+    GLsizei cx = 0;
+    GLsizei cy = 0;
+    GLenum format = 0;
+    GLenum type = 0;
+  };
+
+  void destroy()
+  {
+    for (auto& slot : slots_) {
+      if (slot.data) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        slot.data = nullptr;
+      }
+      if (slot.fence) {
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+      }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    for (auto& slot : slots_) {
+      if (glIsBuffer(slot.buffer)) {
+        glDeleteBuffers(1, &slot.buffer);
+      }
+      slot.buffer = 0;
+      slot.status = state::free;
+    }
+    mapped_.clear();
+    filled_.clear();
+  }
+
+  std::vector<slot> slots_;
+  std::deque<slot*> mapped_;
+  std::deque<slot*> filled_;
+  GLsizeiptr size_ = 0;
+  std::size_t waiters_ = 0;
+  bool stop_ = false;
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+};
+
+}  // namespace gl
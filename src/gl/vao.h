@@ -1,9 +1,20 @@
 #pragma once
 #include <gl/opengl.h>
 #include <utility>
+#include <cstddef>
 
 namespace gl {
 
+// Specifies and enables a vertex attribute that is sourced from the bound array buffer.
+// Attributes with a non-zero divisor advance once per divisor instances instead of once per vertex.
+inline void vertex_attribute(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride,
+  std::size_t offset, GLuint divisor = 0)
+{
+  glVertexAttribPointer(index, size, type, normalized, stride, reinterpret_cast<const GLvoid*>(offset));
+  glEnableVertexAttribArray(index);
+  glVertexAttribDivisor(index, divisor);
+}
+
 class vao {
 public:
   vao() = default;
@@ -69,6 +80,32 @@ public:
     return vao_;
   }
 
+  // Draws the given number of instances with a single draw call.
+  void draw(GLenum mode, GLint first, GLsizei count, GLsizei instances = 1) const
+  {
+    glBindVertexArray(vao_);
+    if (instances == 1) {
+      glDrawArrays(mode, first, count);
+    } else if (instances > 1) {
+      glDrawArraysInstanced(mode, first, count, instances);
+    }
+    glBindVertexArray(0);
+  }
+
+  // Draws the given number of instances of indexed primitives from the element array buffer of the vertex array.
+  // The offset is the byte offset of the first index.
+  void draw_elements(GLenum mode, GLsizei count, GLenum type, std::size_t offset, GLsizei instances = 1) const
+  {
+    const auto indices = reinterpret_cast<const GLvoid*>(offset);
+    glBindVertexArray(vao_);
+    if (instances == 1) {
+      glDrawElements(mode, count, type, indices);
+    } else if (instances > 1) {
+      glDrawElementsInstanced(mode, count, type, indices, instances);
+    }
+    glBindVertexArray(0);
+  }
+
 private:
   GLuint vao_ = 0;
 };
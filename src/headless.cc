@@ -0,0 +1,247 @@
+#include "headless.h"
+#include <gl/capture.h>
+#include <ice/exception.h>
+#include <ice/png.h>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <cstdio>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+namespace {
+
+std::chrono::nanoseconds cpu_time()
+{
+#ifdef _WIN32
+  FILETIME creation = {};
+  FILETIME exit = {};
+  FILETIME kernel = {};
+  FILETIME user = {};
+  if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) {
+    return{};
+  }
+  auto k = (static_cast<std::uint64_t>(kernel.dwHighDateTime) << 32) | kernel.dwLowDateTime;
+  auto u = (static_cast<std::uint64_t>(user.dwHighDateTime) << 32) | user.dwLowDateTime;
+  return std::chrono::nanoseconds((k + u) * 100);
+#else
+  timespec ts = {};
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+    return{};
+  }
+  return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+#endif
+}
+
+}  // namespace
+
+headless::headless(const std::filesystem::path& path, GLsizei cx, GLsizei cy, GLsizei samples, std::size_t objects) :
+  samples_(samples), cx_(std::max(1, cx)), cy_(std::max(1, cy))
+{
+  try {
+    create();
+    client_ = std::make_unique<client>(path, cx_, cy_, 96, objects);
+  }
+  catch (...) {
+    destroy();
+    throw;
+  }
+}
+
+headless::~headless()
+{
+  destroy();
+}
+
+headless::statistics headless::run(std::size_t frames, const std::filesystem::path& dump)
+{
+  // Encode the captured frames top to bottom without the alpha channel on the worker threads.
+  std::unique_ptr<gl::capture> capture;
+  if (!dump.empty()) {
+    std::filesystem::create_directories(dump);
+    auto& jobs = client_->jobs();
+    capture = std::make_unique<gl::capture>(jobs, [&jobs, dump](std::size_t frame, const gl::image& image) {
+      const auto png = ice::encode_png(static_cast<const std::uint8_t*>(image.data()), image.stride(),
+        static_cast<std::size_t>(image.cx()), static_cast<std::size_t>(image.cy()), ice::png_format::rgbx, true, &jobs);
+      char filename[32];
+      std::snprintf(filename, sizeof(filename), "%06u.png", static_cast<unsigned>(frame));
+      const auto path = dump / filename;
+      std::ofstream os(path, std::ios::binary);
+      if (!os) {
+        throw ice::runtime_error("Could not open file for writing.") << path.u8string();
+      }
+      os.write(reinterpret_cast<const char*>(png.data()), static_cast<std::streamsize>(png.size()));
+      if (!os) {
+        throw ice::runtime_error("Could not write file.") << path.u8string();
+      }
+    });
+  }
+
+  statistics stats;
+  auto time = client::clock::now();
+  auto cpu = cpu_time();
+  for (std::size_t i = 0; i < frames; i++) {
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_[0]);
+    client_->invalidate();
+    client_->render();
+
+    // Resolve the multisample frame buffer.
+    if (samples_ > 1) {
+      glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo_[0]);
+      glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo_[1]);
+      glBlitFramebuffer(0, 0, cx_, cy_, 0, 0, cx_, cy_, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    }
+
+    // Queue the read back of the resolved frame.
+    if (capture) {
+      glBindFramebuffer(GL_READ_FRAMEBUFFER, samples_ > 1 ? fbo_[1] : fbo_[0]);
+      capture->read(0, 0, cx_, cy_);
+      capture->update();
+    }
+  }
+  if (capture) {
+    capture->finish();
+    stats.stalls = capture->stalls();
+  }
+  glFinish();
+  stats.frames = frames;
+  stats.time = client::clock::now() - time;
+  stats.cpu = cpu_time() - cpu;
+
+  if (auto ec = gl::make_error()) {
+    throw ice::runtime_error("Could not render the headless frames.") << ec.message();
+  }
+  return stats;
+}
+
+void headless::create()
+{
+  // Create the OpenGL ES display.
+#ifdef EGL_PLATFORM_ANGLE_ANGLE
+  const EGLint display_attributes[] = {
+    EGL_PLATFORM_ANGLE_TYPE_ANGLE, EGL_PLATFORM_ANGLE_TYPE_D3D11_ANGLE,
+    EGL_NONE,
+  };
+  display_ = eglGetPlatformDisplayEXT(EGL_PLATFORM_ANGLE_ANGLE, EGL_DEFAULT_DISPLAY, display_attributes);
+#elif defined(EGL_PLATFORM_SURFACELESS_MESA)
+  if (gl::has_extension(eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS), "EGL_MESA_platform_surfaceless")) {
+    auto get_platform_display = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (get_platform_display) {
+      display_ = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+  }
+#endif
+  if (!display_) {
+    display_ = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  }
+  if (!display_) {
+    throw ice::runtime_error("Could not create an OpenGL ES display.");
+  }
+  if (!eglInitialize(display_, nullptr, nullptr)) {
+    display_ = EGL_NO_DISPLAY;
+    throw ice::runtime_error("Could not initialize the OpenGL ES display.");
+  }
+  eglBindAPI(EGL_OPENGL_ES_API);
+
+  // Choose a config that supports pbuffer surfaces.
+  EGLConfig config = {};
+  EGLint config_count = 0;
+  const EGLint attributes[] = {
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT,
+    EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+    EGL_RED_SIZE, 8,
+    EGL_GREEN_SIZE, 8,
+    EGL_BLUE_SIZE, 8,
+    EGL_NONE
+  };
+  if (!eglChooseConfig(display_, attributes, &config, 1, &config_count) || config_count < 1) {
+    throw ice::runtime_error("Could not choose an OpenGL ES 3 pbuffer config.");
+  }
+
+  // Create the context and a pbuffer surface if surfaceless contexts are not supported.
+  const EGLint ctxattr[] = {
+    EGL_CONTEXT_CLIENT_VERSION, 3,
+    EGL_NONE
+  };
+  context_ = eglCreateContext(display_, config, EGL_NO_CONTEXT, ctxattr);
+  if (!context_) {
+    throw ice::runtime_error("Could not create the OpenGL ES 3 context.");
+  }
+  if (!gl::has_extension(eglQueryString(display_, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context")) {
+    const EGLint pbuffer_attributes[] = {
+      EGL_WIDTH, 1,
+      EGL_HEIGHT, 1,
+      EGL_NONE
+    };
+    surface_ = eglCreatePbufferSurface(display_, config, pbuffer_attributes);
+    if (!surface_) {
+      throw ice::runtime_error("Could not create the OpenGL ES 3 pbuffer surface.");
+    }
+  }
+  if (!eglMakeCurrent(display_, surface_, surface_, context_)) {
+    throw ice::runtime_error("Could not make the OpenGL ES 3 context current.");
+  }
+
+  // Create the render buffers.
+  glGetError();
+  glGenRenderbuffers(2, rbo_);
+  glBindRenderbuffer(GL_RENDERBUFFER, rbo_[0]);
+  if (samples_ > 1) {
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples_, GL_RGBA8, cx_, cy_);
+  } else {
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, cx_, cy_);
+  }
+  glBindRenderbuffer(GL_RENDERBUFFER, rbo_[1]);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, cx_, cy_);
+  if (auto ec = gl::make_error()) {
+    throw ice::runtime_error("Could not create the headless render buffers.")
+      << ec.message() << "\nSize: " << cx_ << 'x' << cy_ << "\nSamples: " << samples_;
+  }
+
+  // Create the frame buffers. The second frame buffer receives the resolved frame.
+  glGenFramebuffers(2, fbo_);
+  for (auto i = 0; i < 2; i++) {
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_[i]);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, rbo_[i]);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+      throw ice::runtime_error("Could not create the headless frame buffers.")
+        << "Size: " << cx_ << 'x' << cy_ << "\nSamples: " << samples_;
+    }
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo_[0]);
+  if (auto ec = gl::make_error()) {
+    throw ice::runtime_error("Could not create the headless frame buffers.") << ec.message();
+  }
+}
+
+void headless::destroy()
+{
+  // Destroy the client.
+  client_.reset();
+
+  // Destroy render and frame buffers.
+  if (context_) {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(2, fbo_);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glDeleteRenderbuffers(2, rbo_);
+  }
+
+  // Destroy OpenGL ES display, context and surface.
+  if (display_) {
+    eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (context_) {
+      eglDestroyContext(display_, context_);
+    }
+    if (surface_) {
+      eglDestroySurface(display_, surface_);
+    }
+    eglTerminate(display_);
+  }
+  context_ = EGL_NO_CONTEXT;
+  surface_ = EGL_NO_SURFACE;
+  display_ = EGL_NO_DISPLAY;
+}
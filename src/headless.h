@@ -0,0 +1,44 @@
+#pragma once
+#include "client.h"
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+
+// Renders the client into an offscreen frame buffer without a native window.
+// The context is surfaceless when EGL_KHR_surfaceless_context is supported and
+// uses a 1x1 pbuffer surface otherwise.
+class headless {
+public:
+  struct statistics {
+    std::size_t frames = 0;
+    std::chrono::duration<double> time{ 0 };  // wall clock time including glFinish
+    std::chrono::duration<double> cpu{ 0 };   // render thread CPU time
+    std::size_t stalls = 0;                   // frames that waited for a free capture buffer
+  };
+
+  headless(const std::filesystem::path& path, GLsizei cx, GLsizei cy, GLsizei samples, std::size_t objects = 1);
+  ~headless();
+
+  // Renders the given number of frames as fast as possible.
+  // Every frame is written to the dump directory as a PNG image when it is not empty. Frames are read back
+  // asynchronously (see gl::capture) and encoded on the worker threads of the client.
+  statistics run(std::size_t frames, const std::filesystem::path& dump = {});
+
+private:
+  void create();
+  void destroy();
+
+  EGLDisplay display_ = EGL_NO_DISPLAY;
+  EGLSurface surface_ = EGL_NO_SURFACE;
+  EGLContext context_ = EGL_NO_CONTEXT;
+
+  GLsizei samples_ = 0;
+  GLuint rbo_[2] = {};
+  GLuint fbo_[2] = {};
+  GLsizei cx_ = 1;
+  GLsizei cy_ = 1;
+
+  std::unique_ptr<client> client_;
+};
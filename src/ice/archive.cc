@@ -1,31 +1,396 @@
 #include <ice/archive.h>
+#include <ice/codec.h>
 #include <ice/exception.h>
 #include <zip.h>
 #include <algorithm>
+#include <atomic>
 #include <fstream>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 namespace ice {
+namespace {
+
+// Converts a relative path to the central directory lookup key.
+// The key is case insensitive to match the behavior of mz_zip_reader_locate_file.
+std::string make_key(std::string name)
+{
+  for (auto& c : name) {
+    if (c == '\\') {
+      c = '/';
+    } else if (c >= 'A' && c <= 'Z') {
+      c = static_cast<char>(c - 'A' + 'a');
+    }
+  }
+  return name;
+}
+
+// Number of bytes that are prefetched after the entry that is being read.
+constexpr std::uint64_t readahead_window = 4 * 1024 * 1024;
+
+// Entries up to this size are decompressed in one piece with the archive codec.
+constexpr std::uint64_t inflate_limit = 16 * 1024 * 1024;
+
+// Writes the first access of every file to a trace file.
+class recorder {
+public:
+  static recorder& get()
+  {
+    static recorder recorder;
+    return recorder;
+  }
+
+  void open(const std::filesystem::path& path)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    enabled_ = false;
+    os_.close();
+    os_.clear();
+    seen_.clear();
+    if (!path.empty()) {
+      os_.open(path, std::ios::binary | std::ios::trunc);
+      if (!os_) {
+        throw ice::runtime_error("Could not create trace file.") << path.u8string();
+      }
+      enabled_ = true;
+    }
+  }
+
+  void record(const std::filesystem::path& path)
+  {
+    if (!enabled_) {
+      return;
+    }
+    auto name = path.generic_u8string();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (enabled_ && seen_.insert(make_key(name)).second) {
+      os_ << name << '\n' << std::flush;
+    }
+  }
+
+private:
+  std::mutex mutex_;
+  std::atomic<bool> enabled_{ false };
+  std::ofstream os_;
+  std::unordered_set<std::string> seen_;
+};
+
+// Asks the operating system to read file ranges ahead of time.
+// Uses posix_fadvise on POSIX systems and PrefetchVirtualMemory on a read only mapping on Windows.
+// Hints are best effort; failures disable the readahead.
+class readahead {
+public:
+  explicit readahead(const std::filesystem::path& path)
+  {
+#ifdef _WIN32
+    file_ = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE) {
+      return;
+    }
+    LARGE_INTEGER size = {};
+    if (GetFileSizeEx(file_, &size) && size.QuadPart > 0) {
+      mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      if (mapping_) {
+        view_ = MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+        size_ = static_cast<std::uint64_t>(size.QuadPart);
+      }
+    }
+#else
+    fd_ = ::open(path.c_str(), O_RDONLY);
+#endif
+  }
+
+  readahead(readahead&& other) = delete;
+  readahead(const readahead& other) = delete;
+
+  readahead& operator=(readahead&& other) = delete;
+  readahead& operator=(const readahead& other) = delete;
+
+  ~readahead()
+  {
+#ifdef _WIN32
+    if (view_) {
+      UnmapViewOfFile(view_);
+    }
+    if (mapping_) {
+      CloseHandle(mapping_);
+    }
+    if (file_ != INVALID_HANDLE_VALUE) {
+      CloseHandle(file_);
+    }
+#else
+    if (fd_ != -1) {
+      ::close(fd_);
+    }
+#endif
+  }
+
+  // Prefetches the given range unless it continues a range that was already prefetched.
+  void prefetch(std::uint64_t offset, std::uint64_t size)
+  {
+    auto begin = offset;
+    auto end = offset + size;
+    if (begin >= begin_ && begin < end_) {
+      begin = end_;
+    }
+    if (begin >= end) {
+      return;
+    }
+#ifdef _WIN32
+    if (view_ && begin < size_) {
+      WIN32_MEMORY_RANGE_ENTRY range = {};
+      range.VirtualAddress = static_cast<char*>(view_) + begin;
+      range.NumberOfBytes = static_cast<SIZE_T>(std::min(end, size_) - begin);
+      PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+#else
+    if (fd_ != -1) {
+      posix_fadvise(fd_, static_cast<off_t>(begin), static_cast<off_t>(end - begin), POSIX_FADV_WILLNEED);
+    }
+#endif
+    begin_ = offset;
+    end_ = end;
+  }
+
+private:
+#ifdef _WIN32
+  HANDLE file_ = INVALID_HANDLE_VALUE;
+  HANDLE mapping_ = nullptr;
+  void* view_ = nullptr;
+  std::uint64_t size_ = 0;
+#else
+  int fd_ = -1;
+#endif
+  std::uint64_t begin_ = 0;
+  std::uint64_t end_ = 0;
+};
+
+// Reads a little endian integer.
+template <typename T>
+T read_le(const std::uint8_t* data) noexcept
+{
+  T value = 0;
+  for (std::size_t i = 0; i < sizeof(T); i++) {
+    value = static_cast<T>(value | static_cast<T>(data[i]) << (i * 8));
+  }
+  return value;
+}
+
+// Read only memory mapping of a whole file.
+// The data is null if the file is empty or could not be mapped.
+class mapping {
+public:
+  explicit mapping(const std::filesystem::path& path)
+  {
+#ifdef _WIN32
+    const auto file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+      return;
+    }
+    LARGE_INTEGER size = {};
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+      if (const auto handle = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr)) {
+        data_ = static_cast<const std::uint8_t*>(MapViewOfFile(handle, FILE_MAP_READ, 0, 0, 0));
+        size_ = data_ ? static_cast<std::uint64_t>(size.QuadPart) : 0;
+        CloseHandle(handle);
+      }
+    }
+    CloseHandle(file);
+#else
+    const auto fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+      return;
+    }
+    struct stat info = {};
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+      const auto data = mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+      if (data != MAP_FAILED) {
+        data_ = static_cast<const std::uint8_t*>(data);
+        size_ = static_cast<std::uint64_t>(info.st_size);
+      }
+    }
+    ::close(fd);
+#endif
+  }
+
+  mapping(mapping&& other) = delete;
+  mapping(const mapping& other) = delete;
+
+  mapping& operator=(mapping&& other) = delete;
+  mapping& operator=(const mapping& other) = delete;
+
+  ~mapping()
+  {
+    if (data_) {
+#ifdef _WIN32
+      UnmapViewOfFile(data_);
+#else
+      munmap(const_cast<std::uint8_t*>(data_), static_cast<std::size_t>(size_));
+#endif
+    }
+  }
+
+  const std::uint8_t* data() const noexcept
+  {
+    return data_;
+  }
+
+  std::uint64_t size() const noexcept
+  {
+    return size_;
+  }
+
+private:
+  const std::uint8_t* data_ = nullptr;
+  std::uint64_t size_ = 0;
+};
+
+// Keeps decompressed entries in memory and evicts the least recently used entries.
+class lru {
+public:
+  archive::buffer find(const std::string& key)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!budget_) {
+      return{};
+    }
+    auto it = map_.find(key);
+    if (it == map_.end()) {
+      stats_.misses++;
+      return{};
+    }
+    list_.splice(list_.begin(), list_, it->second);
+    stats_.hits++;
+    return it->second->second;
+  }
+
+  void insert(const std::string& key, archive::buffer data)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!budget_ || data->size() > budget_ || map_.find(key) != map_.end()) {
+      return;
+    }
+    list_.emplace_front(key, std::move(data));
+    map_.emplace(key, list_.begin());
+    stats_.size += list_.front().second->size();
+    evict();
+  }
+
+  // Returns true if an entry of the given size can be cached.
+  bool fits(std::uint64_t size) const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return budget_ && size <= budget_;
+  }
+
+  void resize(std::size_t budget)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    budget_ = budget;
+    evict();
+  }
+
+  archive::cache_statistics statistics() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto stats = stats_;
+    stats.entries = map_.size();
+    stats.budget = budget_;
+    return stats;
+  }
+
+private:
+  void evict()
+  {
+    while (stats_.size > budget_ && !list_.empty()) {
+      stats_.size -= list_.back().second->size();
+      map_.erase(list_.back().first);
+      list_.pop_back();
+      stats_.evictions++;
+    }
+  }
+
+  using entry = std::pair<std::string, archive::buffer>;
+
+  mutable std::mutex mutex_;
+  std::list<entry> list_;
+  std::unordered_map<std::string, std::list<entry>::iterator> map_;
+  archive::cache_statistics stats_;
+  std::size_t budget_ = 0;
+};
+
+}  // namespace
 
 class archive::impl : public mz_zip_archive {
 public:
-  impl(const std::filesystem::path& path) : mz_zip_archive({})
+  impl(const std::filesystem::path& path) :
+    mz_zip_archive({}), filename(path), decoder(make_codec()), prefetcher(path)
   {
     is.open(path, std::ios::binary);
     if (!is) {
       throw ice::runtime_error("Could not open archive.") << path.u8string();
     }
 
-    m_pIO_opaque = &is;
+    // Only the file stream is shared between extractions, so readers lock it for every read.
+    m_pIO_opaque = this;
     m_pRead = [](void* handle, mz_uint64 offset, void* data, size_t size) -> size_t {
-      auto& is = *reinterpret_cast<std::ifstream*>(handle);
-      is.seekg(offset, std::ios::beg);
-      is.read(reinterpret_cast<char*>(data), size);
-      return static_cast<size_t>(is.gcount());
+      auto& self = *reinterpret_cast<impl*>(handle);
+      std::lock_guard<std::mutex> lock(self.io);
+      self.is.seekg(offset, std::ios::beg);
+      self.is.read(reinterpret_cast<char*>(data), size);
+      return static_cast<size_t>(self.is.gcount());
     };
 
     if (!mz_zip_reader_init(this, std::filesystem::file_size(path), 0)) {
       throw ice::runtime_error("Could not read archive.") << path.u8string();
     }
+
+    // Index the central directory.
+    auto files = mz_zip_reader_get_num_files(this);
+    std::vector<std::pair<std::uint64_t, mz_uint>> offsets;
+    index.reserve(files);
+    offsets.reserve(files);
+    methods.resize(files, 0);
+    headers.resize(files, 0);
+    for (mz_uint i = 0; i < files; i++) {
+      mz_zip_archive_file_stat stat = {};
+      if (!mz_zip_reader_file_stat(this, i, &stat)) {
+        continue;
+      }
+      offsets.emplace_back(stat.m_local_header_ofs, i);
+      headers[i] = stat.m_local_header_ofs;
+      if (mz_zip_reader_is_file_a_directory(this, i)) {
+        continue;
+      }
+      methods[i] = stat.m_method;
+      names.emplace_back(stat.m_filename);
+      entry info;
+      info.size = stat.m_uncomp_size;
+      info.compressed_size = stat.m_comp_size;
+      info.crc32 = stat.m_crc32;
+      index.emplace(make_key(stat.m_filename), std::make_pair(i, info));
+    }
+
+    // Store the offset of the entry that follows every entry in the file.
+    std::sort(offsets.begin(), offsets.end());
+    next.resize(files, m_archive_size);
+    for (std::size_t i = 0; i + 1 < offsets.size(); i++) {
+      next[offsets[i].second] = offsets[i + 1].first;
+    }
+
+    // Prefetch the beginning of the archive, which holds the first files that are read on startup.
+    prefetcher.prefetch(0, readahead_window);
   }
 
   ~impl()
@@ -33,8 +398,134 @@ public:
     mz_zip_reader_end(this);
   }
 
+  const std::pair<mz_uint, entry>* find(const std::string& key) const
+  {
+    auto it = index.find(key);
+    if (it == index.end()) {
+      return nullptr;
+    }
+    return &it->second;
+  }
+
+  // Streams the entry to the handler and prefetches the entries that follow it in the file.
+  // The handler is called without holding a lock and may read other entries of this archive.
+  bool extract(mz_uint file, read_handler& handler)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      prefetch(file);
+    }
+    auto success = mz_zip_reader_extract_to_callback(this, file,
+      [](void* handle, mz_uint64, const void* data, size_t size) -> size_t
+    {
+      auto& handler = *reinterpret_cast<read_handler*>(handle);
+      if (handler) {
+        return handler(reinterpret_cast<const std::uint8_t*>(data), size);
+      }
+      return size;
+    }, &handler, 0);
+    return success != MZ_FALSE;
+  }
+
+  // Decompresses the entry into a shared buffer with the selected codec and verifies its CRC-32.
+  // Only reading the compressed data is serialized; entries are inflated in parallel.
+  buffer extract(mz_uint file, const entry& info)
+  {
+    auto data = std::make_shared<std::vector<std::uint8_t>>(static_cast<std::size_t>(info.size));
+    std::vector<std::uint8_t> compressed;
+    std::shared_ptr<const ice::codec> codec;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      prefetch(file);
+      auto dst = data.get();
+      if (methods[file] == MZ_DEFLATED) {
+        compressed.resize(static_cast<std::size_t>(info.compressed_size));
+        dst = &compressed;
+      } else if (methods[file] != 0) {
+        return{};
+      }
+      if (!mz_zip_reader_extract_to_mem(this, file, dst->data(), dst->size(), MZ_ZIP_FLAG_COMPRESSED_DATA)) {
+        return{};
+      }
+      codec = decoder;
+    }
+    if (methods[file] == MZ_DEFLATED && !data->empty()) {
+      if (!codec->inflate(compressed.data(), compressed.size(), data->data(), data->size())) {
+        return{};
+      }
+    }
+    if (ice::crc32(0, data->data(), data->size()) != info.crc32) {
+      return{};
+    }
+    return data;
+  }
+
+  // Returns a view of a stored entry in the memory mapped archive file or an empty view if the entry
+  // is compressed or the archive cannot be mapped. The CRC-32 of mapped entries is not verified.
+  view map(mz_uint file, const entry& info)
+  {
+    if (methods[file] != 0) {
+      return{};
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!mapped) {
+      mapped = std::make_shared<const mapping>(filename);
+    }
+    prefetch(file);
+
+    // Skip the local file header, which has a variable size.
+    constexpr std::uint64_t header_size = 30;
+    const auto data = mapped->data();
+    const auto offset = headers[file];
+    if (!data || offset + header_size > mapped->size() || read_le<std::uint32_t>(data + offset) != 0x04034B50) {
+      return{};
+    }
+    const auto begin = offset + header_size + read_le<std::uint16_t>(data + offset + 26) +
+      read_le<std::uint16_t>(data + offset + 28);
+    if (begin + info.size > mapped->size()) {
+      return{};
+    }
+    view result;
+    result.data = data + begin;
+    result.size = static_cast<std::size_t>(info.size);
+    result.owner = mapped;
+    return result;
+  }
+
+  // Replaces the codec used by extract().
+  void select(std::shared_ptr<const ice::codec> codec)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    decoder = std::move(codec);
+  }
+
+  const std::vector<std::string>& files() const
+  {
+    return names;
+  }
+
+  lru cache;
+
 private:
+  void prefetch(mz_uint file)
+  {
+    if (file < next.size()) {
+      prefetcher.prefetch(next[file], readahead_window);
+    }
+  }
+
+  std::filesystem::path filename;
   std::ifstream is;
+  std::mutex io;
+  std::mutex mutex;
+  std::unordered_map<std::string, std::pair<mz_uint, entry>> index;
+  std::vector<std::string> names;
+  std::vector<mz_uint16> methods;
+  std::vector<std::uint64_t> next;
+  std::vector<std::uint64_t> headers;
+  std::shared_ptr<const ice::codec> decoder;
+  std::shared_ptr<const mapping> mapped;
+  readahead prefetcher;
 };
 
 archive::archive(std::filesystem::path path) :
@@ -61,44 +552,193 @@ archive::archive(std::filesystem::path path) :
 archive::~archive()
 {}
 
-void archive::read(const std::filesystem::path& path, read_handler handler)
+void archive::trace(const std::filesystem::path& path)
+{
+  recorder::get().open(path);
+}
+
+void archive::cache(std::size_t budget)
 {
   if (impl_) {
-    auto success = mz_zip_reader_extract_file_to_callback(impl_.get(), path.generic_string().c_str(),
-      [](void* handle, mz_uint64 offset, const void* data, size_t size) -> size_t
-    {
-      auto& handler = *reinterpret_cast<read_handler*>(handle);
-      if (handler) {
-        return handler(reinterpret_cast<const std::uint8_t*>(data), size);
-      }
-      return size;
-    }, &handler, 0);
-    if (!success) {
+    impl_->cache.resize(budget);
+  }
+}
+
+archive::cache_statistics archive::cache_stats() const
+{
+  if (impl_) {
+    return impl_->cache.statistics();
+  }
+  return{};
+}
+
+void archive::codec(const std::string& name)
+{
+  std::shared_ptr<const ice::codec> codec = make_codec(name);
+  if (impl_) {
+    impl_->select(std::move(codec));
+  }
+}
+
+std::vector<std::string> archive::list() const
+{
+  if (impl_) {
+    return impl_->files();
+  }
+  std::vector<std::string> files;
+  auto root = path_.generic_u8string();
+  while (root.size() > 1 && root.back() == '/') {
+    root.pop_back();
+  }
+  for (std::filesystem::recursive_directory_iterator it(path_), end; it != end; ++it) {
+    if (std::filesystem::is_regular_file(it->status())) {
+      files.push_back(it->path().generic_u8string().substr(root.size() + 1));
+    }
+  }
+  return files;
+}
+
+bool archive::exists(const std::filesystem::path& path) const
+{
+  std::error_code ec;
+  stat(path, ec);
+  return !ec;
+}
+
+archive::entry archive::stat(const std::filesystem::path& path) const
+{
+  std::error_code ec;
+  auto info = stat(path, ec);
+  if (ec) {
+    throw ice::runtime_error("Could not get file information.")
+      << "Archive: " << path_.u8string() << '\n'
+      << "File:    " << path.generic_u8string() << '\n'
+      << "Error:   " << ec.message();
+  }
+  return info;
+}
+
+archive::entry archive::stat(const std::filesystem::path& path, std::error_code& ec) const
+{
+  ec.clear();
+  if (impl_) {
+    if (auto file = impl_->find(make_key(path.generic_u8string()))) {
+      return file->second;
+    }
+    ec = archive_errc::not_found;
+    return{};
+  }
+  auto filename = path_ / path;
+  auto status = std::filesystem::status(filename, ec);
+  if (ec || status.type() == std::filesystem::file_type::not_found) {
+    ec = archive_errc::not_found;
+    return{};
+  }
+  if (status.type() != std::filesystem::file_type::regular) {
+    ec = archive_errc::not_a_file;
+    return{};
+  }
+  entry info;
+  info.size = std::filesystem::file_size(filename, ec);
+  if (ec) {
+    ec = archive_errc::read_failed;
+    return{};
+  }
+  info.compressed_size = info.size;
+  return info;
+}
+
+void archive::read(const std::filesystem::path& path, read_handler handler)
+{
+  std::error_code ec;
+  read(path, std::move(handler), ec);
+  if (ec) {
+    if (impl_) {
       throw ice::runtime_error("Could not extract file from archive.")
         << "Archive: " << path_.u8string() << '\n'
-        << "File:    " << path.generic_u8string();
+        << "File:    " << path.generic_u8string() << '\n'
+        << "Error:   " << ec.message();
+    }
+    auto filename = path_ / path;
+    if (ec == archive_errc::read_failed) {
+      throw ice::runtime_error("Could not read file.") << filename.u8string();
+    }
+    throw ice::runtime_error("Could not open file.")
+      << filename.u8string() << '\n' << ec.message();
+  }
+}
+
+void archive::read(const std::filesystem::path& path, read_handler handler, std::error_code& ec)
+{
+  ec.clear();
+  if (impl_) {
+    auto key = make_key(path.generic_u8string());
+    auto file = impl_->find(key);
+    if (!file) {
+      ec = archive_errc::not_found;
+      return;
+    }
+    recorder::get().record(path);
+    const auto cached = impl_->cache.fits(file->second.size);
+    if (cached || file->second.size <= inflate_limit) {
+      auto data = cached ? impl_->cache.find(key) : buffer{};
+      if (!data) {
+        data = impl_->extract(file->first, file->second);
+        if (!data) {
+          ec = archive_errc::extract_failed;
+          return;
+        }
+        if (cached) {
+          impl_->cache.insert(key, data);
+        }
+      }
+      if (handler && !data->empty()) {
+        handler(data->data(), data->size());
+      }
+      return;
+    }
+    if (!impl_->extract(file->first, handler)) {
+      ec = archive_errc::extract_failed;
     }
   } else {
     auto filename = path_ / path;
     std::ifstream is(filename, std::ios::binary | std::ios::ate);
     if (!is) {
-      throw ice::runtime_error("Could not open file.") << filename.u8string();
+      ec = exists(path) ? archive_errc::open_failed : archive_errc::not_found;
+      return;
     }
+    recorder::get().record(path);
     auto size = static_cast<std::size_t>(is.tellg());
     std::vector<std::uint8_t> data;
-    data.resize(std::min(size, 1024ULL * 1024 * 4));
+    data.resize(std::max(std::min(size, std::size_t(1024 * 1024 * 4)), std::size_t(1)));
     is.seekg(0, std::ios::beg);
     do {
       is.read(reinterpret_cast<char*>(&data[0]), data.size());
       auto bytes = static_cast<std::size_t>(is.gcount());
-      handler(data.data(), bytes);
+      if (bytes && handler) {
+        handler(data.data(), bytes);
+      }
     } while (is);
     if (is.bad()) {
-      throw ice::runtime_error("Could not read file.") << filename.u8string();
+      ec = archive_errc::read_failed;
     }
   }
 }
 
+template <>
+std::string archive::load<std::string>(const std::filesystem::path& path, std::error_code& ec)
+{
+  std::string file;
+  read(path, [&file](const std::uint8_t* data, std::size_t size) {
+    file.append(reinterpret_cast<const char*>(data), size);
+    return size;
+  }, ec);
+  if (ec) {
+    file.clear();
+  }
+  return file;
+}
+
 template <>
 std::string archive::load<std::string>(const std::filesystem::path& path)
 {
@@ -110,4 +750,106 @@ std::string archive::load<std::string>(const std::filesystem::path& path)
   return file;
 }
 
+template <>
+archive::buffer archive::load<archive::buffer>(const std::filesystem::path& path, std::error_code& ec)
+{
+  ec.clear();
+  if (impl_) {
+    auto key = make_key(path.generic_u8string());
+    auto file = impl_->find(key);
+    if (!file) {
+      ec = archive_errc::not_found;
+      return{};
+    }
+    recorder::get().record(path);
+    if (auto data = impl_->cache.find(key)) {
+      return data;
+    }
+    auto data = impl_->extract(file->first, file->second);
+    if (!data) {
+      ec = archive_errc::extract_failed;
+      return{};
+    }
+    impl_->cache.insert(key, data);
+    return data;
+  }
+  auto data = std::make_shared<std::vector<std::uint8_t>>();
+  read(path, [&data](const std::uint8_t* src, std::size_t size) {
+    data->insert(data->end(), src, src + size);
+    return size;
+  }, ec);
+  if (ec) {
+    return{};
+  }
+  return data;
+}
+
+template <>
+archive::buffer archive::load<archive::buffer>(const std::filesystem::path& path)
+{
+  std::error_code ec;
+  auto data = load<archive::buffer>(path, ec);
+  if (ec) {
+    throw ice::runtime_error("Could not load file.")
+      << "Archive: " << path_.u8string() << '\n'
+      << "File:    " << path.generic_u8string() << '\n'
+      << "Error:   " << ec.message();
+  }
+  return data;
+}
+
+template <>
+archive::view archive::load<archive::view>(const std::filesystem::path& path, std::error_code& ec)
+{
+  ec.clear();
+  if (impl_) {
+    auto key = make_key(path.generic_u8string());
+    auto file = impl_->find(key);
+    if (!file) {
+      ec = archive_errc::not_found;
+      return{};
+    }
+    recorder::get().record(path);
+    auto result = impl_->map(file->first, file->second);
+    if (result.owner) {
+      return result;
+    }
+  } else {
+    const auto file = std::make_shared<const mapping>(path_ / path);
+    if (file->data()) {
+      recorder::get().record(path);
+      view result;
+      result.data = file->data();
+      result.size = static_cast<std::size_t>(file->size());
+      result.owner = file;
+      return result;
+    }
+  }
+
+  // Decompress entries that are compressed and read files that could not be mapped.
+  auto data = load<archive::buffer>(path, ec);
+  if (ec) {
+    return{};
+  }
+  view result;
+  result.data = data->data();
+  result.size = data->size();
+  result.owner = data;
+  return result;
+}
+
+template <>
+archive::view archive::load<archive::view>(const std::filesystem::path& path)
+{
+  std::error_code ec;
+  auto data = load<archive::view>(path, ec);
+  if (ec) {
+    throw ice::runtime_error("Could not load file.")
+      << "Archive: " << path_.u8string() << '\n'
+      << "File:    " << path.generic_u8string() << '\n'
+      << "Error:   " << ec.message();
+  }
+  return data;
+}
+
 }  // namespace ice
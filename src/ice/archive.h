@@ -2,27 +2,129 @@
 #include <filesystem>
 #include <functional>
 #include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
 #include <cstdint>
 
 namespace ice {
 
+enum class archive_errc {
+  success = 0,
+  not_found,
+  not_a_file,
+  open_failed,
+  read_failed,
+  extract_failed,
+};
+
+class archive_category : public std::error_category {
+public:
+  const char* name() const noexcept override
+  {
+    return "Archive Error";
+  }
+
+  std::string message(int code) const override
+  {
+    switch (static_cast<archive_errc>(code)) {
+    case archive_errc::success: return "Success.";
+    case archive_errc::not_found: return "The file does not exist.";
+    case archive_errc::not_a_file: return "The path does not refer to a regular file.";
+    case archive_errc::open_failed: return "Could not open the file.";
+    case archive_errc::read_failed: return "Could not read the file.";
+    case archive_errc::extract_failed: return "Could not extract the file from the archive.";
+    }
+    return "Unknown error code: " + std::to_string(code);
+  }
+
+  static archive_category& get()
+  {
+    static archive_category category;
+    return category;
+  }
+};
+
+inline std::error_code make_error_code(archive_errc code)
+{
+  return std::error_code(static_cast<int>(code), archive_category::get());
+}
+
 // Reads files from the given zip archive file or base directory.
 class archive {
 public:
   using read_handler = std::function<std::size_t(const std::uint8_t* data, std::size_t size)>;
 
+  // Shared file contents that can be held without copying, even after the entry was evicted from the cache.
+  using buffer = std::shared_ptr<const std::vector<std::uint8_t>>;
+
+  // Read only file contents that stay valid while the view is held, even after the archive was destroyed.
+  // Views of stored (uncompressed) archive entries and plain files point into a memory mapping of the file.
+  // Mapped archive entries are not verified against their CRC-32.
+  struct view {
+    const std::uint8_t* data = nullptr;
+    std::size_t size = 0;
+    std::shared_ptr<const void> owner;
+  };
+
+  // Archive or base directory file information.
+  struct entry {
+    std::uint64_t size = 0;             // uncompressed size in bytes
+    std::uint64_t compressed_size = 0;  // equal to size for stored and plain files
+    std::uint32_t crc32 = 0;            // zero for plain files
+  };
+
+  // Decompressed entry cache statistics.
+  struct cache_statistics {
+    std::uint64_t hits = 0;       // reads that were served from the cache
+    std::uint64_t misses = 0;     // reads of entries that had to be decompressed
+    std::uint64_t evictions = 0;  // entries that were removed to stay within the budget
+    std::size_t entries = 0;      // number of cached entries
+    std::size_t size = 0;         // cached bytes
+    std::size_t budget = 0;       // maximum number of cached bytes
+  };
+
   // Opens an archive file or base directory.
   archive(std::filesystem::path path);
   ~archive();
 
+  // Records the first access of every file read by any archive into a trace file, one path per line.
+  // The trace orders the pack entries by first access (see ice::create_pack). An empty path stops recording.
+  static void trace(const std::filesystem::path& path);
+
+  // Keeps up to budget bytes of decompressed archive entries in memory and evicts the least recently used
+  // entries when the budget is exceeded. A budget of zero disables the cache (default). Entries that are
+  // larger than the budget are streamed. Base directories are never cached.
+  void cache(std::size_t budget);
+  cache_statistics cache_stats() const;
+
+  // Selects the codec that inflates archive entries by name (see ice::codecs).
+  // Entries that are larger than the cache budget and 16 MiB are streamed with miniz.
+  void codec(const std::string& name);
+
+  // Returns the relative names of all files in archive order (UTF-8, separated by '/').
+  std::vector<std::string> list() const;
+
+  // Checks if a file exists without throwing or reading its contents.
+  // Archive lookups are answered from the central directory index.
+  bool exists(const std::filesystem::path& path) const;
+
+  // Returns the file information.
+  entry stat(const std::filesystem::path& path) const;
+  entry stat(const std::filesystem::path& path, std::error_code& ec) const;
+
   // Reads a file from the archive or base directory.
   void read(const std::filesystem::path& path, read_handler handler);
+  void read(const std::filesystem::path& path, read_handler handler, std::error_code& ec);
 
   // Returns the file contents as a specific type.
-  // See archive.cc for supported types.
+  // See archive.cc for supported types. Reads are thread safe.
   template <typename T>
   T load(const std::filesystem::path& path);
 
+  template <typename T>
+  T load(const std::filesystem::path& path, std::error_code& ec);
+
 private:
   class impl;
   std::unique_ptr<impl> impl_;
@@ -30,3 +132,10 @@ private:
 };
 
 }  // namespace ice
+
+namespace std {
+
+template<>
+struct is_error_code_enum<ice::archive_errc> : true_type {};
+
+}  // namespace std
@@ -0,0 +1,75 @@
+#include <ice/arena.h>
+#include <ice/exception.h>
+#include <algorithm>
+
+namespace ice {
+
+frame_arena::frame_arena(std::size_t capacity, std::size_t frames) :
+  frames_(std::max(frames, std::size_t(1)))
+{
+  for (auto& frame : frames_) {
+    frame.data = std::make_unique<std::uint8_t[]>(capacity);
+    frame.capacity = capacity;
+  }
+  stats_.capacity = capacity;
+}
+
+frame_arena::~frame_arena()
+{}
+
+void frame_arena::begin()
+{
+  index_ = (index_ + 1) % frames_.size();
+  auto& frame = frames_[index_];
+
+  // Grow the block to fit the last use of this frame.
+  if (frame.overflow) {
+    const auto capacity = std::max(frame.capacity * 2, frame.used + frame.overflow);
+    frame.data = std::make_unique<std::uint8_t[]>(capacity);
+    frame.capacity = capacity;
+  }
+  frame.blocks.clear();
+  frame.used = 0;
+  frame.overflow = 0;
+
+  stats_.capacity = frame.capacity;
+  stats_.used = 0;
+  stats_.frames++;
+}
+
+void* frame_arena::allocate(std::size_t size, std::size_t alignment)
+{
+  if (!alignment || (alignment & (alignment - 1))) {
+    throw ice::runtime_error("Invalid frame arena alignment.") << alignment;
+  }
+  auto& frame = frames_[index_];
+  const auto base = reinterpret_cast<std::uintptr_t>(frame.data.get());
+  const auto offset = ((base + frame.used + alignment - 1) & ~(alignment - 1)) - base;
+  if (offset + size <= frame.capacity) {
+    frame.used = offset + size;
+    stats_.used = frame.used + frame.overflow;
+    stats_.peak = std::max(stats_.peak, stats_.used);
+    return frame.data.get() + offset;
+  }
+
+  // Serve the allocation from the heap until the frame is reused.
+  frame.blocks.push_back(std::make_unique<std::uint8_t[]>(size + alignment - 1));
+  const auto data = reinterpret_cast<std::uintptr_t>(frame.blocks.back().get());
+  frame.overflow += size + alignment - 1;
+  stats_.used = frame.used + frame.overflow;
+  stats_.peak = std::max(stats_.peak, stats_.used);
+  stats_.overflows++;
+  return reinterpret_cast<void*>((data + alignment - 1) & ~(alignment - 1));
+}
+
+std::size_t frame_arena::frames() const noexcept
+{
+  return frames_.size();
+}
+
+frame_arena::statistics frame_arena::stats() const noexcept
+{
+  return stats_;
+}
+
+}  // namespace ice
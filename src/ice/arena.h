@@ -0,0 +1,110 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace ice {
+
+// Linear allocator for data that lives at most for a few frames.
+// Every frame allocates from its own block by bumping an offset and the block is reset when the frame is
+// reused, so frame data stays valid while the following frames are built (double or triple buffering).
+// Allocations that do not fit are served from the heap and the block grows when its frame is reused,
+// so that steady state frames do not allocate from the heap. Not thread safe.
+class frame_arena {
+public:
+  struct statistics {
+    std::size_t capacity = 0;     // size of the current frame block
+    std::size_t used = 0;         // bytes allocated in the current frame
+    std::size_t peak = 0;         // most bytes allocated in a single frame
+    std::uint64_t frames = 0;     // number of started frames
+    std::uint64_t overflows = 0;  // allocations that were served from the heap
+  };
+
+  explicit frame_arena(std::size_t capacity = 256 * 1024, std::size_t frames = 2);
+
+  frame_arena(frame_arena&& other) = delete;
+  frame_arena(const frame_arena& other) = delete;
+
+  frame_arena& operator=(frame_arena&& other) = delete;
+  frame_arena& operator=(const frame_arena& other) = delete;
+
+  ~frame_arena();
+
+  // Starts the next frame and releases all allocations of the frame that was started frames() frames ago.
+  // Call this function after the fence of that frame signaled when the GPU reads the data directly.
+  void begin();
+
+  // Allocates memory in the current frame. The alignment must be a power of two.
+  void* allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t));
+
+  // Returns the number of frames that are kept alive.
+  std::size_t frames() const noexcept;
+
+  statistics stats() const noexcept;
+
+private:
+  struct frame {
+    std::unique_ptr<std::uint8_t[]> data;
+    std::size_t capacity = 0;
+    std::size_t used = 0;
+    std::size_t overflow = 0;
+    std::vector<std::unique_ptr<std::uint8_t[]>> blocks;
+  };
+
+  std::vector<frame> frames_;
+  std::size_t index_ = 0;
+  statistics stats_;
+};
+
+// Allocator for standard containers that allocates from a frame arena.
+// Deallocation is a no-op; the memory is released with the frame.
+template <typename T>
+class arena_allocator {
+public:
+  using value_type = T;
+
+  arena_allocator(frame_arena& arena) noexcept : arena_(&arena)
+  {}
+
+  template <typename U>
+  arena_allocator(const arena_allocator<U>& other) noexcept : arena_(other.arena())
+  {}
+
+  T* allocate(std::size_t n)
+  {
+    return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T*, std::size_t) noexcept
+  {}
+
+  frame_arena* arena() const noexcept
+  {
+    return arena_;
+  }
+
+private:
+  frame_arena* arena_ = nullptr;
+};
+
+template <typename T, typename U>
+inline bool operator==(const arena_allocator<T>& a, const arena_allocator<U>& b) noexcept
+{
+  return a.arena() == b.arena();
+}
+
+template <typename T, typename U>
+inline bool operator!=(const arena_allocator<T>& a, const arena_allocator<U>& b) noexcept
+{
+  return a.arena() != b.arena();
+}
+
+// Containers that allocate from a frame arena. They must not outlive the frame.
+template <typename T>
+using frame_vector = std::vector<T, arena_allocator<T>>;
+
+using frame_string = std::basic_string<char, std::char_traits<char>, arena_allocator<char>>;
+
+}  // namespace ice
@@ -0,0 +1,209 @@
+#include <ice/bvh.h>
+#include <ice/exception.h>
+
+namespace ice {
+
+constexpr std::uint32_t bvh::null;
+
+std::uint32_t bvh::insert(const aabb& box, std::uint32_t data)
+{
+  const auto leaf = allocate();
+  auto& node = nodes_[leaf];
+  for (auto i = 0; i < 3; i++) {
+    node.box.min[i] = box.min[i] - margin_;
+    node.box.max[i] = box.max[i] + margin_;
+  }
+  node.data = data;
+  node.height = 0;
+  insert_leaf(leaf);
+  leaves_++;
+  return leaf;
+}
+
+void bvh::remove(std::uint32_t proxy)
+{
+  if (proxy >= nodes_.size() || !nodes_[proxy].leaf() || nodes_[proxy].height < 0) {
+    throw ice::runtime_error("Invalid bounding volume hierarchy proxy.") << proxy;
+  }
+  remove_leaf(proxy);
+  release(proxy);
+  leaves_--;
+}
+
+bool bvh::move(std::uint32_t proxy, const aabb& box)
+{
+  if (contains(nodes_[proxy].box, box)) {
+    return false;
+  }
+  remove_leaf(proxy);
+  auto& node = nodes_[proxy];
+  for (auto i = 0; i < 3; i++) {
+    node.box.min[i] = box.min[i] - margin_;
+    node.box.max[i] = box.max[i] + margin_;
+  }
+  insert_leaf(proxy);
+  return true;
+}
+
+std::uint32_t bvh::allocate()
+{
+  if (free_ == null) {
+    nodes_.emplace_back();
+    return static_cast<std::uint32_t>(nodes_.size() - 1);
+  }
+  const auto index = free_;
+  free_ = nodes_[index].parent;
+  nodes_[index] = node();
+  return index;
+}
+
+void bvh::release(std::uint32_t index)
+{
+  nodes_[index] = node();
+  nodes_[index].parent = free_;
+  free_ = index;
+}
+
+void bvh::insert_leaf(std::uint32_t leaf)
+{
+  if (root_ == null) {
+    root_ = leaf;
+    nodes_[leaf].parent = null;
+    return;
+  }
+
+  // Find the sibling that increases the surface area of the tree the least.
+  const auto box = nodes_[leaf].box;
+  auto index = root_;
+  while (!nodes_[index].leaf()) {
+    const auto& node = nodes_[index];
+    const auto combined = area(merge(node.box, box));
+
+    // Cost of creating a new parent for this node and the new leaf.
+    const auto cost = 2.0f * combined;
+
+    // Minimum cost of pushing the leaf further down the tree.
+    const auto inheritance = 2.0f * (combined - area(node.box));
+    float costs[2];
+    for (auto i = 0; i < 2; i++) {
+      const auto& child = nodes_[node.child[i]];
+      costs[i] = area(merge(box, child.box)) + inheritance;
+      if (!child.leaf()) {
+        costs[i] -= area(child.box);
+      }
+    }
+    if (cost < costs[0] && cost < costs[1]) {
+      break;
+    }
+    index = costs[0] < costs[1] ? node.child[0] : node.child[1];
+  }
+  const auto sibling = index;
+
+  // Create a new parent for the sibling and the leaf.
+  const auto old_parent = nodes_[sibling].parent;
+  const auto new_parent = allocate();
+  nodes_[new_parent].parent = old_parent;
+  nodes_[new_parent].box = merge(box, nodes_[sibling].box);
+  nodes_[new_parent].height = nodes_[sibling].height + 1;
+  nodes_[new_parent].child[0] = sibling;
+  nodes_[new_parent].child[1] = leaf;
+  nodes_[sibling].parent = new_parent;
+  nodes_[leaf].parent = new_parent;
+  if (old_parent == null) {
+    root_ = new_parent;
+  } else if (nodes_[old_parent].child[0] == sibling) {
+    nodes_[old_parent].child[0] = new_parent;
+  } else {
+    nodes_[old_parent].child[1] = new_parent;
+  }
+
+  // Refit and balance the ancestors.
+  refit(nodes_[leaf].parent);
+}
+
+void bvh::remove_leaf(std::uint32_t leaf)
+{
+  if (leaf == root_) {
+    root_ = null;
+    return;
+  }
+  const auto parent = nodes_[leaf].parent;
+  const auto grandparent = nodes_[parent].parent;
+  const auto sibling = nodes_[parent].child[0] == leaf ? nodes_[parent].child[1] : nodes_[parent].child[0];
+  release(parent);
+  nodes_[leaf].parent = null;
+  if (grandparent == null) {
+    root_ = sibling;
+    nodes_[sibling].parent = null;
+    return;
+  }
+  if (nodes_[grandparent].child[0] == parent) {
+    nodes_[grandparent].child[0] = sibling;
+  } else {
+    nodes_[grandparent].child[1] = sibling;
+  }
+  nodes_[sibling].parent = grandparent;
+  refit(grandparent);
+}
+
+void bvh::refit(std::uint32_t index)
+{
+  while (index != null) {
+    index = balance(index);
+    auto& node = nodes_[index];
+    const auto& a = nodes_[node.child[0]];
+    const auto& b = nodes_[node.child[1]];
+    node.height = 1 + std::max(a.height, b.height);
+    node.box = merge(a.box, b.box);
+    index = node.parent;
+  }
+}
+
+std::uint32_t bvh::balance(std::uint32_t ia)
+{
+  auto& a = nodes_[ia];
+  if (a.leaf() || a.height < 2) {
+    return ia;
+  }
+
+  // Rotate the higher child up when the heights of the children differ by more than one.
+  const auto ib = a.child[0];
+  const auto ic = a.child[1];
+  const auto difference = nodes_[ic].height - nodes_[ib].height;
+  if (difference >= -1 && difference <= 1) {
+    return ia;
+  }
+  const auto up = difference > 1 ? 1 : 0;  // index of the child that moves up
+  const auto iu = a.child[up];
+  const auto is = a.child[1 - up];
+  auto& u = nodes_[iu];
+  auto& s = nodes_[is];
+
+  // Replace the node with the child.
+  u.parent = a.parent;
+  a.parent = iu;
+  if (u.parent == null) {
+    root_ = iu;
+  } else if (nodes_[u.parent].child[0] == ia) {
+    nodes_[u.parent].child[0] = iu;
+  } else {
+    nodes_[u.parent].child[1] = iu;
+  }
+
+  // Keep the higher grandchild below the child and move the lower grandchild below the node.
+  const auto i0 = u.child[0];
+  const auto i1 = u.child[1];
+  const auto higher = nodes_[i0].height > nodes_[i1].height ? i0 : i1;
+  const auto lower = higher == i0 ? i1 : i0;
+  u.child[0] = ia;
+  u.child[1] = higher;
+  a.child[up] = lower;
+  nodes_[lower].parent = ia;
+  a.box = merge(s.box, nodes_[lower].box);
+  a.height = 1 + std::max(s.height, nodes_[lower].height);
+  u.box = merge(a.box, nodes_[higher].box);
+  u.height = 1 + std::max(a.height, nodes_[higher].height);
+  return iu;
+}
+
+}  // namespace ice
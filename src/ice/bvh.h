@@ -0,0 +1,196 @@
+#pragma once
+#include <algorithm>
+#include <vector>
+#include <cstdint>
+
+namespace ice {
+
+// Axis aligned bounding box.
+struct aabb {
+  float min[3];
+  float max[3];
+};
+
+inline aabb merge(const aabb& a, const aabb& b) noexcept
+{
+  aabb box;
+  for (auto i = 0; i < 3; i++) {
+    box.min[i] = std::min(a.min[i], b.min[i]);
+    box.max[i] = std::max(a.max[i], b.max[i]);
+  }
+  return box;
+}
+
+// Returns the surface area, which estimates the probability that a query hits the box.
+inline float area(const aabb& box) noexcept
+{
+  const auto x = box.max[0] - box.min[0];
+  const auto y = box.max[1] - box.min[1];
+  const auto z = box.max[2] - box.min[2];
+  return 2.0f * (x * y + y * z + z * x);
+}
+
+inline bool contains(const aabb& outer, const aabb& inner) noexcept
+{
+  for (auto i = 0; i < 3; i++) {
+    if (inner.min[i] < outer.min[i] || inner.max[i] > outer.max[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// View frustum described by six planes (a, b, c, d) with ax + by + cz + d >= 0 inside.
+struct frustum {
+  enum class result {
+    outside,
+    intersects,
+    inside,
+  };
+
+  float planes[6][4];
+
+  // Extracts the planes from a column major view projection matrix with OpenGL clip space conventions.
+  static frustum from_matrix(const float* m) noexcept
+  {
+    frustum value;
+    for (auto i = 0; i < 3; i++) {
+      for (auto j = 0; j < 4; j++) {
+        value.planes[i * 2 + 0][j] = m[j * 4 + 3] + m[j * 4 + i];
+        value.planes[i * 2 + 1][j] = m[j * 4 + 3] - m[j * 4 + i];
+      }
+    }
+    return value;
+  }
+
+  // Classifies the box by testing its corners that are the farthest along and against every plane normal.
+  result classify(const aabb& box) const noexcept
+  {
+    auto value = result::inside;
+    for (const auto& plane : planes) {
+      auto outer = plane[3];
+      auto inner = plane[3];
+      for (auto i = 0; i < 3; i++) {
+        outer += plane[i] * (plane[i] > 0.0f ? box.max[i] : box.min[i]);
+        inner += plane[i] * (plane[i] > 0.0f ? box.min[i] : box.max[i]);
+      }
+      if (outer < 0.0f) {
+        return result::outside;
+      }
+      if (inner < 0.0f) {
+        value = result::intersects;
+      }
+    }
+    return value;
+  }
+};
+
+// Dynamic bounding volume hierarchy of fat boxes.
+// Leaves are inserted next to the sibling with the lowest surface area cost and the tree is kept balanced
+// with rotations. Leaf boxes are enlarged by a margin so that small movements do not change the tree.
+class bvh {
+public:
+  static constexpr std::uint32_t null = 0xFFFFFFFF;
+
+  explicit bvh(float margin = 0.1f) : margin_(margin)
+  {}
+
+  // Inserts a box and returns its proxy. The data is passed to the query handler.
+  std::uint32_t insert(const aabb& box, std::uint32_t data);
+
+  // Removes a proxy.
+  void remove(std::uint32_t proxy);
+
+  // Updates the box of a proxy. Returns true if the proxy left its fat box and was reinserted.
+  bool move(std::uint32_t proxy, const aabb& box);
+
+  std::uint32_t data(std::uint32_t proxy) const noexcept
+  {
+    return nodes_[proxy].data;
+  }
+
+  // Returns the height of the tree.
+  int height() const noexcept
+  {
+    return root_ == null ? 0 : nodes_[root_].height;
+  }
+
+  // Returns the number of leaves.
+  std::size_t size() const noexcept
+  {
+    return leaves_;
+  }
+
+  // Calls the handler with the data of every leaf whose fat box is not outside of the frustum.
+  // Subtrees that are completely inside of the frustum are reported without further tests.
+  // Not thread safe; the traversal stack is shared.
+  template <typename Handler>
+  void query(const ice::frustum& frustum, Handler&& handler) const
+  {
+    if (root_ == null) {
+      return;
+    }
+    stack_.clear();
+    stack_.push_back(root_);
+    while (!stack_.empty()) {
+      const auto index = stack_.back();
+      stack_.pop_back();
+      const auto& node = nodes_[index];
+      const auto result = frustum.classify(node.box);
+      if (result == ice::frustum::result::outside) {
+        continue;
+      }
+      if (node.leaf()) {
+        handler(node.data);
+        continue;
+      }
+      if (result == ice::frustum::result::intersects) {
+        stack_.push_back(node.child[0]);
+        stack_.push_back(node.child[1]);
+        continue;
+      }
+      const auto base = stack_.size();
+      stack_.push_back(index);
+      while (stack_.size() > base) {
+        const auto& inner = nodes_[stack_.back()];
+        stack_.pop_back();
+        if (inner.leaf()) {
+          handler(inner.data);
+        } else {
+          stack_.push_back(inner.child[0]);
+          stack_.push_back(inner.child[1]);
+        }
+      }
+    }
+  }
+
+private:
+  struct node {
+    aabb box;
+    std::uint32_t parent = null;  // next free node for free nodes
+    std::uint32_t child[2] = { null, null };
+    std::uint32_t data = 0;
+    int height = -1;  // 0 for leaves, -1 for free nodes
+
+    bool leaf() const noexcept
+    {
+      return child[0] == null;
+    }
+  };
+
+  std::uint32_t allocate();
+  void release(std::uint32_t index);
+  void insert_leaf(std::uint32_t leaf);
+  void remove_leaf(std::uint32_t leaf);
+  void refit(std::uint32_t index);
+  std::uint32_t balance(std::uint32_t index);
+
+  std::vector<node> nodes_;
+  std::uint32_t root_ = null;
+  std::uint32_t free_ = null;
+  std::size_t leaves_ = 0;
+  float margin_ = 0.1f;
+  mutable std::vector<std::uint32_t> stack_;
+};
+
+}  // namespace ice
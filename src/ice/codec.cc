@@ -0,0 +1,225 @@
+#include <ice/codec.h>
+#include <ice/exception.h>
+#include <zip.h>
+#include <zlib.h>
+#include <algorithm>
+#include <limits>
+#include <cstring>
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define ICE_CRC32_CLMUL 1
+#include <emmintrin.h>
+#include <smmintrin.h>
+#include <wmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#elif defined(__ARM_FEATURE_CRC32)
+#define ICE_CRC32_ARM 1
+#include <arm_acle.h>
+#endif
+
+namespace ice {
+namespace {
+
+// Inflates with the zlib library.
+class zlib_codec : public codec {
+public:
+  const char* name() const noexcept override
+  {
+    return "zlib";
+  }
+
+  bool inflate(const std::uint8_t* src, std::size_t src_size, std::uint8_t* dst, std::size_t size) const override
+  {
+    z_stream stream = {};
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+      return false;
+    }
+    constexpr std::size_t chunk = std::numeric_limits<uInt>::max();
+    stream.next_in = const_cast<Bytef*>(src);
+    stream.next_out = dst;
+    auto result = Z_OK;
+    do {
+      if (!stream.avail_in) {
+        stream.avail_in = static_cast<uInt>(std::min(src_size - static_cast<std::size_t>(stream.next_in - src), chunk));
+      }
+      if (!stream.avail_out) {
+        stream.avail_out = static_cast<uInt>(std::min(size - static_cast<std::size_t>(stream.next_out - dst), chunk));
+      }
+      result = ::inflate(&stream, Z_NO_FLUSH);
+    } while (result == Z_OK);
+    const auto written = static_cast<std::size_t>(stream.next_out - dst);
+    inflateEnd(&stream);
+    return result == Z_STREAM_END && written == size;
+  }
+};
+
+// Inflates with the miniz library (tinfl).
+class miniz_codec : public codec {
+public:
+  const char* name() const noexcept override
+  {
+    return "miniz";
+  }
+
+  bool inflate(const std::uint8_t* src, std::size_t src_size, std::uint8_t* dst, std::size_t size) const override
+  {
+    const auto written = tinfl_decompress_mem_to_mem(dst, size, src, src_size, 0);
+    return written != TINFL_DECOMPRESS_MEM_TO_MEM_FAILED && written == size;
+  }
+};
+
+#ifdef ICE_CRC32_CLMUL
+
+#ifdef __GNUC__
+#define ICE_TARGET_CLMUL __attribute__((target("pclmul,sse4.1")))
+#else
+#define ICE_TARGET_CLMUL
+#endif
+
+bool has_clmul()
+{
+#ifdef _MSC_VER
+  int info[4] = {};
+  __cpuid(info, 1);
+  const auto ecx = static_cast<unsigned>(info[2]);
+#else
+  unsigned eax = 0;
+  unsigned ebx = 0;
+  unsigned ecx = 0;
+  unsigned edx = 0;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+    return false;
+  }
+#endif
+  return (ecx & (1 << 1)) && (ecx & (1 << 19));  // PCLMULQDQ and SSE4.1
+}
+
+// Folds 64 byte blocks with carry-less multiplication and reduces the result with a Barrett reduction.
+// See "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction" (Intel, 2009).
+// The size must be a multiple of 16 and at least 64. The crc is the inverted CRC-32 state.
+ICE_TARGET_CLMUL std::uint32_t crc32_clmul(std::uint32_t crc, const std::uint8_t* data, std::size_t size)
+{
+  alignas(16) static const std::uint64_t k1k2[] = { 0x0154442bd4, 0x01c6e41596 };
+  alignas(16) static const std::uint64_t k3k4[] = { 0x01751997d0, 0x00ccaa009e };
+  alignas(16) static const std::uint64_t k5k0[] = { 0x0163cd6124, 0x0000000000 };
+  alignas(16) static const std::uint64_t poly[] = { 0x01db710641, 0x01f7011641 };
+
+  auto x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x00));
+  auto x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x10));
+  auto x3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x20));
+  auto x4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x30));
+  x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(static_cast<int>(crc)));
+  auto x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(k1k2));
+  data += 64;
+  size -= 64;
+
+  // Fold four blocks in parallel.
+  while (size >= 64) {
+    const auto x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    const auto x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    const auto x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+    const auto x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+    x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+    x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x00)));
+    x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x10)));
+    x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x20)));
+    x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x30)));
+    data += 64;
+    size -= 64;
+  }
+
+  // Fold into 128 bits.
+  x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(k3k4));
+  for (auto x : { x2, x3, x4 }) {
+    const auto x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x), x5);
+  }
+
+  // Fold the remaining 16 byte blocks.
+  while (size >= 16) {
+    const auto x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data))), x5);
+    data += 16;
+    size -= 16;
+  }
+
+  // Fold 128 bits to 64 bits.
+  const auto mask = _mm_setr_epi32(~0, 0, ~0, 0);
+  x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), _mm_clmulepi64_si128(x1, x0, 0x10));
+  x0 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(k5k0));
+  x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, mask), x0, 0x00), _mm_srli_si128(x1, 4));
+
+  // Reduce to 32 bits.
+  x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(poly));
+  x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask), x0, 0x10);
+  x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, mask), x0, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+  return static_cast<std::uint32_t>(_mm_extract_epi32(x1, 1));
+}
+
+#endif
+
+}  // namespace
+
+std::unique_ptr<codec> make_codec(const std::string& name)
+{
+  if (name.empty() || name == "zlib") {
+    return std::make_unique<zlib_codec>();
+  }
+  if (name == "miniz") {
+    return std::make_unique<miniz_codec>();
+  }
+  throw ice::runtime_error("Unknown codec.") << name;
+}
+
+std::vector<std::string> codecs()
+{
+  return{ "zlib", "miniz" };
+}
+
+std::uint32_t crc32(std::uint32_t crc, const std::uint8_t* data, std::size_t size)
+{
+#ifdef ICE_CRC32_CLMUL
+  static const auto clmul = has_clmul();
+  if (clmul && size >= 64) {
+    const auto blocks = size & ~std::size_t(15);
+    crc = ~crc32_clmul(~crc, data, blocks);
+    data += blocks;
+    size -= blocks;
+  }
+#elif defined(ICE_CRC32_ARM)
+  crc = ~crc;
+  for (; size >= 8; data += 8, size -= 8) {
+    std::uint64_t value;
+    std::memcpy(&value, data, sizeof(value));
+    crc = __crc32d(crc, value);
+  }
+  for (; size > 0; data++, size--) {
+    crc = __crc32b(crc, *data);
+  }
+  crc = ~crc;
+#endif
+  return crc32_table(crc, data, size);
+}
+
+std::uint32_t crc32_table(std::uint32_t crc, const std::uint8_t* data, std::size_t size)
+{
+  constexpr std::size_t chunk = std::numeric_limits<uInt>::max();
+  while (size > 0) {
+    const auto bytes = std::min(size, chunk);
+    crc = static_cast<std::uint32_t>(::crc32(crc, data, static_cast<uInt>(bytes)));
+    data += bytes;
+    size -= bytes;
+  }
+  return crc;
+}
+
+}  // namespace ice
@@ -0,0 +1,38 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace ice {
+
+// Decompresses raw deflate streams (zip compression method 8).
+// Implementations are stateless and can be used from multiple threads.
+class codec {
+public:
+  virtual ~codec() = default;
+
+  // Returns the codec name.
+  virtual const char* name() const noexcept = 0;
+
+  // Inflates the compressed data into the output buffer.
+  // Returns false if the data is corrupt or does not decompress to exactly size bytes.
+  virtual bool inflate(const std::uint8_t* src, std::size_t src_size, std::uint8_t* dst, std::size_t size) const = 0;
+};
+
+// Creates the codec with the given name (see ice::codecs) or the default codec for an empty name.
+// Throws ice::runtime_error for unknown names.
+std::unique_ptr<codec> make_codec(const std::string& name = {});
+
+// Returns the names of all codecs. The first codec is the default.
+// Use "pack bench" to compare the codecs on the target machine.
+std::vector<std::string> codecs();
+
+// Updates a zip CRC-32 value (initial value 0).
+// Uses carry-less multiplication (PCLMULQDQ) or the ARMv8 CRC instructions when the CPU supports them.
+std::uint32_t crc32(std::uint32_t crc, const std::uint8_t* data, std::size_t size);
+
+// Same as ice::crc32 without hardware acceleration.
+std::uint32_t crc32_table(std::uint32_t crc, const std::uint8_t* data, std::size_t size);
+
+}  // namespace ice
@@ -0,0 +1,100 @@
+#include <ice/hdr.h>
+#include <ice/exception.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace ice {
+
+hdr_reader::hdr_reader(const std::uint8_t* data, std::size_t size) :
+  data_(data), end_(data + size)
+{
+  // Read the header lines up to the empty line and the resolution line after it.
+  const auto line = [this]() {
+    const auto begin = data_;
+    const auto end = std::find(data_, end_, static_cast<std::uint8_t>('\n'));
+    if (end == end_) {
+      throw ice::runtime_error("Invalid HDR header.");
+    }
+    data_ = end + 1;
+    return std::string(reinterpret_cast<const char*>(begin), reinterpret_cast<const char*>(end));
+  };
+  const auto magic = line();
+  if (magic != "#?RADIANCE" && magic != "#?RGBE") {
+    throw ice::runtime_error("Invalid HDR identifier.");
+  }
+  for (auto entry = line(); !entry.empty(); entry = line()) {
+    if (entry.compare(0, 7, "FORMAT=") == 0 && entry != "FORMAT=32-bit_rle_rgbe") {
+      throw ice::runtime_error("Unsupported HDR format.") << entry;
+    }
+  }
+  const auto resolution = line();
+  char* end = nullptr;
+  if (resolution.compare(0, 3, "-Y ") == 0) {
+    cy_ = std::strtoul(resolution.c_str() + 3, &end, 10);
+  }
+  if (!end || std::strncmp(end, " +X ", 4) != 0) {
+    throw ice::runtime_error("Unsupported HDR orientation.") << resolution;
+  }
+  cx_ = std::strtoul(end + 4, nullptr, 10);
+  if (cx_ < 1 || cy_ < 1) {
+    throw ice::runtime_error("Invalid HDR size.") << resolution;
+  }
+  rgbe_.resize(cx_ * 4);
+}
+
+void hdr_reader::read(float* rgb)
+{
+  if (row_ >= cy_) {
+    throw ice::runtime_error("Could not read past the last HDR row.");
+  }
+  const auto available = static_cast<std::size_t>(end_ - data_);
+  const auto truncated = [this]() {
+    return ice::runtime_error("Truncated HDR row.") << "Row: " << row_;
+  };
+
+  // Rows between 8 and 32767 pixels may be run length encoded one component at a time.
+  if (cx_ >= 8 && cx_ < 0x8000 && available >= 4 && data_[0] == 2 && data_[1] == 2 && !(data_[2] & 0x80)) {
+    if ((static_cast<std::size_t>(data_[2]) << 8 | data_[3]) != cx_) {
+      throw ice::runtime_error("Invalid HDR row length.") << "Row: " << row_;
+    }
+    data_ += 4;
+    for (std::size_t component = 0; component < 4; component++) {
+      for (std::size_t x = 0; x < cx_;) {
+        if (data_ == end_) {
+          throw truncated();
+        }
+        const auto count = static_cast<std::size_t>(*data_++);
+        const auto run = count > 128;
+        const auto size = run ? count - 128 : count;
+        if (!size || size > cx_ - x || (end_ - data_) < (run ? 1 : static_cast<std::ptrdiff_t>(size))) {
+          throw truncated();
+        }
+        for (std::size_t i = 0; i < size; i++) {
+          rgbe_[(x + i) * 4 + component] = run ? data_[0] : data_[i];
+        }
+        data_ += run ? 1 : size;
+        x += size;
+      }
+    }
+  } else {
+    if (available < rgbe_.size()) {
+      throw truncated();
+    }
+    std::memcpy(rgbe_.data(), data_, rgbe_.size());
+    data_ += rgbe_.size();
+  }
+
+  for (std::size_t x = 0; x < cx_; x++) {
+    const auto pixel = &rgbe_[x * 4];
+    const auto scale = pixel[3] ? std::ldexp(1.0f, static_cast<int>(pixel[3]) - (128 + 8)) : 0.0f;
+    rgb[x * 3 + 0] = pixel[0] * scale;
+    rgb[x * 3 + 1] = pixel[1] * scale;
+    rgb[x * 3 + 2] = pixel[2] * scale;
+  }
+  row_++;
+}
+
+}  // namespace ice
@@ -0,0 +1,40 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace ice {
+
+// Decodes Radiance RGBE images (.hdr) one row at a time, so that rows can be converted to a packed
+// format without keeping the whole image as floats. Flat and run length encoded rows are supported.
+// Does not own the data.
+class hdr_reader {
+public:
+  // Reads the header. Throws ice::runtime_error if the data is not an RGBE image with the
+  // standard "-Y height +X width" orientation.
+  hdr_reader(const std::uint8_t* data, std::size_t size);
+
+  std::size_t cx() const noexcept
+  {
+    return cx_;
+  }
+
+  std::size_t cy() const noexcept
+  {
+    return cy_;
+  }
+
+  // Decodes the next row from top to bottom into cx RGB floats.
+  // Throws ice::runtime_error if the row is truncated or invalid.
+  void read(float* rgb);
+
+private:
+  const std::uint8_t* data_ = nullptr;
+  const std::uint8_t* end_ = nullptr;
+  std::size_t cx_ = 0;
+  std::size_t cy_ = 0;
+  std::size_t row_ = 0;
+  std::vector<std::uint8_t> rgbe_;
+};
+
+}  // namespace ice
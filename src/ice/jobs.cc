@@ -0,0 +1,367 @@
+#include <ice/jobs.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+namespace ice {
+namespace {
+
+// Identifies the scheduler and queue of the current worker thread.
+thread_local const void* current_scheduler = nullptr;
+thread_local std::size_t current_queue = 0;
+
+constexpr auto no_queue = static_cast<std::size_t>(-1);
+
+}  // namespace
+
+struct jobs::task {
+  jobs::job function;
+  jobs::handle counter;
+  std::atomic<std::size_t> pending{ 1 };
+  bool main = false;
+};
+
+class jobs::impl {
+public:
+  using task_ptr = std::shared_ptr<task>;
+
+  explicit impl(std::size_t threads) : queues_(threads + 1), main_thread_(std::this_thread::get_id())
+  {
+    workers_.reserve(threads);
+    try {
+      for (std::size_t i = 0; i < threads; i++) {
+        workers_.emplace_back([this, i]() { work(i); });
+      }
+    }
+    catch (...) {
+      stop();
+      throw;
+    }
+  }
+
+  impl(impl&& other) = delete;
+  impl(const impl& other) = delete;
+
+  impl& operator=(impl&& other) = delete;
+  impl& operator=(const impl& other) = delete;
+
+  ~impl()
+  {
+    stop();
+  }
+
+  std::size_t threads() const noexcept
+  {
+    return workers_.size();
+  }
+
+  handle schedule(job job, const std::vector<handle>& dependencies, bool main)
+  {
+    auto task = std::make_shared<jobs::task>();
+    task->function = std::move(job);
+    task->counter = std::make_shared<counter>();
+    task->main = main;
+    task->pending = dependencies.size() + 1;
+    for (const auto& dependency : dependencies) {
+      if (dependency) {
+        std::lock_guard<std::mutex> lock(dependency->mutex_);
+        if (!dependency->done()) {
+          dependency->continuations_.push_back(task);
+          continue;
+        }
+      }
+      task->pending--;
+    }
+    release(task);
+    return task->counter;
+  }
+
+  // Schedules a task that belongs to an existing counter.
+  void spawn(job job, const handle& counter)
+  {
+    auto task = std::make_shared<jobs::task>();
+    task->function = std::move(job);
+    task->counter = counter;
+    counter->value_.fetch_add(1, std::memory_order_relaxed);
+    push(std::move(task));
+  }
+
+  void update()
+  {
+    std::vector<task_ptr> tasks;
+    {
+      std::lock_guard<std::mutex> lock(main_mutex_);
+      tasks.swap(main_);
+    }
+    for (auto& task : tasks) {
+      execute(task);
+    }
+  }
+
+  void wait(const handle& counter)
+  {
+    const auto index = local();
+    const auto main = index == workers_.size();
+    while (!counter->done()) {
+      if (main) {
+        update();
+      }
+      if (auto task = find(index)) {
+        execute(task);
+        continue;
+      }
+      std::this_thread::yield();
+    }
+    std::lock_guard<std::mutex> lock(counter->mutex_);
+    if (counter->exception_) {
+      std::rethrow_exception(counter->exception_);
+    }
+  }
+
+  // Executes the function for the range and completes the counter.
+  void execute(const handle& counter, const std::function<void()>& function)
+  {
+    try {
+      function();
+    }
+    catch (...) {
+      fail(counter, std::current_exception());
+    }
+    complete(counter);
+  }
+
+  // Returns true if splitting a range can feed idle workers.
+  bool hungry() const noexcept
+  {
+    const auto index = local();
+    if (index == no_queue) {
+      return queued_.load(std::memory_order_relaxed) == 0;
+    }
+    std::lock_guard<std::mutex> lock(queues_[index].mutex);
+    return queues_[index].tasks.empty();
+  }
+
+private:
+  struct queue {
+    mutable std::mutex mutex;
+    std::deque<task_ptr> tasks;
+  };
+
+  // Returns the queue of the current thread. The last queue belongs to the main thread, which is stored per
+  // scheduler so that several schedulers can share a main thread.
+  std::size_t local() const noexcept
+  {
+    if (current_scheduler == this) {
+      return current_queue;
+    }
+    return std::this_thread::get_id() == main_thread_ ? workers_.size() : no_queue;
+  }
+
+  void work(std::size_t index)
+  {
+    current_scheduler = this;
+    current_queue = index;
+    while (true) {
+      if (auto task = find(index)) {
+        execute(task);
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(mutex_);
+      sleepers_++;
+      cv_.wait(lock, [this]() { return stop_ || queued_ > 0; });
+      sleepers_--;
+      if (stop_ && queued_ == 0) {
+        break;
+      }
+    }
+  }
+
+  void stop()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto& worker : workers_) {
+      if (worker.joinable()) {
+        worker.join();
+      }
+    }
+
+    // Finish the jobs that are left without worker threads.
+    const auto index = local();
+    while (auto task = find(index)) {
+      execute(task);
+    }
+  }
+
+  // Queues the task when its last dependency finished.
+  void release(const task_ptr& task)
+  {
+    if (task->pending.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+      return;
+    }
+    if (task->main) {
+      std::lock_guard<std::mutex> lock(main_mutex_);
+      main_.push_back(task);
+      return;
+    }
+    push(task);
+  }
+
+  void push(task_ptr task)
+  {
+    auto index = local();
+    if (index == no_queue) {
+      index = next_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+    }
+    {
+      std::lock_guard<std::mutex> lock(queues_[index].mutex);
+      queues_[index].tasks.push_back(std::move(task));
+    }
+    queued_.fetch_add(1);
+    if (sleepers_.load() > 0) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      cv_.notify_one();
+    }
+  }
+
+  // Takes the newest task of the own queue or steals the oldest task of another queue.
+  task_ptr find(std::size_t index)
+  {
+    if (index != no_queue) {
+      auto& queue = queues_[index];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (!queue.tasks.empty()) {
+        auto task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        queued_.fetch_sub(1);
+        return task;
+      }
+    }
+    const auto size = queues_.size();
+    const auto start = index == no_queue ? 0 : index + 1;
+    for (std::size_t i = 0; i < size; i++) {
+      auto& queue = queues_[(start + i) % size];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (!queue.tasks.empty()) {
+        auto task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        queued_.fetch_sub(1);
+        return task;
+      }
+    }
+    return{};
+  }
+
+  void execute(const task_ptr& task)
+  {
+    execute(task->counter, task->function);
+  }
+
+  void fail(const handle& counter, std::exception_ptr exception)
+  {
+    std::lock_guard<std::mutex> lock(counter->mutex_);
+    if (!counter->exception_) {
+      counter->exception_ = exception;
+    }
+  }
+
+  // Finishes one job of the counter and releases the dependent jobs when the counter reaches zero.
+  void complete(const handle& counter)
+  {
+    if (counter->value_.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+      return;
+    }
+    std::vector<task_ptr> continuations;
+    {
+      std::lock_guard<std::mutex> lock(counter->mutex_);
+      continuations.swap(counter->continuations_);
+    }
+    for (const auto& task : continuations) {
+      release(task);
+    }
+  }
+
+  std::vector<queue> queues_;
+  std::thread::id main_thread_;
+  std::vector<std::thread> workers_;
+  std::atomic<std::size_t> queued_{ 0 };
+  std::atomic<std::size_t> sleepers_{ 0 };
+  std::atomic<std::size_t> next_{ 0 };
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+  std::mutex main_mutex_;
+  std::vector<task_ptr> main_;
+};
+
+jobs::jobs() : jobs(std::max(std::thread::hardware_concurrency(), 2u) - 1)
+{}
+
+jobs::jobs(std::size_t threads) : impl_(std::make_unique<impl>(threads))
+{}
+
+jobs::~jobs()
+{}
+
+std::size_t jobs::threads() const noexcept
+{
+  return impl_->threads();
+}
+
+jobs::handle jobs::run(job job, const std::vector<handle>& dependencies)
+{
+  return impl_->schedule(std::move(job), dependencies, false);
+}
+
+jobs::handle jobs::run_main(job job, const std::vector<handle>& dependencies)
+{
+  return impl_->schedule(std::move(job), dependencies, true);
+}
+
+void jobs::update()
+{
+  impl_->update();
+}
+
+void jobs::wait(const handle& counter)
+{
+  if (counter) {
+    impl_->wait(counter);
+  }
+}
+
+void jobs::parallel_for(std::size_t begin, std::size_t end, const std::function<void(std::size_t, std::size_t)>& function,
+  std::size_t grain)
+{
+  if (end <= begin) {
+    return;
+  }
+  if (!grain) {
+    grain = std::max((end - begin) / ((impl_->threads() + 1) * 8), std::size_t(1));
+  }
+
+  // Process the range in grain sized chunks and split off the upper half when the own queue ran dry.
+  auto group = std::make_shared<counter>();
+  std::function<void(std::size_t, std::size_t)> split;
+  split = [this, &split, &function, &group, grain](std::size_t begin, std::size_t end) {
+    while (end - begin > grain) {
+      if (impl_->hungry()) {
+        const auto middle = begin + (end - begin) / 2;
+        impl_->spawn([&split, middle, end]() { split(middle, end); }, group);
+        end = middle;
+      } else {
+        function(begin, begin + grain);
+        begin += grain;
+      }
+    }
+    function(begin, end);
+  };
+  impl_->execute(group, [&split, begin, end]() { split(begin, end); });
+  impl_->wait(group);
+}
+
+}  // namespace ice
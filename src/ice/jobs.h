@@ -0,0 +1,88 @@
+#pragma once
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <cstddef>
+
+namespace ice {
+
+// Work-stealing job scheduler.
+// Every worker thread owns a deque of jobs. Workers execute their own jobs in LIFO order and steal
+// the oldest jobs of other workers when their deque is empty. The thread that created the scheduler
+// is the main thread; it executes jobs while it waits and runs main thread jobs (e.g. OpenGL calls)
+// in update() and wait(). Jobs must not block on anything but the scheduler.
+class jobs {
+public:
+  using job = std::function<void()>;
+
+private:
+  class impl;
+  struct task;
+
+public:
+  // Tracks the completion of a job and the jobs that depend on it.
+  class counter {
+  public:
+    // Returns true if the job finished.
+    bool done() const noexcept
+    {
+      return value_.load(std::memory_order_acquire) == 0;
+    }
+
+  private:
+    friend class jobs::impl;
+    std::atomic<std::size_t> value_{ 1 };
+    std::mutex mutex_;
+    std::vector<std::shared_ptr<task>> continuations_;
+    std::exception_ptr exception_;
+  };
+
+  using handle = std::shared_ptr<counter>;
+
+  // Creates a scheduler with one worker thread per logical core besides the main thread.
+  jobs();
+
+  // Creates a scheduler with the given number of worker threads.
+  // Without worker threads, jobs only run while the main thread waits.
+  explicit jobs(std::size_t threads);
+
+  jobs(jobs&& other) = delete;
+  jobs(const jobs& other) = delete;
+
+  jobs& operator=(jobs&& other) = delete;
+  jobs& operator=(const jobs& other) = delete;
+
+  // Finishes all queued jobs and stops the worker threads.
+  // Main thread jobs that did not run yet are discarded.
+  ~jobs();
+
+  // Returns the number of worker threads.
+  std::size_t threads() const noexcept;
+
+  // Schedules a job on any thread after all dependencies finished.
+  handle run(job job, const std::vector<handle>& dependencies = {});
+
+  // Schedules a job on the main thread after all dependencies finished.
+  handle run_main(job job, const std::vector<handle>& dependencies = {});
+
+  // Executes the queued main thread jobs. Must be called regularly on the main thread, e.g. once per frame.
+  void update();
+
+  // Executes other jobs until the job finished.
+  // Rethrows the exception of the job, if any.
+  void wait(const handle& counter);
+
+  // Calls the function for subranges of [begin, end) in parallel and waits until all calls returned.
+  // Ranges are split in half while other workers are idle (lazy binary splitting), but never below the grain
+  // size. A grain size of zero selects a grain size that yields about eight chunks per thread.
+  void parallel_for(std::size_t begin, std::size_t end, const std::function<void(std::size_t, std::size_t)>& function,
+    std::size_t grain = 0);
+
+private:
+  std::unique_ptr<impl> impl_;
+};
+
+}  // namespace ice
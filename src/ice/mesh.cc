@@ -0,0 +1,601 @@
+#include <ice/mesh.h>
+#include <ice/exception.h>
+#include <ice/pixels.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+#include <cstring>
+
+namespace ice {
+namespace {
+
+// Size of the simulated post-transform vertex cache used to order the triangles.
+constexpr std::size_t cache_size = 32;
+
+// Size of the FIFO cache used to find the triangle cluster boundaries for the overdraw optimization.
+constexpr std::size_t cluster_cache_size = 16;
+
+constexpr std::uint32_t none = std::numeric_limits<std::uint32_t>::max();
+
+// Packs a unit vector into a signed normalized 10:10:10:2 value.
+std::uint32_t to_snorm10(const float* normal) noexcept
+{
+  const auto length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+  const auto scale = length > 0.0f ? 1.0f / length : 0.0f;
+  std::uint32_t value = 0;
+  for (auto i = 0; i < 3; i++) {
+    const auto component = std::min(std::max(normal[i] * scale, -1.0f), 1.0f);
+    const auto quantized = static_cast<std::int32_t>(std::lround(component * 511.0f));
+    value |= (static_cast<std::uint32_t>(quantized) & 0x3FF) << (i * 10);
+  }
+  return value;
+}
+
+std::uint8_t to_unorm8(float value) noexcept
+{
+  return static_cast<std::uint8_t>(std::lround(std::min(std::max(value, 0.0f), 1.0f) * 255.0f));
+}
+
+// Scores a vertex by its position in the cache and the number of triangles that still use it.
+// See "Linear-Speed Vertex Cache Optimisation" (Tom Forsyth, 2006).
+float vertex_score(int position, std::uint32_t remaining) noexcept
+{
+  if (remaining == 0) {
+    return -1.0f;
+  }
+  auto score = 0.0f;
+  if (position >= 0) {
+    if (position < 3) {
+      score = 0.75f;
+    } else {
+      score = std::pow(1.0f - static_cast<float>(position - 3) / (cache_size - 3), 1.5f);
+    }
+  }
+  return score + 2.0f / std::sqrt(static_cast<float>(remaining));
+}
+
+// Orders the triangles so that consecutive triangles reuse the vertices in the post-transform cache.
+std::vector<std::uint32_t> optimize_cache(const std::vector<std::uint32_t>& indices, std::size_t vertices)
+{
+  const auto triangles = indices.size() / 3;
+
+  // Build the list of triangles that use each vertex. Emitted triangles are moved to the end of the list.
+  std::vector<std::uint32_t> offsets(vertices + 1);
+  for (const auto index : indices) {
+    offsets[index + 1]++;
+  }
+  std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+  std::vector<std::uint32_t> adjacency(indices.size());
+  std::vector<std::uint32_t> remaining(vertices);
+  for (std::size_t t = 0; t < triangles; t++) {
+    for (std::size_t k = 0; k < 3; k++) {
+      const auto v = indices[t * 3 + k];
+      adjacency[offsets[v] + remaining[v]++] = static_cast<std::uint32_t>(t);
+    }
+  }
+
+  // Score the vertices and triangles.
+  std::vector<int> position(vertices, -1);
+  std::vector<float> score(vertices);
+  for (std::size_t v = 0; v < vertices; v++) {
+    score[v] = vertex_score(-1, remaining[v]);
+  }
+  std::vector<float> triangle_score(triangles);
+  for (std::size_t t = 0; t < triangles; t++) {
+    triangle_score[t] = score[indices[t * 3 + 0]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+  }
+
+  std::vector<std::uint8_t> emitted(triangles);
+  std::vector<std::uint32_t> cache;
+  std::vector<std::uint32_t> next;
+  std::vector<std::uint32_t> result;
+  result.reserve(indices.size());
+  std::size_t cursor = 0;
+  auto best = none;
+  while (result.size() < indices.size()) {
+    // Continue with the next triangle in the input order when no cached vertex has triangles left.
+    if (best == none) {
+      while (emitted[cursor]) {
+        cursor++;
+      }
+      best = static_cast<std::uint32_t>(cursor);
+    }
+
+    // Emit the triangle and remove it from the lists of its vertices.
+    emitted[best] = 1;
+    for (std::size_t k = 0; k < 3; k++) {
+      const auto v = indices[best * 3 + k];
+      result.push_back(v);
+      const auto begin = adjacency.begin() + offsets[v];
+      const auto end = begin + remaining[v];
+      *std::find(begin, end, best) = *(end - 1);
+      remaining[v]--;
+    }
+
+    // Move the vertices of the triangle to the front of the cache.
+    next.clear();
+    next.insert(next.end(), indices.begin() + best * 3, indices.begin() + best * 3 + 3);
+    for (const auto v : cache) {
+      if (v != next[0] && v != next[1] && v != next[2]) {
+        next.push_back(v);
+      }
+    }
+
+    // Update the scores of the vertices that moved or left the cache.
+    for (std::size_t i = 0; i < next.size(); i++) {
+      const auto v = next[i];
+      position[v] = i < cache_size ? static_cast<int>(i) : -1;
+      const auto value = vertex_score(position[v], remaining[v]);
+      const auto difference = value - score[v];
+      score[v] = value;
+      for (auto j = offsets[v], end = offsets[v] + remaining[v]; j < end; j++) {
+        triangle_score[adjacency[j]] += difference;
+      }
+    }
+    if (next.size() > cache_size) {
+      next.resize(cache_size);
+    }
+    cache.swap(next);
+
+    // Choose the best triangle that uses a cached vertex.
+    best = none;
+    auto best_score = -std::numeric_limits<float>::max();
+    for (const auto v : cache) {
+      for (auto j = offsets[v], end = offsets[v] + remaining[v]; j < end; j++) {
+        const auto t = adjacency[j];
+        if (triangle_score[t] > best_score) {
+          best = t;
+          best_score = triangle_score[t];
+        }
+      }
+    }
+  }
+  return result;
+}
+
+// Splits the cache optimized triangles into clusters at the points where the cache is flushed
+// and sorts the clusters so that clusters facing away from the mesh center are drawn first.
+// See "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw" (Sander et al., 2007).
+void optimize_overdraw(std::vector<std::uint32_t>& indices, const std::vector<float>& positions)
+{
+  struct cluster {
+    std::size_t first;
+    std::size_t count;
+    float sort;
+  };
+
+  // Find the cluster boundaries with a simulated FIFO cache.
+  std::vector<cluster> clusters;
+  std::vector<std::uint32_t> fifo(cluster_cache_size, none);
+  std::size_t head = 0;
+  for (std::size_t i = 0; i < indices.size(); i += 3) {
+    auto misses = 0;
+    for (std::size_t k = 0; k < 3; k++) {
+      const auto v = indices[i + k];
+      if (std::find(fifo.begin(), fifo.end(), v) == fifo.end()) {
+        fifo[head] = v;
+        head = (head + 1) % fifo.size();
+        misses++;
+      }
+    }
+    if (clusters.empty() || misses == 3) {
+      clusters.push_back({ i, 0, 0.0f });
+    }
+    clusters.back().count += 3;
+  }
+  if (clusters.size() < 2) {
+    return;
+  }
+
+  // Compute the area weighted centroid and normal of every cluster and the centroid of the mesh.
+  std::vector<std::array<float, 6>> properties(clusters.size());
+  std::array<float, 3> center = {};
+  auto area = 0.0f;
+  for (std::size_t c = 0; c < clusters.size(); c++) {
+    auto& property = properties[c];
+    property.fill(0.0f);
+    auto cluster_area = 0.0f;
+    for (auto i = clusters[c].first, end = clusters[c].first + clusters[c].count; i < end; i += 3) {
+      const auto p0 = &positions[indices[i + 0] * 3];
+      const auto p1 = &positions[indices[i + 1] * 3];
+      const auto p2 = &positions[indices[i + 2] * 3];
+      const float u[] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+      const float v[] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+      const float n[] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+      const auto weight = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+      for (auto k = 0; k < 3; k++) {
+        const auto centroid = (p0[k] + p1[k] + p2[k]) / 3.0f;
+        property[k] += centroid * weight;
+        property[k + 3] += n[k];
+        center[k] += centroid * weight;
+      }
+      cluster_area += weight;
+    }
+    const auto length = std::sqrt(property[3] * property[3] + property[4] * property[4] + property[5] * property[5]);
+    for (auto k = 0; k < 3; k++) {
+      property[k] = cluster_area > 0.0f ? property[k] / cluster_area : 0.0f;
+      property[k + 3] = length > 0.0f ? property[k + 3] / length : 0.0f;
+    }
+    area += cluster_area;
+  }
+  if (area <= 0.0f) {
+    return;
+  }
+  for (auto& value : center) {
+    value /= area;
+  }
+
+  // Draw the clusters whose planes are farthest from the mesh center first; they are likely to occlude the others.
+  for (std::size_t c = 0; c < clusters.size(); c++) {
+    const auto& property = properties[c];
+    for (auto k = 0; k < 3; k++) {
+      clusters[c].sort += (property[k] - center[k]) * property[k + 3];
+    }
+  }
+  std::stable_sort(clusters.begin(), clusters.end(), [](const cluster& a, const cluster& b) {
+    return a.sort > b.sort;
+  });
+  std::vector<std::uint32_t> sorted;
+  sorted.reserve(indices.size());
+  for (const auto& cluster : clusters) {
+    sorted.insert(sorted.end(), indices.begin() + cluster.first, indices.begin() + cluster.first + cluster.count);
+  }
+  indices.swap(sorted);
+}
+
+// Simplifies the triangles by merging the vertices in every cell of a uniform grid into the vertex that is
+// closest to the average position of the cell. Degenerate and duplicate triangles are removed.
+// Returns the simplified triangles and the maximum vertex displacement.
+std::vector<std::uint32_t> simplify(const std::vector<std::uint32_t>& indices, const std::vector<float>& positions,
+  const float* origin, float cell, float& error)
+{
+  // Assign the vertices to cells and accumulate the cell positions.
+  const auto vertices = positions.size() / 3;
+  std::unordered_map<std::uint64_t, std::uint32_t> cells;
+  std::vector<std::uint32_t> cell_of(vertices, none);
+  std::vector<std::array<float, 4>> sums;
+  for (const auto v : indices) {
+    if (cell_of[v] != none) {
+      continue;
+    }
+    std::uint64_t key = 0;
+    for (auto k = 0; k < 3; k++) {
+      const auto coordinate = static_cast<std::uint64_t>((positions[v * 3 + k] - origin[k]) / cell);
+      key |= std::min(coordinate, std::uint64_t(0x1FFFFF)) << (k * 21);
+    }
+    const auto result = cells.emplace(key, static_cast<std::uint32_t>(sums.size()));
+    if (result.second) {
+      sums.push_back({ 0.0f, 0.0f, 0.0f, 0.0f });
+    }
+    cell_of[v] = result.first->second;
+    auto& sum = sums[cell_of[v]];
+    sum[0] += positions[v * 3 + 0];
+    sum[1] += positions[v * 3 + 1];
+    sum[2] += positions[v * 3 + 2];
+    sum[3] += 1.0f;
+  }
+
+  // Choose the vertex that is closest to the average position of every cell.
+  const auto distance = [&](std::uint32_t v, const float* p) {
+    const auto x = positions[v * 3 + 0] - p[0];
+    const auto y = positions[v * 3 + 1] - p[1];
+    const auto z = positions[v * 3 + 2] - p[2];
+    return x * x + y * y + z * z;
+  };
+  std::vector<std::uint32_t> representative(sums.size(), none);
+  std::vector<float> best(sums.size(), std::numeric_limits<float>::max());
+  for (std::size_t v = 0; v < vertices; v++) {
+    const auto c = cell_of[v];
+    if (c == none) {
+      continue;
+    }
+    const float average[] = { sums[c][0] / sums[c][3], sums[c][1] / sums[c][3], sums[c][2] / sums[c][3] };
+    const auto d = distance(static_cast<std::uint32_t>(v), average);
+    if (d < best[c]) {
+      best[c] = d;
+      representative[c] = static_cast<std::uint32_t>(v);
+    }
+  }
+  error = 0.0f;
+  for (std::size_t v = 0; v < vertices; v++) {
+    if (cell_of[v] != none) {
+      error = std::max(error, distance(static_cast<std::uint32_t>(v), &positions[representative[cell_of[v]] * 3]));
+    }
+  }
+  error = std::sqrt(error);
+
+  // Collapse the triangles. Triangles are rotated so that the smallest index is first to find duplicates.
+  std::vector<std::array<std::uint32_t, 3>> triangles;
+  for (std::size_t i = 0; i < indices.size(); i += 3) {
+    const auto a = representative[cell_of[indices[i + 0]]];
+    const auto b = representative[cell_of[indices[i + 1]]];
+    const auto c = representative[cell_of[indices[i + 2]]];
+    if (a == b || b == c || c == a) {
+      continue;
+    }
+    if (a < b && a < c) {
+      triangles.push_back({ a, b, c });
+    } else if (b < c) {
+      triangles.push_back({ b, c, a });
+    } else {
+      triangles.push_back({ c, a, b });
+    }
+  }
+  std::sort(triangles.begin(), triangles.end());
+  triangles.erase(std::unique(triangles.begin(), triangles.end()), triangles.end());
+  std::vector<std::uint32_t> result;
+  result.reserve(triangles.size() * 3);
+  for (const auto& triangle : triangles) {
+    result.insert(result.end(), triangle.begin(), triangle.end());
+  }
+  return result;
+}
+
+template <typename T>
+void write(std::vector<std::uint8_t>& data, const T& value)
+{
+  const auto src = reinterpret_cast<const std::uint8_t*>(&value);
+  data.insert(data.end(), src, src + sizeof(value));
+}
+
+}  // namespace
+
+std::uint32_t mesh_attribute_size(mesh_attribute attribute) noexcept
+{
+  switch (attribute) {
+  case mesh_position: return 8;
+  case mesh_normal: return 4;
+  case mesh_uv: return 4;
+  case mesh_color: return 4;
+  }
+  return 0;
+}
+
+std::uint32_t mesh_attribute_offset(std::uint32_t attributes, mesh_attribute attribute) noexcept
+{
+  std::uint32_t offset = 0;
+  for (const auto value : { mesh_position, mesh_normal, mesh_uv, mesh_color }) {
+    if (value == attribute) {
+      break;
+    }
+    if (attributes & value) {
+      offset += mesh_attribute_size(value);
+    }
+  }
+  return offset;
+}
+
+std::uint32_t mesh_stride(std::uint32_t attributes) noexcept
+{
+  return mesh_attribute_offset(attributes, mesh_color) + (attributes & mesh_color ? mesh_attribute_size(mesh_color) : 0);
+}
+
+mesh_view::mesh_view(const std::uint8_t* data, std::size_t size)
+{
+  // Check the header.
+  if (!data || size < sizeof(mesh_header)) {
+    throw ice::runtime_error("Invalid mesh file.") << "Size: " << size;
+  }
+  header_ = reinterpret_cast<const mesh_header*>(data);
+  if (std::memcmp(header_->magic, "MESH", 4) != 0) {
+    throw ice::runtime_error("Invalid mesh file signature.");
+  }
+  if (header_->version != mesh_version) {
+    throw ice::runtime_error("Unsupported mesh file version.") << header_->version;
+  }
+  constexpr std::uint32_t known = mesh_position | mesh_normal | mesh_uv | mesh_color;
+  const auto attributes = header_->attributes;
+  if (!(attributes & mesh_position) || (attributes & ~known) ||
+    header_->stride != mesh_stride(attributes)) {
+    throw ice::runtime_error("Invalid mesh file vertex format.") << "Attributes: " << attributes << "\nStride: " << header_->stride;
+  }
+  if (header_->index_size != 2 && header_->index_size != 4) {
+    throw ice::runtime_error("Invalid mesh file index size.") << header_->index_size;
+  }
+
+  // Check the section sizes.
+  const auto lods = static_cast<std::uint64_t>(sizeof(mesh_header));
+  const auto vertices = lods + static_cast<std::uint64_t>(header_->lods) * sizeof(mesh_lod);
+  const auto indices = vertices + static_cast<std::uint64_t>(header_->vertices) * header_->stride;
+  const auto end = indices + static_cast<std::uint64_t>(header_->indices) * header_->index_size;
+  if (end > size) {
+    throw ice::runtime_error("Truncated mesh file.") << "Size: " << size << "\nExpected: " << end;
+  }
+  lods_ = reinterpret_cast<const mesh_lod*>(data + lods);
+  vertices_ = data + vertices;
+  indices_ = data + indices;
+
+  // Check the levels of detail.
+  if (header_->lods == 0) {
+    throw ice::runtime_error("Invalid mesh file without levels of detail.");
+  }
+  for (std::uint32_t i = 0; i < header_->lods; i++) {
+    const auto& lod = lods_[i];
+    if (lod.count % 3 || static_cast<std::uint64_t>(lod.first) + lod.count > header_->indices) {
+      throw ice::runtime_error("Invalid mesh file level of detail.") << i;
+    }
+  }
+}
+
+std::vector<std::uint8_t> build_mesh(const mesh_source& source, std::size_t lods)
+{
+  // Check the source.
+  const auto vertices = source.positions.size() / 3;
+  if (source.positions.size() % 3 || vertices == 0 ||
+    (!source.normals.empty() && source.normals.size() != vertices * 3) ||
+    (!source.uvs.empty() && source.uvs.size() != vertices * 2) ||
+    (!source.colors.empty() && source.colors.size() != vertices * 4)) {
+    throw ice::runtime_error("Invalid mesh vertex attributes.") << "Vertices: " << vertices;
+  }
+  if (source.indices.empty() || source.indices.size() % 3) {
+    throw ice::runtime_error("Invalid mesh triangle list.") << "Indices: " << source.indices.size();
+  }
+  for (const auto index : source.indices) {
+    if (index >= vertices) {
+      throw ice::runtime_error("Invalid mesh vertex index.") << index;
+    }
+  }
+
+  // Compute the bounding box.
+  float min[3] = {};
+  float max[3] = {};
+  for (auto k = 0; k < 3; k++) {
+    min[k] = max[k] = source.positions[source.indices.front() * 3 + k];
+  }
+  for (const auto index : source.indices) {
+    for (auto k = 0; k < 3; k++) {
+      min[k] = std::min(min[k], source.positions[index * 3 + k]);
+      max[k] = std::max(max[k], source.positions[index * 3 + k]);
+    }
+  }
+  const auto extent = std::max({ max[0] - min[0], max[1] - min[1], max[2] - min[2] });
+
+  // Generate the levels of detail. The grid resolution is halved until a level has at most half the triangles.
+  std::vector<std::vector<std::uint32_t>> levels{ source.indices };
+  std::vector<float> errors{ 0.0f };
+  auto resolution = 256.0f;
+  while (levels.size() < lods && extent > 0.0f) {
+    std::vector<std::uint32_t> simplified;
+    auto error = 0.0f;
+    for (; resolution >= 1.0f; resolution *= 0.5f) {
+      simplified = simplify(source.indices, source.positions, min, extent / resolution, error);
+      if (simplified.size() * 2 <= levels.back().size()) {
+        break;
+      }
+    }
+    if (resolution < 1.0f || simplified.empty()) {
+      break;
+    }
+    levels.push_back(std::move(simplified));
+    errors.push_back(error);
+    resolution *= 0.5f;
+  }
+
+  // Optimize the triangle order of every level.
+  for (auto& level : levels) {
+    level = optimize_cache(level, vertices);
+    optimize_overdraw(level, source.positions);
+  }
+
+  // Order the vertices by first use and drop unused vertices.
+  std::vector<std::uint32_t> remap(vertices, none);
+  std::vector<std::uint32_t> order;
+  for (auto& level : levels) {
+    for (auto& index : level) {
+      if (remap[index] == none) {
+        remap[index] = static_cast<std::uint32_t>(order.size());
+        order.push_back(index);
+      }
+      index = remap[index];
+    }
+  }
+
+  // Compute the bounding sphere. The radius covers the half float rounding error.
+  float center[3] = {};
+  for (auto k = 0; k < 3; k++) {
+    center[k] = (min[k] + max[k]) * 0.5f;
+  }
+  auto radius = 0.0f;
+  auto magnitude = 0.0f;
+  for (const auto v : order) {
+    const auto p = &source.positions[v * 3];
+    const float d[] = { p[0] - center[0], p[1] - center[1], p[2] - center[2] };
+    radius = std::max(radius, d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+    magnitude = std::max({ magnitude, std::abs(p[0]), std::abs(p[1]), std::abs(p[2]) });
+  }
+  radius = std::sqrt(radius) + magnitude / 1024.0f;
+
+  // Write the header.
+  std::uint32_t attributes = mesh_position;
+  if (!source.normals.empty()) {
+    attributes |= mesh_normal;
+  }
+  if (!source.uvs.empty()) {
+    attributes |= mesh_uv;
+  }
+  if (!source.colors.empty()) {
+    attributes |= mesh_color;
+  }
+  std::size_t indices = 0;
+  for (const auto& level : levels) {
+    indices += level.size();
+  }
+  mesh_header header = {};
+  std::memcpy(header.magic, "MESH", 4);
+  header.version = mesh_version;
+  header.attributes = attributes;
+  header.stride = mesh_stride(attributes);
+  header.vertices = static_cast<std::uint32_t>(order.size());
+  header.index_size = order.size() <= 0x10000 ? 2 : 4;
+  header.indices = static_cast<std::uint32_t>(indices);
+  header.lods = static_cast<std::uint32_t>(levels.size());
+  std::copy(center, center + 3, header.center);
+  header.radius = radius;
+  std::vector<std::uint8_t> data;
+  data.reserve(sizeof(header) + levels.size() * sizeof(mesh_lod) + order.size() * header.stride + indices * 4);
+  write(data, header);
+
+  // Write the levels of detail.
+  std::uint32_t first = 0;
+  for (std::size_t i = 0; i < levels.size(); i++) {
+    const auto count = static_cast<std::uint32_t>(levels[i].size());
+    write(data, mesh_lod{ first, count, errors[i] });
+    first += count;
+  }
+
+  // Write the quantized vertices.
+  for (const auto v : order) {
+    for (auto k = 0; k < 3; k++) {
+      write(data, to_half(source.positions[v * 3 + k]));
+    }
+    write(data, to_half(1.0f));
+    if (attributes & mesh_normal) {
+      write(data, to_snorm10(&source.normals[v * 3]));
+    }
+    if (attributes & mesh_uv) {
+      write(data, to_half(source.uvs[v * 2 + 0]));
+      write(data, to_half(source.uvs[v * 2 + 1]));
+    }
+    if (attributes & mesh_color) {
+      for (auto k = 0; k < 4; k++) {
+        write(data, to_unorm8(source.colors[v * 4 + k]));
+      }
+    }
+  }
+
+  // Write the indices and pad the file to a multiple of 4 bytes.
+  for (const auto& level : levels) {
+    for (const auto index : level) {
+      if (header.index_size == 2) {
+        write(data, static_cast<std::uint16_t>(index));
+      } else {
+        write(data, index);
+      }
+    }
+  }
+  data.resize((data.size() + 3) & ~std::size_t(3));
+  return data;
+}
+
+float mesh_acmr(const std::uint32_t* indices, std::size_t count, std::size_t vertices, std::size_t cache)
+{
+  if (count < 3) {
+    return 0.0f;
+  }
+  std::vector<std::size_t> time(vertices, 0);
+  std::size_t misses = 0;
+  for (std::size_t i = 0; i < count; i++) {
+    // A vertex is cached when it was added less than cache misses ago.
+    auto& added = time[indices[i]];
+    if (added == 0 || misses - added + 1 > cache) {
+      misses++;
+      added = misses;
+    }
+  }
+  return static_cast<float>(misses) / (count / 3);
+}
+
+}  // namespace ice
@@ -0,0 +1,102 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace ice {
+
+// Vertex attributes of a mesh file in the order in which they are interleaved.
+// The position is always present.
+enum mesh_attribute : std::uint32_t {
+  mesh_position = 0x01,  // 4 x half float, the fourth component is 1
+  mesh_normal = 0x02,    // signed normalized 10:10:10:2 (GL_INT_2_10_10_10_REV), w is 0
+  mesh_uv = 0x04,        // 2 x half float
+  mesh_color = 0x08,     // 4 x unsigned normalized byte
+};
+
+// Mesh file header. A mesh file contains the header, the levels of detail, the interleaved vertices
+// and the indices of all levels of detail. All sections are 4 byte aligned and little endian.
+struct mesh_header {
+  char magic[4];            // "MESH"
+  std::uint32_t version;    // mesh_version
+  std::uint32_t attributes; // mesh_attribute flags
+  std::uint32_t stride;     // vertex size in bytes
+  std::uint32_t vertices;   // number of vertices
+  std::uint32_t index_size; // 2 or 4 bytes
+  std::uint32_t indices;    // number of indices
+  std::uint32_t lods;       // number of levels of detail
+  float center[3];          // bounding sphere
+  float radius;
+};
+
+// Level of detail. All levels share the vertices.
+struct mesh_lod {
+  std::uint32_t first;  // first index
+  std::uint32_t count;  // number of indices
+  float error;          // maximum vertex displacement in model units
+};
+
+constexpr std::uint32_t mesh_version = 1;
+
+// Returns the size of an attribute in bytes.
+std::uint32_t mesh_attribute_size(mesh_attribute attribute) noexcept;
+
+// Returns the offset of an attribute in a vertex with the given attributes.
+std::uint32_t mesh_attribute_offset(std::uint32_t attributes, mesh_attribute attribute) noexcept;
+
+// Returns the size of a vertex with the given attributes.
+std::uint32_t mesh_stride(std::uint32_t attributes) noexcept;
+
+// Validated mesh file. Does not own the data.
+class mesh_view {
+public:
+  // Throws ice::runtime_error if the data is not a valid mesh file.
+  mesh_view(const std::uint8_t* data, std::size_t size);
+
+  const mesh_header& header() const noexcept
+  {
+    return *header_;
+  }
+
+  const mesh_lod* lods() const noexcept
+  {
+    return lods_;
+  }
+
+  const std::uint8_t* vertices() const noexcept
+  {
+    return vertices_;
+  }
+
+  const std::uint8_t* indices() const noexcept
+  {
+    return indices_;
+  }
+
+private:
+  const mesh_header* header_ = nullptr;
+  const mesh_lod* lods_ = nullptr;
+  const std::uint8_t* vertices_ = nullptr;
+  const std::uint8_t* indices_ = nullptr;
+};
+
+// Unquantized triangle list.
+struct mesh_source {
+  std::vector<float> positions;  // 3 per vertex
+  std::vector<float> normals;    // 3 per vertex or empty
+  std::vector<float> uvs;        // 2 per vertex or empty
+  std::vector<float> colors;     // 4 per vertex or empty
+  std::vector<std::uint32_t> indices;
+};
+
+// Creates a mesh file.
+// Coarser levels of detail are generated by vertex clustering until a level does not remove enough triangles.
+// The triangles of every level are reordered for the post-transform vertex cache (Forsyth) and then clusters
+// of triangles are sorted to reduce overdraw (Sander et al.). Vertices are stored in the order of first use.
+// Throws ice::runtime_error if the source is not a valid triangle list.
+std::vector<std::uint8_t> build_mesh(const mesh_source& source, std::size_t lods = 4);
+
+// Returns the average number of vertices transformed per triangle for a FIFO cache with the given size.
+float mesh_acmr(const std::uint32_t* indices, std::size_t count, std::size_t vertices, std::size_t cache = 16);
+
+}  // namespace ice
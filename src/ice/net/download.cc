@@ -0,0 +1,593 @@
+#include <ice/net/download.h>
+#include <ice/net/pool.h>
+#include <ice/exception.h>
+#include <openssl/sha.h>
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <istream>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+
+namespace ice {
+namespace net {
+namespace {
+
+struct chunk {
+  std::uint64_t offset = 0;
+  std::uint64_t size = 0;
+};
+
+struct response {
+  unsigned status = 0;
+  bool keep_alive = true;
+  bool accept_ranges = false;
+  std::uint64_t content_length = 0;
+  std::uint64_t range_begin = 0;
+  std::uint64_t range_end = 0;
+  std::uint64_t range_total = 0;
+  bool has_range = false;
+};
+
+bool iequals(const std::string& a, const char* b)
+{
+  std::size_t i = 0;
+  for (; i < a.size() && b[i]; i++) {
+    if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i]))) {
+      return false;
+    }
+  }
+  return i == a.size() && !b[i];
+}
+
+// Parses the status line and headers of a HTTP/1.x response.
+bool parse(std::istream& is, response& r)
+{
+  std::string version;
+  is >> version >> r.status;
+  if (!is || version.compare(0, 5, "HTTP/") != 0) {
+    return false;
+  }
+  r.keep_alive = version != "HTTP/1.0";
+  std::string line;
+  std::getline(is, line);
+  while (std::getline(is, line) && line != "\r") {
+    auto colon = line.find(':');
+    if (colon == std::string::npos) {
+      return false;
+    }
+    auto name = line.substr(0, colon);
+    auto value = line.substr(colon + 1);
+    value.erase(0, value.find_first_not_of(" \t"));
+    value.erase(value.find_last_not_of(" \t\r") + 1);
+    if (iequals(name, "content-length")) {
+      r.content_length = std::strtoull(value.c_str(), nullptr, 10);
+    } else if (iequals(name, "content-range")) {
+      unsigned long long begin = 0;
+      unsigned long long end = 0;
+      unsigned long long total = 0;
+      if (std::sscanf(value.c_str(), "bytes %llu-%llu/%llu", &begin, &end, &total) != 3) {
+        return false;
+      }
+      r.range_begin = begin;
+      r.range_end = end;
+      r.range_total = total;
+      r.has_range = true;
+    } else if (iequals(name, "accept-ranges")) {
+      r.accept_ranges = iequals(value, "bytes");
+    } else if (iequals(name, "connection")) {
+      if (iequals(value, "close")) {
+        r.keep_alive = false;
+      } else if (iequals(value, "keep-alive")) {
+        r.keep_alive = true;
+      }
+    }
+  }
+  return true;
+}
+
+std::string hex(const std::uint8_t* data, std::size_t size)
+{
+  static const char digits[] = "0123456789abcdef";
+  std::string str;
+  str.reserve(size * 2);
+  for (std::size_t i = 0; i < size; i++) {
+    str.push_back(digits[data[i] >> 4]);
+    str.push_back(digits[data[i] & 0x0F]);
+  }
+  return str;
+}
+
+// Download state of a pooled connection.
+struct link {
+  std::shared_ptr<connection> socket;
+  std::deque<chunk> requests;   // sent or queued requests in response order
+  std::deque<std::string> writes;
+  bool reading = false;
+  bool closed = false;
+};
+
+}  // namespace
+
+class download::impl {
+public:
+  impl(options options) :
+    options_(std::move(options)), pool_(io_, make_pool_options(options_))
+  {
+    options_.connections = std::max(options_.connections, std::size_t(1));
+    options_.pipeline = std::max(options_.pipeline, std::size_t(1));
+    options_.chunk = std::max(options_.chunk, std::size_t(1));
+    thread_ = std::thread([this]() {
+      io_.run();
+    });
+  }
+
+  ~impl()
+  {
+    io_.post([this]() {
+      if (job_) {
+        finish(asio::error::operation_aborted);
+      }
+      pool_.clear();
+    });
+    work_.reset();
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+  void start(std::string target, std::filesystem::path file, std::string sha256,
+    progress_handler progress, completion_handler completion)
+  {
+    auto job = std::make_unique<state>();
+    job->target = std::move(target);
+    job->file = std::move(file);
+    job->part = job->file;
+    job->part += ".part";
+    job->sha256 = std::move(sha256);
+    std::transform(job->sha256.begin(), job->sha256.end(), job->sha256.begin(), [](char c) {
+      return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    });
+    job->progress = std::move(progress);
+    job->completion = std::move(completion);
+    auto ptr = job.release();
+    io_.post([this, ptr]() {
+      std::unique_ptr<state> job(ptr);
+      if (job_) {
+        if (job->completion) {
+          job->completion(asio::error::in_progress, {});
+        }
+        return;
+      }
+      job_ = std::move(job);
+      begin();
+    });
+  }
+
+  void cancel()
+  {
+    io_.post([this]() {
+      if (job_) {
+        finish(asio::error::operation_aborted);
+      }
+    });
+  }
+
+private:
+  struct state {
+    std::string target;
+    std::filesystem::path file;
+    std::filesystem::path part;
+    std::string sha256;
+    progress_handler progress;
+    completion_handler completion;
+    std::ofstream os;
+    SHA256_CTX sha = {};
+    std::uint64_t total = 0;
+    std::uint64_t frontier = 0;   // bytes hashed and written to the partial file
+    std::uint64_t next = 0;       // first byte that was not requested yet
+    std::deque<chunk> retry;      // chunks that must be requested again
+    std::map<std::uint64_t, std::vector<std::uint8_t>> pending;
+    std::size_t failures = 0;
+    std::error_code error;        // last connection error
+  };
+
+  static pool::options make_pool_options(const options& options)
+  {
+    pool::options result;
+    result.tls = options.tls;
+    result.verify = options.verify;
+    result.certificates = options.certificates;
+    result.connections = std::max(options.connections, std::size_t(1));
+    return result;
+  }
+
+  void begin()
+  {
+    // Hash the existing partial file to resume the download.
+    SHA256_Init(&job_->sha);
+    std::error_code ec;
+    auto size = std::filesystem::file_size(job_->part, ec);
+    if (!ec && size > 0) {
+      std::ifstream is(job_->part, std::ios::binary);
+      std::vector<char> buffer(1024 * 1024);
+      while (is) {
+        is.read(buffer.data(), buffer.size());
+        auto bytes = static_cast<std::size_t>(is.gcount());
+        SHA256_Update(&job_->sha, buffer.data(), bytes);
+        job_->frontier += bytes;
+      }
+      if (is.bad() || job_->frontier != size) {
+        finish(download_errc::file_error);
+        return;
+      }
+    }
+    job_->os.open(job_->part, std::ios::binary | std::ios::app);
+    if (!job_->os) {
+      finish(download_errc::file_error);
+      return;
+    }
+    job_->next = job_->frontier;
+
+    // Request the file size.
+    auto l = std::make_shared<link>();
+    links_.push_back(l);
+    open(l, [this, l]() {
+      head(l);
+    });
+  }
+
+  // Acquires a pooled connection for the link.
+  template <typename Handler>
+  void open(std::shared_ptr<link> l, Handler handler)
+  {
+    pool_.acquire(options_.host, options_.port, [this, l, handler](const std::error_code& ec, std::shared_ptr<connection> c) {
+      if (l->closed) {
+        if (c) {
+          pool_.release(c, true);
+        }
+        return;
+      }
+      if (ec) {
+        fail(l, ec);
+        return;
+      }
+      l->socket = std::move(c);
+      handler();
+    });
+  }
+
+  // Returns the link connection to the pool.
+  void close(std::shared_ptr<link> l, bool reusable)
+  {
+    l->closed = true;
+    if (l->socket) {
+      reusable = reusable && l->requests.empty() && l->writes.empty() && !l->reading;
+      pool_.release(std::move(l->socket), reusable);
+      l->socket.reset();
+    }
+  }
+
+  std::string request(const char* method, const chunk* range) const
+  {
+    std::ostringstream oss;
+    oss << method << ' ' << job_->target << " HTTP/1.1\r\n";
+    oss << "Host: " << options_.host << "\r\n";
+    if (range) {
+      oss << "Range: bytes=" << range->offset << '-' << (range->offset + range->size - 1) << "\r\n";
+    }
+    oss << "Connection: keep-alive\r\n\r\n";
+    return oss.str();
+  }
+
+  void send(std::shared_ptr<link> l, std::string data)
+  {
+    l->writes.push_back(std::move(data));
+    if (l->writes.size() > 1) {
+      return;
+    }
+    write(l);
+  }
+
+  void write(std::shared_ptr<link> l)
+  {
+    // Handlers hold the connection, because a failure on another operation can close the link.
+    auto c = l->socket;
+    c->async_write(asio::buffer(l->writes.front()), [this, l, c](const std::error_code& ec, std::size_t) {
+      if (l->closed) {
+        return;
+      }
+      if (ec) {
+        fail(l, ec);
+        return;
+      }
+      l->writes.pop_front();
+      if (!l->writes.empty()) {
+        write(l);
+      }
+    });
+  }
+
+  // Requests the file size and opens the remaining connections.
+  void head(std::shared_ptr<link> l)
+  {
+    send(l, request("HEAD", nullptr));
+    l->reading = true;
+    auto c = l->socket;
+    c->async_read_header([this, l, c](const std::error_code& ec, std::size_t) {
+      if (l->closed) {
+        return;
+      }
+      if (ec) {
+        fail(l, ec);
+        return;
+      }
+      l->reading = false;
+      response r;
+      std::istream is(&l->socket->input());
+      if (!parse(is, r)) {
+        finish(download_errc::invalid_response);
+        return;
+      }
+      if (r.status != 200) {
+        finish(download_errc::http_status);
+        return;
+      }
+      if (!r.accept_ranges && job_->frontier > 0) {
+        finish(download_errc::ranges_not_supported);
+        return;
+      }
+      job_->total = r.content_length;
+
+      // Start over if the partial file is larger than the file on the server.
+      if (job_->frontier > job_->total) {
+        job_->os.close();
+        job_->os.open(job_->part, std::ios::binary | std::ios::trunc);
+        SHA256_Init(&job_->sha);
+        job_->frontier = 0;
+        job_->next = 0;
+      }
+      if (job_->frontier == job_->total) {
+        finish({});
+        return;
+      }
+      if (!r.keep_alive) {
+        reconnect(l);
+      }
+
+      // Open as many connections as there are chunks to download.
+      auto chunks = (job_->total - job_->frontier + options_.chunk - 1) / options_.chunk;
+      auto count = static_cast<std::size_t>(std::min<std::uint64_t>(options_.connections, chunks));
+      while (links_.size() < count) {
+        auto l = std::make_shared<link>();
+        links_.push_back(l);
+        open(l, [this, l]() {
+          pump(l);
+        });
+      }
+      pump(l);
+    });
+  }
+
+  // Returns the next chunk to request or false if no chunk can be requested yet.
+  bool take(chunk& range)
+  {
+    if (!job_->retry.empty()) {
+      range = job_->retry.front();
+      job_->retry.pop_front();
+      return true;
+    }
+    // Limit the amount of out of order data held in memory.
+    auto window = static_cast<std::uint64_t>(options_.connections * options_.pipeline * options_.chunk);
+    if (job_->next >= job_->total || job_->next >= job_->frontier + window) {
+      return false;
+    }
+    range.offset = job_->next;
+    range.size = std::min<std::uint64_t>(options_.chunk, job_->total - job_->next);
+    job_->next += range.size;
+    return true;
+  }
+
+  // Fills the request pipeline of the link and starts reading responses.
+  void pump(std::shared_ptr<link> l)
+  {
+    if (l->closed || !l->socket) {
+      return;
+    }
+    chunk range;
+    while (l->requests.size() < options_.pipeline && take(range)) {
+      l->requests.push_back(range);
+      send(l, request("GET", &range));
+    }
+    if (!l->reading && !l->requests.empty()) {
+      receive(l);
+    }
+  }
+
+  void receive(std::shared_ptr<link> l)
+  {
+    l->reading = true;
+    auto c = l->socket;
+    c->async_read_header([this, l, c](const std::error_code& ec, std::size_t) {
+      if (l->closed) {
+        return;
+      }
+      if (ec) {
+        fail(l, ec);
+        return;
+      }
+      response r;
+      std::istream is(&l->socket->input());
+      if (!parse(is, r)) {
+        finish(download_errc::invalid_response);
+        return;
+      }
+      const auto& range = l->requests.front();
+      if (r.status != 206) {
+        finish(r.status == 200 ? download_errc::ranges_not_supported : download_errc::http_status);
+        return;
+      }
+      if (!r.has_range || r.range_begin != range.offset || r.content_length != range.size ||
+        r.range_end + 1 != range.offset + range.size || r.range_total != job_->total) {
+        finish(download_errc::size_mismatch);
+        return;
+      }
+      auto size = static_cast<std::size_t>(r.content_length);
+      auto buffered = std::min(l->socket->input().size(), size);
+      auto keep_alive = r.keep_alive;
+      c->async_read(size - buffered, [this, l, c, size, keep_alive](const std::error_code& ec, std::size_t) {
+        if (l->closed) {
+          return;
+        }
+        if (ec) {
+          fail(l, ec);
+          return;
+        }
+        auto range = l->requests.front();
+        l->requests.pop_front();
+        l->reading = false;
+        auto& input = l->socket->input();
+        auto data = asio::buffer_cast<const std::uint8_t*>(input.data());
+        job_->pending.emplace(range.offset, std::vector<std::uint8_t>(data, data + size));
+        input.consume(size);
+        job_->failures = 0;
+        if (!keep_alive) {
+          reconnect(l);
+        }
+        advance();
+      });
+    });
+  }
+
+  // Hashes and writes all chunks that continue the verified part of the file.
+  void advance()
+  {
+    auto it = job_->pending.begin();
+    while (it != job_->pending.end() && it->first == job_->frontier) {
+      const auto& data = it->second;
+      SHA256_Update(&job_->sha, data.data(), data.size());
+      job_->os.write(reinterpret_cast<const char*>(data.data()), data.size());
+      job_->frontier += data.size();
+      it = job_->pending.erase(it);
+    }
+    if (!job_->os) {
+      finish(download_errc::file_error);
+      return;
+    }
+    if (job_->progress) {
+      job_->progress(job_->frontier, job_->total);
+    }
+    if (job_->frontier == job_->total) {
+      finish({});
+      return;
+    }
+    auto links = links_;
+    for (const auto& l : links) {
+      pump(l);
+    }
+  }
+
+  // Returns the link requests to the queue and replaces the link.
+  void reconnect(std::shared_ptr<link> l)
+  {
+    auto& retry = job_->retry;
+    retry.insert(retry.end(), l->requests.begin(), l->requests.end());
+    std::sort(retry.begin(), retry.end(), [](const chunk& a, const chunk& b) {
+      return a.offset < b.offset;
+    });
+    l->requests.clear();
+    close(l, false);
+    auto n = std::make_shared<link>();
+    std::replace(links_.begin(), links_.end(), l, n);
+    auto delay = std::chrono::milliseconds(job_->failures ? 100 << std::min<std::size_t>(job_->failures, 5) : 0);
+    auto timer = std::make_shared<asio::steady_timer>(io_, delay);
+    timer->async_wait([this, n, timer](const std::error_code& ec) {
+      if (n->closed || ec) {
+        return;
+      }
+      open(n, [this, n]() {
+        if (job_->total) {
+          pump(n);
+        } else {
+          head(n);
+        }
+      });
+    });
+  }
+
+  void fail(std::shared_ptr<link> l, const std::error_code& ec)
+  {
+    if (!job_) {
+      return;
+    }
+    job_->error = ec;
+    if (++job_->failures > options_.retries) {
+      finish(download_errc::too_many_failures);
+      return;
+    }
+    reconnect(l);
+  }
+
+  void finish(std::error_code ec)
+  {
+    for (const auto& l : links_) {
+      close(l, true);
+    }
+    links_.clear();
+    auto job = std::move(job_);
+    job->os.close();
+    if (!ec) {
+      std::uint8_t digest[SHA256_DIGEST_LENGTH] = {};
+      SHA256_Final(digest, &job->sha);
+      if (hex(digest, sizeof(digest)) != job->sha256) {
+        std::error_code remove_ec;
+        std::filesystem::remove(job->part, remove_ec);
+        ec = download_errc::digest_mismatch;
+      } else {
+        std::error_code rename_ec;
+        std::filesystem::remove(job->file, rename_ec);
+        std::filesystem::rename(job->part, job->file, rename_ec);
+        if (rename_ec) {
+          ec = download_errc::file_error;
+        }
+      }
+    }
+    if (job->completion) {
+      job->completion(ec, ec == download_errc::too_many_failures ? job->error : std::error_code());
+    }
+  }
+
+  options options_;
+  asio::io_service io_;
+  std::unique_ptr<asio::io_service::work> work_ = std::make_unique<asio::io_service::work>(io_);
+  pool pool_;
+  std::vector<std::shared_ptr<link>> links_;
+  std::unique_ptr<state> job_;
+  std::thread thread_;
+};
+
+download::download(options options) :
+  impl_(std::make_unique<impl>(std::move(options)))
+{}
+
+download::~download()
+{}
+
+void download::start(std::string target, std::filesystem::path file, std::string sha256,
+  progress_handler progress, completion_handler completion)
+{
+  impl_->start(std::move(target), std::move(file), std::move(sha256), std::move(progress), std::move(completion));
+}
+
+void download::cancel()
+{
+  impl_->cancel();
+}
+
+}  // namespace net
+}  // namespace ice
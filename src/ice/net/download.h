@@ -0,0 +1,107 @@
+#pragma once
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <cstdint>
+
+namespace ice {
+namespace net {
+
+enum class download_errc {
+  success = 0,
+  invalid_response,
+  http_status,
+  ranges_not_supported,
+  size_mismatch,
+  digest_mismatch,
+  file_error,
+  too_many_failures,
+};
+
+class download_category : public std::error_category {
+public:
+  const char* name() const noexcept override
+  {
+    return "Download Error";
+  }
+
+  std::string message(int code) const override
+  {
+    switch (static_cast<download_errc>(code)) {
+    case download_errc::success: return "Success.";
+    case download_errc::invalid_response: return "The server sent an invalid HTTP response.";
+    case download_errc::http_status: return "The server responded with an unexpected HTTP status.";
+    case download_errc::ranges_not_supported: return "The server does not support range requests.";
+    case download_errc::size_mismatch: return "The server sent a different amount of data than requested.";
+    case download_errc::digest_mismatch: return "The downloaded file does not match the expected SHA-256 digest.";
+    case download_errc::file_error: return "Could not write the downloaded file.";
+    case download_errc::too_many_failures: return "The connection failed too many times.";
+    }
+    return "Unknown error code: " + std::to_string(code);
+  }
+
+  static download_category& get()
+  {
+    static download_category category;
+    return category;
+  }
+};
+
+inline std::error_code make_error_code(download_errc code)
+{
+  return std::error_code(static_cast<int>(code), download_category::get());
+}
+
+// Downloads files over HTTPS using pipelined range requests on multiple connections.
+// All network and file I/O happens on a dedicated thread.
+class download {
+public:
+  struct options {
+    std::string host;
+    std::string port = "443";
+    bool tls = true;                      // use plain HTTP when false (loopback tests)
+    bool verify = true;                   // verify the server certificate
+    std::string certificates;             // PEM CA bundle, the system store when empty
+    std::size_t connections = 4;          // parallel connections
+    std::size_t pipeline = 4;             // requests in flight per connection
+    std::size_t chunk = 1024 * 1024;      // bytes per range request
+    std::size_t retries = 8;              // reconnect attempts before giving up
+  };
+
+  // Reports the number of verified bytes written to disk and the total file size.
+  using progress_handler = std::function<void(std::uint64_t bytes, std::uint64_t total)>;
+
+  // Reports the download result. When the connection failed too many times,
+  // the cause is the error of the last failed connection attempt.
+  using completion_handler = std::function<void(std::error_code ec, std::error_code cause)>;
+
+  explicit download(options options);
+  ~download();
+
+  // Downloads the target into the given file.
+  // Data is written to "<file>.part" and resumed from there if the file exists.
+  // The SHA-256 digest (hex string) is computed while the data arrives.
+  // The file is renamed after successful verification.
+  // Handlers are called on the download thread.
+  void start(std::string target, std::filesystem::path file, std::string sha256,
+    progress_handler progress, completion_handler completion);
+
+  // Cancels the current download and keeps the partial file.
+  void cancel();
+
+private:
+  class impl;
+  std::unique_ptr<impl> impl_;
+};
+
+}  // namespace net
+}  // namespace ice
+
+namespace std {
+
+template<>
+struct is_error_code_enum<ice::net::download_errc> : true_type {};
+
+}  // namespace std
@@ -0,0 +1,287 @@
+#include <ice/net/pool.h>
+#include <ice/exception.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <algorithm>
+#include <deque>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <wincrypt.h>
+#endif
+
+namespace ice {
+namespace net {
+namespace {
+
+// Adds the trusted root certificates of the operating system to the context.
+// LibreSSL has no certificate store on Windows, so the ROOT system store is imported there.
+void load_system_certificates(asio::ssl::context& context)
+{
+#ifdef _WIN32
+  auto store = CertOpenSystemStoreW(0, L"ROOT");
+  if (!store) {
+    throw ice::runtime_error("Could not open the system certificate store.");
+  }
+  auto x509_store = SSL_CTX_get_cert_store(context.native_handle());
+  PCCERT_CONTEXT certificate = nullptr;
+  while ((certificate = CertEnumCertificatesInStore(store, certificate)) != nullptr) {
+    auto data = static_cast<const unsigned char*>(certificate->pbCertEncoded);
+    if (auto x509 = d2i_X509(nullptr, &data, static_cast<long>(certificate->cbCertEncoded))) {
+      X509_STORE_add_cert(x509_store, x509);
+      X509_free(x509);
+    }
+  }
+  CertCloseStore(store, 0);
+#else
+  context.set_default_verify_paths();
+#endif
+}
+
+}  // namespace
+
+struct pool::host {
+  std::string name;
+  std::string port;
+  asio::ip::tcp::resolver::iterator endpoints;
+  std::size_t active = 0;                           // idle and acquired connections
+  std::deque<std::shared_ptr<connection>> idle;     // most recently used at the back
+  std::deque<handler> waiting;
+  std::unique_ptr<SSL_SESSION, void (*)(SSL_SESSION*)> session{ nullptr, SSL_SESSION_free };
+};
+
+pool::pool(asio::io_service& io, options options) :
+  io_(io), options_(std::move(options)), context_(asio::ssl::context::sslv23_client), resolver_(io), timer_(io)
+{
+  options_.connections = std::max(options_.connections, std::size_t(1));
+  context_.set_options(asio::ssl::context::default_workarounds | asio::ssl::context::no_sslv2 | asio::ssl::context::no_sslv3);
+  if (options_.verify) {
+    if (options_.certificates.empty()) {
+      load_system_certificates(context_);
+    } else {
+      std::error_code ec;
+      context_.load_verify_file(options_.certificates, ec);
+      if (ec) {
+        throw ice::runtime_error("Could not load the certificate bundle.")
+          << options_.certificates << '\n' << ec.message();
+      }
+    }
+  }
+}
+
+pool::~pool()
+{
+  clear();
+}
+
+void pool::acquire(const std::string& name, const std::string& port, handler handler)
+{
+  auto key = name + ':' + port;
+  auto& h = hosts_[key];
+  if (!h) {
+    h = std::make_unique<host>();
+    h->name = name;
+    h->port = port;
+  }
+
+  // Reuse the most recently released connection.
+  while (!h->idle.empty()) {
+    auto c = std::move(h->idle.back());
+    h->idle.pop_back();
+    if (!c->stream_.lowest_layer().is_open()) {
+      h->active--;
+      continue;
+    }
+    c->reused_ = true;
+    stats_.reused++;
+    io_.post([handler, c]() {
+      handler({}, c);
+    });
+    return;
+  }
+
+  // Wait for a connection when the host limit is reached.
+  if (h->active >= options_.connections) {
+    h->waiting.push_back(std::move(handler));
+    return;
+  }
+  h->active++;
+  open(key, std::move(handler));
+}
+
+void pool::release(std::shared_ptr<connection> c, bool reusable)
+{
+  auto it = hosts_.find(c->key_);
+  if (it == hosts_.end()) {
+    c->close();
+    return;
+  }
+  auto& h = *it->second;
+  if (reusable && c->stream_.lowest_layer().is_open() && c->input_.size() == 0) {
+    if (!h.waiting.empty()) {
+      auto handler = std::move(h.waiting.front());
+      h.waiting.pop_front();
+      c->reused_ = true;
+      stats_.reused++;
+      io_.post([handler, c]() {
+        handler({}, c);
+      });
+      return;
+    }
+    c->idle_ = std::chrono::steady_clock::now();
+    h.idle.push_back(std::move(c));
+    if (!evicting_) {
+      evicting_ = true;
+      timer_.expires_from_now(options_.idle);
+      timer_.async_wait([this](const std::error_code& ec) {
+        evicting_ = false;
+        if (!ec) {
+          evict();
+        }
+      });
+    }
+    return;
+  }
+  c->close();
+  h.active--;
+  if (!h.waiting.empty() && h.active < options_.connections) {
+    auto handler = std::move(h.waiting.front());
+    h.waiting.pop_front();
+    h.active++;
+    open(it->first, std::move(handler));
+  }
+}
+
+void pool::clear()
+{
+  std::error_code ec;
+  timer_.cancel(ec);
+  for (auto& e : hosts_) {
+    auto& h = *e.second;
+    for (auto& c : h.idle) {
+      c->close();
+    }
+    h.active -= h.idle.size();
+    h.idle.clear();
+    for (auto& handler : h.waiting) {
+      io_.post([handler]() {
+        handler(asio::error::operation_aborted, nullptr);
+      });
+    }
+    h.waiting.clear();
+  }
+}
+
+void pool::open(const std::string& key, handler handler)
+{
+  auto& h = *hosts_.at(key);
+  auto connect = [this, key, handler]() {
+    auto& h = *hosts_.at(key);
+    auto c = std::make_shared<connection>(io_, context_, options_.tls, key);
+    asio::async_connect(c->stream_.lowest_layer(), h.endpoints,
+      [this, key, handler, c](const std::error_code& ec, asio::ip::tcp::resolver::iterator) {
+      if (ec) {
+        fail(key, handler, ec);
+        return;
+      }
+      std::error_code option_ec;
+      c->stream_.lowest_layer().set_option(asio::ip::tcp::no_delay(true), option_ec);
+      if (!options_.tls) {
+        handler({}, c);
+        return;
+      }
+      auto& h = *hosts_.at(key);
+      auto ssl = c->stream_.native_handle();
+      SSL_set_tlsext_host_name(ssl, h.name.c_str());
+      if (options_.verify) {
+        c->stream_.set_verify_mode(asio::ssl::verify_peer);
+        c->stream_.set_verify_callback(asio::ssl::rfc2818_verification(h.name));
+      } else {
+        c->stream_.set_verify_mode(asio::ssl::verify_none);
+      }
+      if (options_.resume && h.session) {
+        SSL_set_session(ssl, h.session.get());
+      }
+      c->stream_.async_handshake(asio::ssl::stream_base::client, [this, key, handler, c](const std::error_code& ec) {
+        auto& h = *hosts_.at(key);
+        if (ec) {
+          h.session.reset();
+          fail(key, handler, ec);
+          return;
+        }
+        auto ssl = c->stream_.native_handle();
+        if (SSL_session_reused(ssl)) {
+          c->resumed_ = true;
+          stats_.resumed++;
+        } else {
+          stats_.handshakes++;
+        }
+        if (options_.resume) {
+          h.session.reset(SSL_get1_session(ssl));
+        }
+        handler({}, c);
+      });
+    });
+  };
+
+  // Resolve the host once.
+  if (h.endpoints != asio::ip::tcp::resolver::iterator()) {
+    connect();
+    return;
+  }
+  asio::ip::tcp::resolver::query query(h.name, h.port);
+  resolver_.async_resolve(query, [this, key, handler, connect](const std::error_code& ec, asio::ip::tcp::resolver::iterator it) {
+    if (ec) {
+      fail(key, handler, ec);
+      return;
+    }
+    hosts_.at(key)->endpoints = it;
+    connect();
+  });
+}
+
+void pool::fail(const std::string& key, const handler& handler, const std::error_code& ec)
+{
+  auto& h = *hosts_.at(key);
+  h.active--;
+  handler(ec, nullptr);
+  if (!h.waiting.empty() && h.active < options_.connections) {
+    auto next = std::move(h.waiting.front());
+    h.waiting.pop_front();
+    h.active++;
+    open(key, std::move(next));
+  }
+}
+
+void pool::evict()
+{
+  auto now = std::chrono::steady_clock::now();
+  auto next = std::chrono::steady_clock::time_point::max();
+  for (auto& e : hosts_) {
+    auto& h = *e.second;
+    auto it = std::remove_if(h.idle.begin(), h.idle.end(), [&](const std::shared_ptr<connection>& c) {
+      if (now - c->idle_ < options_.idle) {
+        next = std::min(next, c->idle_ + options_.idle);
+        return false;
+      }
+      c->close();
+      stats_.evicted++;
+      return true;
+    });
+    h.active -= static_cast<std::size_t>(std::distance(it, h.idle.end()));
+    h.idle.erase(it, h.idle.end());
+  }
+  if (next != std::chrono::steady_clock::time_point::max()) {
+    evicting_ = true;
+    timer_.expires_at(next);
+    timer_.async_wait([this](const std::error_code& ec) {
+      evicting_ = false;
+      if (!ec) {
+        evict();
+      }
+    });
+  }
+}
+
+}  // namespace net
+}  // namespace ice
@@ -0,0 +1,171 @@
+#pragma once
+#include <asio.hpp>
+#include <asio/ssl.hpp>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <cstdint>
+
+namespace ice {
+namespace net {
+
+// A TCP or TLS client connection that is owned by a pool.
+class connection {
+public:
+  using stream_type = asio::ssl::stream<asio::ip::tcp::socket>;
+
+  connection(asio::io_service& io, asio::ssl::context& context, bool tls, std::string key) :
+    stream_(io, context), tls_(tls), key_(std::move(key))
+  {}
+
+  connection(connection&& other) = delete;
+  connection(const connection& other) = delete;
+
+  connection& operator=(connection&& other) = delete;
+  connection& operator=(const connection& other) = delete;
+
+  template <typename Buffers, typename Handler>
+  void async_write(const Buffers& buffers, Handler handler)
+  {
+    if (tls_) {
+      asio::async_write(stream_, buffers, std::move(handler));
+    } else {
+      asio::async_write(stream_.next_layer(), buffers, std::move(handler));
+    }
+  }
+
+  // Reads until the end of the HTTP header into the input buffer.
+  template <typename Handler>
+  void async_read_header(Handler handler)
+  {
+    if (tls_) {
+      asio::async_read_until(stream_, input_, "\r\n\r\n", std::move(handler));
+    } else {
+      asio::async_read_until(stream_.next_layer(), input_, "\r\n\r\n", std::move(handler));
+    }
+  }
+
+  // Reads exactly the given number of bytes into the input buffer.
+  template <typename Handler>
+  void async_read(std::size_t size, Handler handler)
+  {
+    if (tls_) {
+      asio::async_read(stream_, input_, asio::transfer_exactly(size), std::move(handler));
+    } else {
+      asio::async_read(stream_.next_layer(), input_, asio::transfer_exactly(size), std::move(handler));
+    }
+  }
+
+  asio::streambuf& input() noexcept
+  {
+    return input_;
+  }
+
+  stream_type& stream() noexcept
+  {
+    return stream_;
+  }
+
+  // Returns the pool key ("host:port").
+  const std::string& key() const noexcept
+  {
+    return key_;
+  }
+
+  // Returns true if the connection was used before and kept alive.
+  bool reused() const noexcept
+  {
+    return reused_;
+  }
+
+  // Returns true if the TLS handshake resumed a cached session.
+  bool resumed() const noexcept
+  {
+    return resumed_;
+  }
+
+private:
+  friend class pool;
+
+  void close()
+  {
+    std::error_code ec;
+    stream_.lowest_layer().close(ec);
+  }
+
+  stream_type stream_;
+  asio::streambuf input_;
+  bool tls_ = true;
+  bool reused_ = false;
+  bool resumed_ = false;
+  std::string key_;
+  std::chrono::steady_clock::time_point idle_;
+};
+
+// Keeps client connections alive for reuse, limits the number of connections
+// per host and caches TLS sessions to avoid full handshakes.
+// The pool is not thread safe; use it from the io_service thread only and
+// destroy it after the io_service stopped running.
+// Server certificates are verified against options::certificates when set and
+// against the trusted root certificates of the operating system otherwise.
+class pool {
+public:
+  using handler = std::function<void(const std::error_code& ec, std::shared_ptr<connection> connection)>;
+
+  struct options {
+    bool tls = true;                              // use plain TCP when false
+    bool verify = true;                           // verify the server certificate
+    std::string certificates;                     // PEM CA bundle, the system store when empty
+    bool resume = true;                           // resume cached TLS sessions
+    std::size_t connections = 6;                  // connections per host
+    std::chrono::seconds idle{ 30 };              // idle connection lifetime
+  };
+
+  struct statistics {
+    std::uint64_t handshakes = 0;                 // full TLS handshakes
+    std::uint64_t resumed = 0;                    // abbreviated TLS handshakes
+    std::uint64_t reused = 0;                     // connections reused from the idle list
+    std::uint64_t evicted = 0;                    // idle connections closed after the idle lifetime
+  };
+
+  pool(asio::io_service& io, options options);
+  ~pool();
+
+  // Provides an idle or a new connection to the host.
+  // The handler is queued when the host connection limit is reached.
+  void acquire(const std::string& host, const std::string& port, handler handler);
+
+  // Returns a connection to the pool.
+  // Connections are kept alive when reusable is true and closed otherwise.
+  void release(std::shared_ptr<connection> connection, bool reusable);
+
+  // Closes all idle connections and fails all queued requests.
+  void clear();
+
+  const statistics& stats() const noexcept
+  {
+    return stats_;
+  }
+
+private:
+  struct host;
+
+  void open(const std::string& key, handler handler);
+  void fail(const std::string& key, const handler& handler, const std::error_code& ec);
+  void evict();
+
+  asio::io_service& io_;
+  options options_;
+  asio::ssl::context context_;
+  asio::ip::tcp::resolver resolver_;
+  asio::steady_timer timer_;
+  std::map<std::string, std::unique_ptr<host>> hosts_;
+  statistics stats_;
+  bool evicting_ = false;
+};
+
+}  // namespace net
+}  // namespace ice
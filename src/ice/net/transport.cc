@@ -0,0 +1,839 @@
+#include <ice/net/transport.h>
+#include <ice/exception.h>
+#include <asio.hpp>
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <map>
+#include <random>
+#include <cstring>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <cerrno>
+#endif
+
+// Datagram Format
+// ===============
+// All integers are stored in little endian byte order.
+//
+// uint32  protocol identifier
+// uint8   packet type
+//
+// connect request:  uint32 client salt
+// connect accept:   uint32 client salt, uint32 server salt
+// disconnect:       uint32 connection id (client salt ^ server salt)
+// data:             uint32 connection id, uint16 sequence, uint16 ack, uint32 ack bits
+//                   followed by messages until the end of the datagram:
+//                   uint8 channel, uint16 message id, uint16 size, uint8[size] data
+
+namespace ice {
+namespace net {
+namespace {
+
+const std::uint32_t protocol = 0x31454349;  // "ICE1"
+const std::size_t data_header_size = 4 + 1 + 4 + 2 + 2 + 4;
+const std::size_t message_header_size = 1 + 2 + 2;
+const std::size_t batch_size = 64;
+const std::size_t sent_packets = 256;
+const std::size_t rtt_samples = 1024;
+
+enum packet_type : std::uint8_t {
+  packet_connect_request = 1,
+  packet_connect_accept = 2,
+  packet_disconnect = 3,
+  packet_data = 4,
+};
+
+// Returns true if sequence a is more recent than sequence b.
+bool newer(std::uint16_t a, std::uint16_t b) noexcept
+{
+  return static_cast<std::int16_t>(a - b) > 0;
+}
+
+class writer {
+public:
+  explicit writer(std::vector<std::uint8_t>& data) : data_(data)
+  {}
+
+  template <typename T>
+  void put(T value)
+  {
+    for (std::size_t i = 0; i < sizeof(T); i++) {
+      data_.push_back(static_cast<std::uint8_t>(static_cast<std::uint64_t>(value) >> (i * 8)));
+    }
+  }
+
+  void put(const std::uint8_t* data, std::size_t size)
+  {
+    data_.insert(data_.end(), data, data + size);
+  }
+
+private:
+  std::vector<std::uint8_t>& data_;
+};
+
+class reader {
+public:
+  reader(const std::uint8_t* data, std::size_t size) : it_(data), end_(data + size)
+  {}
+
+  template <typename T>
+  bool get(T& value)
+  {
+    if (static_cast<std::size_t>(end_ - it_) < sizeof(T)) {
+      return false;
+    }
+    std::uint64_t v = 0;
+    for (std::size_t i = 0; i < sizeof(T); i++) {
+      v |= static_cast<std::uint64_t>(*it_++) << (i * 8);
+    }
+    value = static_cast<T>(v);
+    return true;
+  }
+
+  const std::uint8_t* take(std::size_t size)
+  {
+    if (static_cast<std::size_t>(end_ - it_) < size) {
+      return nullptr;
+    }
+    auto data = it_;
+    it_ += size;
+    return data;
+  }
+
+  bool empty() const noexcept
+  {
+    return it_ == end_;
+  }
+
+private:
+  const std::uint8_t* it_;
+  const std::uint8_t* end_;
+};
+
+}  // namespace
+
+class transport::impl {
+public:
+  impl(transport::options options) :
+    options_(std::move(options)), socket_(io_), random_(std::random_device()())
+  {
+    if (options_.channels.empty() || options_.channels.size() > 255) {
+      throw ice::runtime_error("Invalid number of transport channels.") << options_.channels.size();
+    }
+    if (options_.mtu <= data_header_size + message_header_size) {
+      throw ice::runtime_error("Invalid transport MTU.") << options_.mtu;
+    }
+    std::error_code ec;
+    socket_.open(asio::ip::udp::v6(), ec);
+    if (!ec) {
+      socket_.set_option(asio::ip::v6_only(false), ec);
+      socket_.bind(asio::ip::udp::endpoint(asio::ip::udp::v6(), options_.port), ec);
+    }
+    if (ec) {
+      socket_.close(ec);
+      socket_.open(asio::ip::udp::v4());
+      socket_.bind(asio::ip::udp::endpoint(asio::ip::udp::v4(), options_.port), ec);
+      if (ec) {
+        throw ice::runtime_error("Could not bind the transport socket.")
+          << "Port: " << options_.port << '\n' << ec.message();
+      }
+    }
+    socket_.non_blocking(true);
+    buffer_.resize(batch_size * options_.mtu);
+  }
+
+  ~impl()
+  {
+    for (auto& c : connections_) {
+      if (c.second.established) {
+        send_disconnect(c.second);
+      }
+    }
+    for (auto& d : delayed_) {
+      outgoing_.push_back(std::move(d.second));
+    }
+    flush();
+  }
+
+  std::uint16_t port() const
+  {
+    return socket_.local_endpoint().port();
+  }
+
+  std::size_t max_message() const
+  {
+    return options_.mtu - data_header_size - message_header_size;
+  }
+
+  peer connect(const std::string& host, std::uint16_t port)
+  {
+    asio::ip::udp::resolver resolver(io_);
+    auto it = resolver.resolve(asio::ip::udp::resolver::query(host, std::to_string(port)));
+    auto endpoint = map(*it);
+    auto id = next_peer_++;
+    auto& c = add(id, endpoint);
+    c.client = true;
+    c.salt = random_();
+    c.last_received = clock::now();
+    send_request(c);
+    return id;
+  }
+
+  void disconnect(peer peer)
+  {
+    auto it = connections_.find(peer);
+    if (it == connections_.end()) {
+      return;
+    }
+    if (it->second.established) {
+      send_disconnect(it->second);
+    }
+    remove(it);
+  }
+
+  bool connected(peer peer) const
+  {
+    auto it = connections_.find(peer);
+    return it != connections_.end() && it->second.established;
+  }
+
+  void send(peer peer, std::uint8_t channel, const void* data, std::size_t size)
+  {
+    if (channel >= options_.channels.size()) {
+      throw ice::runtime_error("Invalid transport channel.") << static_cast<int>(channel);
+    }
+    if (size > max_message()) {
+      throw ice::runtime_error("Transport message too large.")
+        << "Size: " << size << '\n' << "Maximum: " << max_message();
+    }
+    auto it = connections_.find(peer);
+    if (it == connections_.end()) {
+      return;
+    }
+    auto& ch = it->second.channels[channel];
+    pending m;
+    m.id = ch.send_id++;
+    m.data.assign(reinterpret_cast<const std::uint8_t*>(data), reinterpret_cast<const std::uint8_t*>(data) + size);
+    ch.queue.push_back(std::move(m));
+  }
+
+  void update()
+  {
+    auto now = clock::now();
+    receive(now);
+    for (auto it = connections_.begin(); it != connections_.end();) {
+      auto& c = it->second;
+      if (now - c.last_received > options_.timeout) {
+        it = remove(it);
+        continue;
+      }
+      if (!c.established) {
+        if (c.client && now - c.last_sent >= options_.keepalive) {
+          send_request(c);
+        }
+      } else {
+        write(c, now);
+      }
+      ++it;
+    }
+    while (!delayed_.empty() && delayed_.begin()->first <= now) {
+      outgoing_.push_back(std::move(delayed_.begin()->second));
+      delayed_.erase(delayed_.begin());
+    }
+    flush();
+  }
+
+  bool accept(peer& peer)
+  {
+    if (accepted_.empty()) {
+      return false;
+    }
+    peer = accepted_.front();
+    accepted_.pop_front();
+    return true;
+  }
+
+  bool receive(message& message)
+  {
+    if (messages_.empty()) {
+      return false;
+    }
+    message = std::move(messages_.front());
+    messages_.pop_front();
+    return true;
+  }
+
+  statistics stats(peer peer) const
+  {
+    auto it = connections_.find(peer);
+    if (it == connections_.end()) {
+      return{};
+    }
+    const auto& c = it->second;
+    auto stats = c.stats;
+    stats.rtt = std::chrono::microseconds(static_cast<std::int64_t>(c.rtt));
+    if (!c.rtt_samples.empty()) {
+      auto samples = c.rtt_samples;
+      auto p99 = samples.begin() + (samples.size() * 99 / 100);
+      std::nth_element(samples.begin(), p99, samples.end());
+      stats.rtt_p99 = std::chrono::microseconds(*p99);
+    }
+    return stats;
+  }
+
+private:
+  struct pending {
+    std::uint16_t id = 0;
+    std::vector<std::uint8_t> data;
+    clock::time_point sent;   // last transmission of a reliable message
+    bool acked = false;
+  };
+
+  struct channel {
+    reliability type = reliability::unreliable;
+    std::uint16_t send_id = 0;
+    std::uint16_t receive_id = 0;   // next expected (reliable) or last received (sequenced) id
+    bool received = false;
+    std::deque<pending> queue;      // queued or unacknowledged messages
+    std::map<std::uint16_t, std::vector<std::uint8_t>> buffered;  // reliable messages received out of order
+  };
+
+  struct sent_packet {
+    std::uint16_t sequence = 0;
+    bool valid = false;
+    bool acked = false;
+    clock::time_point time;
+    std::vector<std::pair<std::uint8_t, std::uint16_t>> reliable;  // channel and message id
+  };
+
+  struct connection {
+    peer id = 0;
+    asio::ip::udp::endpoint endpoint;
+    bool client = false;
+    bool established = false;
+    std::uint32_t salt = 0;         // client salt
+    std::uint32_t key = 0;          // client salt ^ server salt
+    clock::time_point last_received;
+    clock::time_point last_sent;
+    bool ack_pending = false;
+
+    std::uint16_t local_sequence = 0;
+    std::uint16_t remote_sequence = 0xFFFF;  // acknowledged before the first packet, precedes sequence 0
+    std::uint32_t remote_bits = 0;
+    bool remote_valid = false;
+    std::array<sent_packet, sent_packets> sent;
+
+    std::vector<channel> channels;
+    statistics stats;
+    double rtt = 0.0;
+    std::vector<std::int64_t> rtt_samples;
+    std::size_t rtt_index = 0;
+  };
+
+  using connections = std::map<peer, connection>;
+
+  // Maps IPv4 endpoints to IPv6 when the socket is dual stack.
+  asio::ip::udp::endpoint map(asio::ip::udp::endpoint endpoint) const
+  {
+    if (endpoint.address().is_v4() && socket_.local_endpoint().address().is_v6()) {
+      auto address = asio::ip::address_v6::v4_mapped(endpoint.address().to_v4());
+      return asio::ip::udp::endpoint(address, endpoint.port());
+    }
+    return endpoint;
+  }
+
+  connection& add(peer id, const asio::ip::udp::endpoint& endpoint)
+  {
+    auto& c = connections_[id];
+    c.id = id;
+    c.endpoint = endpoint;
+    c.channels.resize(options_.channels.size());
+    for (std::size_t i = 0; i < c.channels.size(); i++) {
+      c.channels[i].type = options_.channels[i];
+    }
+    endpoints_[endpoint] = id;
+    return c;
+  }
+
+  connections::iterator remove(connections::iterator it)
+  {
+    endpoints_.erase(it->second.endpoint);
+    return connections_.erase(it);
+  }
+
+  void send_request(connection& c)
+  {
+    std::vector<std::uint8_t> data;
+    writer w(data);
+    w.put<std::uint32_t>(protocol);
+    w.put<std::uint8_t>(packet_connect_request);
+    w.put<std::uint32_t>(c.salt);
+    queue(c, std::move(data));
+  }
+
+  void send_accept(connection& c)
+  {
+    std::vector<std::uint8_t> data;
+    writer w(data);
+    w.put<std::uint32_t>(protocol);
+    w.put<std::uint8_t>(packet_connect_accept);
+    w.put<std::uint32_t>(c.salt);
+    w.put<std::uint32_t>(c.salt ^ c.key);
+    queue(c, std::move(data));
+  }
+
+  void send_disconnect(connection& c)
+  {
+    std::vector<std::uint8_t> data;
+    writer w(data);
+    w.put<std::uint32_t>(protocol);
+    w.put<std::uint8_t>(packet_disconnect);
+    w.put<std::uint32_t>(c.key);
+    outgoing_.emplace_back(c.endpoint, std::move(data));
+  }
+
+  // Coalesces queued and resent messages into datagrams.
+  void write(connection& c, clock::time_point now)
+  {
+    auto resend = std::max(std::chrono::duration_cast<clock::duration>(options_.resend),
+      std::chrono::duration_cast<clock::duration>(std::chrono::microseconds(static_cast<std::int64_t>(c.rtt * 1.25))));
+    std::vector<std::uint8_t> data;
+    sent_packet* packet = nullptr;
+    auto begin = [&]() {
+      data.clear();
+      data.reserve(options_.mtu);
+      writer w(data);
+      w.put<std::uint32_t>(protocol);
+      w.put<std::uint8_t>(packet_data);
+      w.put<std::uint32_t>(c.key);
+      w.put<std::uint16_t>(c.local_sequence);
+      w.put<std::uint16_t>(c.remote_sequence);
+      w.put<std::uint32_t>(c.remote_bits);
+      packet = &c.sent[c.local_sequence % sent_packets];
+      if (packet->valid && !packet->acked) {
+        c.stats.packets_lost++;
+      }
+      packet->sequence = c.local_sequence;
+      packet->valid = true;
+      packet->acked = false;
+      packet->time = now;
+      packet->reliable.clear();
+    };
+    auto end = [&]() {
+      c.local_sequence++;
+      c.ack_pending = false;
+      queue(c, std::move(data));
+      data = {};
+    };
+    auto append = [&](std::uint8_t index, const pending& m) {
+      if (data.empty()) {
+        begin();
+      } else if (data.size() + message_header_size + m.data.size() > options_.mtu) {
+        end();
+        begin();
+      }
+      writer w(data);
+      w.put<std::uint8_t>(index);
+      w.put<std::uint16_t>(m.id);
+      w.put<std::uint16_t>(static_cast<std::uint16_t>(m.data.size()));
+      w.put(m.data.data(), m.data.size());
+    };
+
+    for (std::size_t i = 0; i < c.channels.size(); i++) {
+      auto& ch = c.channels[i];
+      auto index = static_cast<std::uint8_t>(i);
+      if (ch.type != reliability::reliable) {
+        for (const auto& m : ch.queue) {
+          append(index, m);
+        }
+        ch.queue.clear();
+        continue;
+      }
+      // Send new and unacknowledged reliable messages inside the receive window.
+      while (!ch.queue.empty() && ch.queue.front().acked) {
+        ch.queue.pop_front();
+      }
+      if (ch.queue.empty()) {
+        continue;
+      }
+      auto oldest = ch.queue.front().id;
+      for (auto& m : ch.queue) {
+        if (static_cast<std::uint16_t>(m.id - oldest) >= 1024) {
+          break;
+        }
+        if (m.acked || (m.sent != clock::time_point() && now - m.sent < resend)) {
+          continue;
+        }
+        if (m.sent != clock::time_point()) {
+          c.stats.messages_resent++;
+        }
+        m.sent = now;
+        append(index, m);
+        packet->reliable.emplace_back(index, m.id);
+      }
+    }
+
+    if (data.empty() && (c.ack_pending || now - c.last_sent >= options_.keepalive)) {
+      begin();
+    }
+    if (!data.empty()) {
+      end();
+    }
+  }
+
+  // Queues a datagram and applies the simulated network conditions.
+  void queue(connection& c, std::vector<std::uint8_t> data)
+  {
+    c.last_sent = clock::now();
+    c.stats.packets_sent++;
+    c.stats.bytes_sent += data.size();
+    if (options_.loss > 0.0 && std::uniform_real_distribution<double>(0.0, 1.0)(random_) < options_.loss) {
+      return;
+    }
+    if (options_.latency.count() > 0 || options_.jitter.count() > 0) {
+      auto delay = options_.latency;
+      if (options_.jitter.count() > 0) {
+        delay += std::chrono::microseconds(std::uniform_int_distribution<std::int64_t>(0, options_.jitter.count())(random_));
+      }
+      delayed_.emplace(c.last_sent + delay, datagram(c.endpoint, std::move(data)));
+      return;
+    }
+    outgoing_.emplace_back(c.endpoint, std::move(data));
+  }
+
+  // Sends the queued datagrams until the socket buffer is full and keeps the rest queued for the next update.
+  // Datagrams that fail with any other error are dropped.
+  void flush()
+  {
+    std::size_t i = 0;
+#ifdef __linux__
+    std::array<mmsghdr, batch_size> headers;
+    std::array<iovec, batch_size> vectors;
+    while (i < outgoing_.size()) {
+      auto count = std::min(batch_size, outgoing_.size() - i);
+      for (std::size_t j = 0; j < count; j++) {
+        auto& d = outgoing_[i + j];
+        vectors[j].iov_base = d.second.data();
+        vectors[j].iov_len = d.second.size();
+        std::memset(&headers[j], 0, sizeof(mmsghdr));
+        headers[j].msg_hdr.msg_name = d.first.data();
+        headers[j].msg_hdr.msg_namelen = static_cast<socklen_t>(d.first.size());
+        headers[j].msg_hdr.msg_iov = &vectors[j];
+        headers[j].msg_hdr.msg_iovlen = 1;
+      }
+      auto sent = sendmmsg(socket_.native_handle(), headers.data(), static_cast<unsigned>(count), MSG_DONTWAIT);
+      if (sent > 0) {
+        i += static_cast<std::size_t>(sent);
+        continue;
+      }
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) {
+        break;
+      }
+      i++;
+    }
+#else
+    for (; i < outgoing_.size(); i++) {
+      std::error_code ec;
+      socket_.send_to(asio::buffer(outgoing_[i].second), outgoing_[i].first, 0, ec);
+      if (ec == asio::error::would_block || ec == asio::error::no_buffer_space) {
+        break;
+      }
+    }
+#endif
+    outgoing_.erase(outgoing_.begin(), outgoing_.begin() + static_cast<std::ptrdiff_t>(i));
+  }
+
+  // Receives and processes all pending datagrams.
+  void receive(clock::time_point now)
+  {
+#ifdef __linux__
+    std::array<mmsghdr, batch_size> headers;
+    std::array<iovec, batch_size> vectors;
+    std::array<sockaddr_storage, batch_size> addresses;
+    for (;;) {
+      for (std::size_t i = 0; i < batch_size; i++) {
+        vectors[i].iov_base = &buffer_[i * options_.mtu];
+        vectors[i].iov_len = options_.mtu;
+        std::memset(&headers[i], 0, sizeof(mmsghdr));
+        headers[i].msg_hdr.msg_name = &addresses[i];
+        headers[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+        headers[i].msg_hdr.msg_iov = &vectors[i];
+        headers[i].msg_hdr.msg_iovlen = 1;
+      }
+      auto count = recvmmsg(socket_.native_handle(), headers.data(), static_cast<unsigned>(batch_size), MSG_DONTWAIT, nullptr);
+      if (count <= 0) {
+        break;
+      }
+      for (int i = 0; i < count; i++) {
+        if (headers[i].msg_hdr.msg_flags & MSG_TRUNC) {
+          continue;
+        }
+        asio::ip::udp::endpoint endpoint;
+        std::memcpy(endpoint.data(), &addresses[i], headers[i].msg_hdr.msg_namelen);
+        endpoint.resize(headers[i].msg_hdr.msg_namelen);
+        process(endpoint, &buffer_[i * options_.mtu], headers[i].msg_len, now);
+      }
+      if (static_cast<std::size_t>(count) < batch_size) {
+        break;
+      }
+    }
+#else
+    for (;;) {
+      std::error_code ec;
+      asio::ip::udp::endpoint endpoint;
+      auto size = socket_.receive_from(asio::buffer(buffer_.data(), options_.mtu), endpoint, 0, ec);
+      if (ec == asio::error::would_block) {
+        break;
+      }
+      if (!ec) {
+        process(endpoint, buffer_.data(), size, now);
+      }
+    }
+#endif
+  }
+
+  void process(const asio::ip::udp::endpoint& endpoint, const std::uint8_t* data, std::size_t size, clock::time_point now)
+  {
+    reader r(data, size);
+    std::uint32_t id = 0;
+    std::uint8_t type = 0;
+    if (!r.get(id) || id != protocol || !r.get(type)) {
+      return;
+    }
+    auto it = endpoints_.find(endpoint);
+    auto c = it != endpoints_.end() ? &connections_[it->second] : nullptr;
+
+    switch (type) {
+    case packet_connect_request: {
+      std::uint32_t salt = 0;
+      if (!r.get(salt)) {
+        return;
+      }
+      if (c && (c->client || c->salt != salt)) {
+        return;
+      }
+      if (!c) {
+        c = &add(next_peer_++, endpoint);
+        c->salt = salt;
+        c->key = salt ^ random_();
+        c->established = true;
+        accepted_.push_back(c->id);
+      }
+      c->last_received = now;
+      send_accept(*c);
+      return;
+    }
+    case packet_connect_accept: {
+      std::uint32_t salt = 0;
+      std::uint32_t server = 0;
+      if (!c || !c->client || c->established || !r.get(salt) || !r.get(server) || salt != c->salt) {
+        return;
+      }
+      c->key = salt ^ server;
+      c->established = true;
+      c->last_received = now;
+      return;
+    }
+    case packet_disconnect: {
+      std::uint32_t key = 0;
+      if (c && c->established && r.get(key) && key == c->key) {
+        remove(connections_.find(c->id));
+      }
+      return;
+    }
+    case packet_data:
+      break;
+    default:
+      return;
+    }
+
+    std::uint32_t key = 0;
+    std::uint16_t sequence = 0;
+    std::uint16_t ack = 0;
+    std::uint32_t ack_bits = 0;
+    if (!c || !c->established || !r.get(key) || key != c->key ||
+      !r.get(sequence) || !r.get(ack) || !r.get(ack_bits)) {
+      return;
+    }
+    c->last_received = now;
+    c->stats.packets_received++;
+    c->stats.bytes_received += size;
+
+    // Record the received sequence and drop duplicate or very old packets.
+    if (!c->remote_valid || newer(sequence, c->remote_sequence)) {
+      auto shift = static_cast<std::uint16_t>(sequence - c->remote_sequence);
+      if (c->remote_valid) {
+        c->remote_bits = shift < 32 ? (c->remote_bits << shift) | (1u << (shift - 1)) : (shift == 32 ? 1u << 31 : 0);
+      }
+      c->remote_sequence = sequence;
+      c->remote_valid = true;
+    } else {
+      auto distance = static_cast<std::uint16_t>(c->remote_sequence - sequence);
+      if (distance == 0 || distance > 32 || (c->remote_bits & (1u << (distance - 1)))) {
+        return;
+      }
+      c->remote_bits |= 1u << (distance - 1);
+    }
+    c->ack_pending = true;
+
+    // Acknowledge sent packets and the reliable messages they contained.
+    for (std::uint16_t i = 0; i <= 32; i++) {
+      if (i > 0 && !(ack_bits & (1u << (i - 1)))) {
+        continue;
+      }
+      auto s = static_cast<std::uint16_t>(ack - i);
+      auto& packet = c->sent[s % sent_packets];
+      if (!packet.valid || packet.acked || packet.sequence != s) {
+        continue;
+      }
+      packet.acked = true;
+      auto sample = std::chrono::duration_cast<std::chrono::microseconds>(now - packet.time).count();
+      c->rtt = c->rtt > 0.0 ? c->rtt + (sample - c->rtt) * 0.1 : static_cast<double>(sample);
+      if (c->rtt_samples.size() < rtt_samples) {
+        c->rtt_samples.push_back(sample);
+      } else {
+        c->rtt_samples[c->rtt_index++ % rtt_samples] = sample;
+      }
+      for (const auto& m : packet.reliable) {
+        auto& queue = c->channels[m.first].queue;
+        if (queue.empty()) {
+          continue;
+        }
+        auto offset = static_cast<std::uint16_t>(m.second - queue.front().id);
+        if (offset < queue.size()) {
+          queue[offset].acked = true;
+        }
+      }
+    }
+
+    // Deliver messages.
+    while (!r.empty()) {
+      std::uint8_t index = 0;
+      std::uint16_t id = 0;
+      std::uint16_t length = 0;
+      if (!r.get(index) || !r.get(id) || !r.get(length) || index >= c->channels.size()) {
+        return;
+      }
+      auto bytes = r.take(length);
+      if (!bytes) {
+        return;
+      }
+      auto& ch = c->channels[index];
+      switch (ch.type) {
+      case reliability::unreliable:
+        deliver(c->id, index, bytes, length);
+        break;
+      case reliability::sequenced:
+        if (!ch.received || newer(id, ch.receive_id)) {
+          ch.received = true;
+          ch.receive_id = id;
+          deliver(c->id, index, bytes, length);
+        }
+        break;
+      case reliability::reliable:
+        if (static_cast<std::uint16_t>(id - ch.receive_id) < 1024) {
+          ch.buffered.emplace(id, std::vector<std::uint8_t>(bytes, bytes + length));
+        }
+        for (auto it = ch.buffered.find(ch.receive_id); it != ch.buffered.end(); it = ch.buffered.find(ch.receive_id)) {
+          message m;
+          m.from = c->id;
+          m.channel = index;
+          m.data = std::move(it->second);
+          messages_.push_back(std::move(m));
+          ch.buffered.erase(it);
+          ch.receive_id++;
+        }
+        break;
+      }
+    }
+  }
+
+  void deliver(peer from, std::uint8_t channel, const std::uint8_t* data, std::size_t size)
+  {
+    message m;
+    m.from = from;
+    m.channel = channel;
+    m.data.assign(data, data + size);
+    messages_.push_back(std::move(m));
+  }
+
+  using datagram = std::pair<asio::ip::udp::endpoint, std::vector<std::uint8_t>>;
+
+  transport::options options_;
+  asio::io_service io_;
+  asio::ip::udp::socket socket_;
+  std::mt19937 random_;
+  std::vector<std::uint8_t> buffer_;
+  peer next_peer_ = 1;
+  connections connections_;
+  std::map<asio::ip::udp::endpoint, peer> endpoints_;
+  std::deque<peer> accepted_;
+  std::deque<message> messages_;
+  std::vector<datagram> outgoing_;
+  std::multimap<clock::time_point, datagram> delayed_;
+};
+
+transport::transport(options options) :
+  impl_(std::make_unique<impl>(std::move(options)))
+{}
+
+transport::~transport()
+{}
+
+std::uint16_t transport::port() const
+{
+  return impl_->port();
+}
+
+std::size_t transport::max_message() const
+{
+  return impl_->max_message();
+}
+
+transport::peer transport::connect(const std::string& host, std::uint16_t port)
+{
+  return impl_->connect(host, port);
+}
+
+void transport::disconnect(peer peer)
+{
+  impl_->disconnect(peer);
+}
+
+bool transport::connected(peer peer) const
+{
+  return impl_->connected(peer);
+}
+
+void transport::send(peer peer, std::uint8_t channel, const void* data, std::size_t size)
+{
+  impl_->send(peer, channel, data, size);
+}
+
+void transport::update()
+{
+  impl_->update();
+}
+
+bool transport::accept(peer& peer)
+{
+  return impl_->accept(peer);
+}
+
+bool transport::receive(message& message)
+{
+  return impl_->receive(message);
+}
+
+transport::statistics transport::stats(peer peer) const
+{
+  return impl_->stats(peer);
+}
+
+}  // namespace net
+}  // namespace ice
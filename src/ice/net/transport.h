@@ -0,0 +1,101 @@
+#pragma once
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace ice {
+namespace net {
+
+// Channel delivery guarantees.
+enum class reliability : std::uint8_t {
+  unreliable,  // sent once, may be lost, duplicated messages are dropped with their packet
+  sequenced,   // sent once, messages older than the last received message are dropped
+  reliable,    // resent until acknowledged and delivered in order
+};
+
+// Connection oriented message transport over UDP.
+// Messages are coalesced into datagrams up to the configured MTU and every
+// datagram acknowledges the last 33 received datagrams with a sequence/ack
+// bitfield. The transport does not use threads; call update() regularly.
+class transport {
+public:
+  using clock = std::chrono::steady_clock;
+  using peer = std::uint32_t;
+
+  struct options {
+    std::uint16_t port = 0;                                   // local port, 0 for any
+    std::size_t mtu = 1200;                                   // maximum datagram size in bytes
+    std::vector<reliability> channels = {
+      reliability::unreliable, reliability::sequenced, reliability::reliable
+    };
+    std::chrono::milliseconds timeout{ 5000 };                // connection timeout
+    std::chrono::milliseconds keepalive{ 100 };               // empty packet interval
+    std::chrono::milliseconds resend{ 50 };                   // minimum reliable resend interval
+
+    // Network conditions simulated for outgoing datagrams.
+    double loss = 0.0;                                        // drop probability
+    std::chrono::microseconds latency{ 0 };                   // constant delay
+    std::chrono::microseconds jitter{ 0 };                    // random delay in [0, jitter]
+  };
+
+  struct message {
+    peer from = 0;
+    std::uint8_t channel = 0;
+    std::vector<std::uint8_t> data;
+  };
+
+  struct statistics {
+    std::uint64_t packets_sent = 0;
+    std::uint64_t packets_received = 0;
+    std::uint64_t packets_lost = 0;        // sent packets that were never acknowledged
+    std::uint64_t bytes_sent = 0;
+    std::uint64_t bytes_received = 0;
+    std::uint64_t messages_resent = 0;
+    std::chrono::microseconds rtt{ 0 };    // smoothed round trip time
+    std::chrono::microseconds rtt_p99{ 0 };  // 99th percentile of recent round trip times
+  };
+
+  explicit transport(options options);
+  ~transport();
+
+  // Returns the bound local port.
+  std::uint16_t port() const;
+
+  // Returns the largest message that fits into a single datagram.
+  std::size_t max_message() const;
+
+  // Starts the connection handshake with a remote transport.
+  peer connect(const std::string& host, std::uint16_t port);
+
+  // Notifies the remote transport and closes the connection.
+  void disconnect(peer peer);
+
+  // Returns true when the handshake completed and the connection did not time out.
+  bool connected(peer peer) const;
+
+  // Queues a message. It is sent with the next update().
+  void send(peer peer, std::uint8_t channel, const void* data, std::size_t size);
+
+  // Receives datagrams, resends unacknowledged reliable messages, handles timeouts and flushes
+  // the queued messages. Messages that do not fit into the socket buffer are sent with the
+  // next update(). Does not block.
+  void update();
+
+  // Returns the next connection accepted from a remote transport.
+  bool accept(peer& peer);
+
+  // Returns the next delivered message.
+  bool receive(message& message);
+
+  // Returns the connection statistics.
+  statistics stats(peer peer) const;
+
+private:
+  class impl;
+  std::unique_ptr<impl> impl_;
+};
+
+}  // namespace net
+}  // namespace ice
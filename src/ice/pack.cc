@@ -0,0 +1,130 @@
+#include <ice/pack.h>
+#include <ice/exception.h>
+#include <zip.h>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace ice {
+namespace {
+
+class writer : public mz_zip_archive {
+public:
+  writer(const std::filesystem::path& path) : mz_zip_archive({})
+  {
+    os.open(path, std::ios::binary | std::ios::trunc);
+    if (!os) {
+      throw ice::runtime_error("Could not create archive.") << path.u8string();
+    }
+    m_pIO_opaque = &os;
+    m_pWrite = [](void* handle, mz_uint64 offset, const void* data, size_t size) -> size_t {
+      auto& os = *reinterpret_cast<std::ofstream*>(handle);
+      os.seekp(offset, std::ios::beg);
+      os.write(reinterpret_cast<const char*>(data), size);
+      return os ? size : 0;
+    };
+    if (!mz_zip_writer_init(this, 0)) {
+      throw ice::runtime_error("Could not initialize archive.") << path.u8string();
+    }
+  }
+
+  ~writer()
+  {
+    mz_zip_writer_end(this);
+  }
+
+  void finalize()
+  {
+    if (!mz_zip_writer_finalize_archive(this)) {
+      throw ice::runtime_error("Could not finalize archive.");
+    }
+    os.close();
+    if (!os) {
+      throw ice::runtime_error("Could not write archive.");
+    }
+  }
+
+private:
+  std::ofstream os;
+};
+
+}  // namespace
+
+void create_pack(const std::filesystem::path& directory, const std::filesystem::path& pack,
+  const std::filesystem::path& trace)
+{
+  // Collect the files.
+  auto root = directory.generic_u8string();
+  while (root.size() > 1 && root.back() == '/') {
+    root.pop_back();
+  }
+  std::vector<std::string> files;
+  for (std::filesystem::recursive_directory_iterator it(root), end; it != end; ++it) {
+    if (std::filesystem::is_regular_file(it->status())) {
+      files.push_back(it->path().generic_u8string().substr(root.size() + 1));
+    }
+  }
+  std::sort(files.begin(), files.end());
+
+  // Move the traced files to the front.
+  if (!trace.empty()) {
+    std::ifstream is(trace);
+    if (!is) {
+      throw ice::runtime_error("Could not open trace file.") << trace.u8string();
+    }
+    std::vector<std::string> traced;
+    std::unordered_set<std::string> seen;
+    for (std::string name; std::getline(is, name);) {
+      if (!name.empty() && name.back() == '\r') {
+        name.pop_back();
+      }
+      if (std::binary_search(files.begin(), files.end(), name) && seen.insert(name).second) {
+        traced.push_back(name);
+      }
+    }
+    files.erase(std::remove_if(files.begin(), files.end(), [&seen](const std::string& name) {
+      return seen.count(name) != 0;
+    }), files.end());
+    files.insert(files.begin(), traced.begin(), traced.end());
+  }
+
+  // Write the pack.
+  auto output = pack;
+  output += ".new";
+  try {
+    writer dst(output);
+    for (const auto& name : files) {
+      std::ifstream file(std::filesystem::path(root) / name, std::ios::binary);
+      std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+      if (!file && !file.eof()) {
+        throw ice::runtime_error("Could not read file.") << name;
+      }
+      // Store textures uncompressed so that they can be uploaded from the memory mapped pack.
+      const auto stored = std::filesystem::path(name).extension() == ".ktx2";
+      const auto level = stored ? MZ_NO_COMPRESSION : MZ_DEFAULT_LEVEL;
+      if (!mz_zip_writer_add_mem(&dst, name.c_str(), data.data(), data.size(), level)) {
+        throw ice::runtime_error("Could not add archive entry.") << name;
+      }
+    }
+    dst.finalize();
+  }
+  catch (...) {
+    std::error_code ec;
+    std::filesystem::remove(output, ec);
+    throw;
+  }
+
+  // Replace the pack.
+  std::error_code ec;
+  std::filesystem::rename(output, pack, ec);
+  if (ec) {
+    std::filesystem::remove(output, ec);
+    throw ice::runtime_error("Could not replace the pack.")
+      << pack.u8string() << '\n' << ec.message();
+  }
+}
+
+}  // namespace ice
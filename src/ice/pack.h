@@ -0,0 +1,13 @@
+#pragma once
+#include <filesystem>
+
+namespace ice {
+
+// Creates a pack from all files in the directory.
+// Files listed in the trace (one relative path per line, see ice::archive::trace) are stored
+// first in the order of their first access, followed by all other files in name order.
+// KTX 2.0 textures (.ktx2) are stored uncompressed for zero-copy access (see ice::archive::view).
+void create_pack(const std::filesystem::path& directory, const std::filesystem::path& pack,
+  const std::filesystem::path& trace = {});
+
+}  // namespace ice
@@ -0,0 +1,528 @@
+#include <ice/patch.h>
+#include <ice/codec.h>
+#include <ice/exception.h>
+#include <zip.h>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Patch File Format
+// =================
+// All integers are stored in little endian byte order.
+//
+// char[8]  magic "ICEPATCH"
+// uint32   version
+// uint32   source pack fingerprint (see fingerprint)
+// uint32   number of entries in the target pack
+//
+// For every entry in target pack order:
+// uint16   name size
+// char[]   name
+// uint8    operation (see operation)
+// uint8    compression level for the target pack
+// uint64   uncompressed entry size
+// uint32   uncompressed entry CRC-32
+// uint64   payload size (delta and data operations only)
+// uint64   stored payload size; payload is deflated when smaller than payload size
+// uint8[]  stored payload
+//
+// Delta payloads contain a sequence of instructions:
+// 0 varint(offset) varint(size)  copy bytes from the source entry
+// 1 varint(size) uint8[size]     insert literal bytes
+
+namespace ice {
+namespace {
+
+const char magic[8] = { 'I', 'C', 'E', 'P', 'A', 'T', 'C', 'H' };
+const std::uint32_t version = 1;
+
+enum class operation : std::uint8_t {
+  copy = 0,   // clone the unchanged entry from the source pack
+  delta = 1,  // reconstruct the entry from the source entry and the delta payload
+  data = 2,   // use the payload as entry data
+};
+
+enum instruction : std::uint8_t {
+  instruction_copy = 0,
+  instruction_insert = 1,
+};
+
+class reader : public mz_zip_archive {
+public:
+  reader(const std::filesystem::path& path) : mz_zip_archive({})
+  {
+    is.open(path, std::ios::binary);
+    if (!is) {
+      throw ice::runtime_error("Could not open archive.") << path.u8string();
+    }
+    m_pIO_opaque = &is;
+    m_pRead = [](void* handle, mz_uint64 offset, void* data, size_t size) -> size_t {
+      auto& is = *reinterpret_cast<std::ifstream*>(handle);
+      is.seekg(offset, std::ios::beg);
+      is.read(reinterpret_cast<char*>(data), size);
+      return static_cast<size_t>(is.gcount());
+    };
+    if (!mz_zip_reader_init(this, std::filesystem::file_size(path), 0)) {
+      throw ice::runtime_error("Could not read archive.") << path.u8string();
+    }
+    for (mz_uint i = 0, size = mz_zip_reader_get_num_files(this); i < size; i++) {
+      mz_zip_archive_file_stat stat = {};
+      if (!mz_zip_reader_file_stat(this, i, &stat)) {
+        throw ice::runtime_error("Could not read archive entry.") << path.u8string();
+      }
+      index.emplace(stat.m_filename, i);
+      stats.push_back(stat);
+    }
+  }
+
+  ~reader()
+  {
+    mz_zip_reader_end(this);
+  }
+
+  std::vector<std::uint8_t> extract(mz_uint i)
+  {
+    std::vector<std::uint8_t> data(static_cast<std::size_t>(stats[i].m_uncomp_size));
+    if (!data.empty() && !mz_zip_reader_extract_to_mem(this, i, data.data(), data.size(), 0)) {
+      throw ice::runtime_error("Could not extract archive entry.") << stats[i].m_filename;
+    }
+    return data;
+  }
+
+  std::unordered_map<std::string, mz_uint> index;
+  std::vector<mz_zip_archive_file_stat> stats;
+
+private:
+  std::ifstream is;
+};
+
+class writer : public mz_zip_archive {
+public:
+  writer(const std::filesystem::path& path) : mz_zip_archive({})
+  {
+    os.open(path, std::ios::binary | std::ios::trunc);
+    if (!os) {
+      throw ice::runtime_error("Could not create archive.") << path.u8string();
+    }
+    m_pIO_opaque = &os;
+    m_pWrite = [](void* handle, mz_uint64 offset, const void* data, size_t size) -> size_t {
+      auto& os = *reinterpret_cast<std::ofstream*>(handle);
+      os.seekp(offset, std::ios::beg);
+      os.write(reinterpret_cast<const char*>(data), size);
+      return os ? size : 0;
+    };
+    if (!mz_zip_writer_init(this, 0)) {
+      throw ice::runtime_error("Could not initialize archive.") << path.u8string();
+    }
+  }
+
+  ~writer()
+  {
+    mz_zip_writer_end(this);
+  }
+
+  void finalize()
+  {
+    if (!mz_zip_writer_finalize_archive(this)) {
+      throw ice::runtime_error("Could not finalize archive.");
+    }
+    os.close();
+    if (!os) {
+      throw ice::runtime_error("Could not write archive.");
+    }
+  }
+
+private:
+  std::ofstream os;
+};
+
+template <typename T>
+void put(std::ostream& os, T value)
+{
+  char data[sizeof(T)];
+  for (std::size_t i = 0; i < sizeof(T); i++) {
+    data[i] = static_cast<char>(static_cast<std::uint64_t>(value) >> (i * 8));
+  }
+  os.write(data, sizeof(data));
+}
+
+template <typename T>
+T get(std::istream& is)
+{
+  unsigned char data[sizeof(T)] = {};
+  is.read(reinterpret_cast<char*>(data), sizeof(data));
+  if (!is) {
+    throw ice::runtime_error("Unexpected end of patch file.");
+  }
+  std::uint64_t value = 0;
+  for (std::size_t i = 0; i < sizeof(T); i++) {
+    value |= static_cast<std::uint64_t>(data[i]) << (i * 8);
+  }
+  return static_cast<T>(value);
+}
+
+void put_varint(std::vector<std::uint8_t>& data, std::uint64_t value)
+{
+  while (value >= 0x80) {
+    data.push_back(static_cast<std::uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  data.push_back(static_cast<std::uint8_t>(value));
+}
+
+std::uint64_t get_varint(const std::uint8_t*& it, const std::uint8_t* end)
+{
+  std::uint64_t value = 0;
+  for (unsigned shift = 0; it != end && shift < 64; shift += 7) {
+    auto byte = *it++;
+    value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      return value;
+    }
+  }
+  throw ice::runtime_error("Invalid patch instruction.");
+}
+
+// Identifies the source pack by the names, checksums and sizes of all entries.
+std::uint32_t fingerprint(const reader& pack)
+{
+  auto crc = static_cast<mz_ulong>(MZ_CRC32_INIT);
+  for (const auto& stat : pack.stats) {
+    std::uint8_t data[12] = {};
+    for (std::size_t i = 0; i < 4; i++) {
+      data[i] = static_cast<std::uint8_t>(stat.m_crc32 >> (i * 8));
+    }
+    for (std::size_t i = 0; i < 8; i++) {
+      data[4 + i] = static_cast<std::uint8_t>(stat.m_uncomp_size >> (i * 8));
+    }
+    crc = mz_crc32(crc, reinterpret_cast<const unsigned char*>(stat.m_filename), std::strlen(stat.m_filename));
+    crc = mz_crc32(crc, data, sizeof(data));
+  }
+  return static_cast<std::uint32_t>(crc);
+}
+
+// Rolling checksum over a fixed size window (see rsync).
+class checksum {
+public:
+  checksum(const std::uint8_t* data, std::size_t size) : size_(static_cast<std::uint32_t>(size))
+  {
+    for (std::size_t i = 0; i < size; i++) {
+      a_ += data[i];
+      b_ += static_cast<std::uint32_t>(size - i) * data[i];
+    }
+  }
+
+  void roll(std::uint8_t out, std::uint8_t in) noexcept
+  {
+    a_ += in - out;
+    b_ += a_ - size_ * out;
+  }
+
+  std::uint32_t value() const noexcept
+  {
+    return (a_ & 0xFFFF) | (b_ << 16);
+  }
+
+private:
+  std::uint32_t a_ = 0;
+  std::uint32_t b_ = 0;
+  std::uint32_t size_ = 0;
+};
+
+// Encodes the target entry as copies from the source entry and literal inserts.
+std::vector<std::uint8_t> diff(const std::vector<std::uint8_t>& src, const std::vector<std::uint8_t>& dst)
+{
+  std::vector<std::uint8_t> delta;
+  auto literal = [&](std::size_t begin, std::size_t end) {
+    if (begin < end) {
+      delta.push_back(instruction_insert);
+      put_varint(delta, end - begin);
+      delta.insert(delta.end(), dst.begin() + begin, dst.begin() + end);
+    }
+  };
+
+  // Choose a block size near the square root of the entry size.
+  auto block = static_cast<std::size_t>(std::sqrt(static_cast<double>(src.size())));
+  block = std::min(std::max(block, std::size_t(32)), std::size_t(8192));
+  if (src.size() < block || dst.size() < block) {
+    literal(0, dst.size());
+    return delta;
+  }
+
+  // Index the source blocks by their weak checksum.
+  auto blocks = src.size() / block;
+  std::size_t buckets = 1;
+  while (buckets < blocks * 2) {
+    buckets <<= 1;
+  }
+  const std::uint32_t none = ~std::uint32_t(0);
+  std::vector<std::uint32_t> head(buckets, none);
+  std::vector<std::uint32_t> next(blocks, none);
+  for (std::size_t i = blocks; i-- > 0;) {
+    auto bucket = checksum(&src[i * block], block).value() & (buckets - 1);
+    next[i] = head[bucket];
+    head[bucket] = static_cast<std::uint32_t>(i);
+  }
+
+  // Scan the target entry and extend every block match as far as possible.
+  std::size_t pos = 0;
+  std::size_t begin = 0;
+  checksum sum(&dst[0], block);
+  while (pos + block <= dst.size()) {
+    std::size_t match = 0;
+    std::size_t offset = 0;
+    auto candidates = 0;
+    for (auto i = head[sum.value() & (buckets - 1)]; i != none && candidates < 16; i = next[i], candidates++) {
+      auto o = static_cast<std::size_t>(i) * block;
+      if (std::memcmp(&src[o], &dst[pos], block) != 0) {
+        continue;
+      }
+      auto size = block;
+      while (pos + size < dst.size() && o + size < src.size() && src[o + size] == dst[pos + size]) {
+        size++;
+      }
+      if (size > match) {
+        match = size;
+        offset = o;
+      }
+    }
+    if (!match) {
+      if (pos + block < dst.size()) {
+        sum.roll(dst[pos], dst[pos + block]);
+      }
+      pos++;
+      continue;
+    }
+
+    // Grow the match backwards into the pending literal bytes.
+    while (pos > begin && offset > 0 && src[offset - 1] == dst[pos - 1]) {
+      pos--;
+      offset--;
+      match++;
+    }
+    literal(begin, pos);
+    delta.push_back(instruction_copy);
+    put_varint(delta, offset);
+    put_varint(delta, match);
+    pos += match;
+    begin = pos;
+    if (pos + block <= dst.size()) {
+      sum = checksum(&dst[pos], block);
+    }
+  }
+  literal(begin, dst.size());
+  return delta;
+}
+
+std::vector<std::uint8_t> undiff(const std::vector<std::uint8_t>& src, const std::vector<std::uint8_t>& delta, std::size_t size)
+{
+  std::vector<std::uint8_t> dst;
+  dst.reserve(size);
+  auto it = delta.data();
+  auto end = delta.data() + delta.size();
+  while (it != end) {
+    auto type = *it++;
+    if (type == instruction_copy) {
+      auto offset = get_varint(it, end);
+      auto length = get_varint(it, end);
+      if (offset > src.size() || length > src.size() - offset) {
+        throw ice::runtime_error("Invalid patch copy instruction.");
+      }
+      dst.insert(dst.end(), src.begin() + offset, src.begin() + offset + length);
+    } else if (type == instruction_insert) {
+      auto length = get_varint(it, end);
+      if (length > static_cast<std::uint64_t>(end - it)) {
+        throw ice::runtime_error("Invalid patch insert instruction.");
+      }
+      dst.insert(dst.end(), it, it + length);
+      it += length;
+    } else {
+      throw ice::runtime_error("Invalid patch instruction.");
+    }
+  }
+  return dst;
+}
+
+std::uint32_t crc32(const std::vector<std::uint8_t>& data)
+{
+  return ice::crc32(0, data.data(), data.size());
+}
+
+}  // namespace
+
+void create_patch(const std::filesystem::path& source, const std::filesystem::path& target,
+  const std::filesystem::path& patch)
+{
+  reader src(source);
+  reader dst(target);
+
+  std::ofstream os(patch, std::ios::binary | std::ios::trunc);
+  if (!os) {
+    throw ice::runtime_error("Could not create patch file.") << patch.u8string();
+  }
+  os.write(magic, sizeof(magic));
+  put<std::uint32_t>(os, version);
+  put<std::uint32_t>(os, fingerprint(src));
+  put<std::uint32_t>(os, static_cast<std::uint32_t>(dst.stats.size()));
+
+  for (std::size_t i = 0; i < dst.stats.size(); i++) {
+    const auto& stat = dst.stats[i];
+    std::string name = stat.m_filename;
+    auto level = static_cast<std::uint8_t>(stat.m_method ? MZ_DEFAULT_LEVEL : MZ_NO_COMPRESSION);
+    auto it = src.index.find(name);
+
+    put<std::uint16_t>(os, static_cast<std::uint16_t>(name.size()));
+    os.write(name.data(), name.size());
+
+    // Reference unchanged entries.
+    if (it != src.index.end()) {
+      const auto& old = src.stats[it->second];
+      if (old.m_crc32 == stat.m_crc32 && old.m_uncomp_size == stat.m_uncomp_size && old.m_method == stat.m_method) {
+        put<std::uint8_t>(os, static_cast<std::uint8_t>(operation::copy));
+        put<std::uint8_t>(os, level);
+        put<std::uint64_t>(os, stat.m_uncomp_size);
+        put<std::uint32_t>(os, stat.m_crc32);
+        continue;
+      }
+    }
+
+    // Encode changed entries as a delta when it is smaller than the data.
+    auto data = dst.extract(static_cast<mz_uint>(i));
+    auto type = operation::data;
+    auto payload = &data;
+    std::vector<std::uint8_t> delta;
+    if (it != src.index.end() && !data.empty()) {
+      delta = diff(src.extract(it->second), data);
+      if (delta.size() < data.size()) {
+        type = operation::delta;
+        payload = &delta;
+      }
+    }
+
+    std::vector<std::uint8_t> stored(mz_compressBound(static_cast<mz_ulong>(payload->size())));
+    auto stored_size = static_cast<mz_ulong>(stored.size());
+    if (mz_compress2(stored.data(), &stored_size, payload->data(), static_cast<mz_ulong>(payload->size()), MZ_BEST_COMPRESSION) != MZ_OK ||
+      stored_size >= payload->size()) {
+      stored = *payload;
+      stored_size = static_cast<mz_ulong>(payload->size());
+    }
+
+    put<std::uint8_t>(os, static_cast<std::uint8_t>(type));
+    put<std::uint8_t>(os, level);
+    put<std::uint64_t>(os, stat.m_uncomp_size);
+    put<std::uint32_t>(os, stat.m_crc32);
+    put<std::uint64_t>(os, payload->size());
+    put<std::uint64_t>(os, stored_size);
+    os.write(reinterpret_cast<const char*>(stored.data()), stored_size);
+  }
+
+  os.close();
+  if (!os) {
+    throw ice::runtime_error("Could not write patch file.") << patch.u8string();
+  }
+}
+
+void apply_patch(const std::filesystem::path& pack, const std::filesystem::path& patch)
+{
+  std::ifstream is(patch, std::ios::binary);
+  if (!is) {
+    throw ice::runtime_error("Could not open patch file.") << patch.u8string();
+  }
+  char header[sizeof(magic)] = {};
+  is.read(header, sizeof(header));
+  if (!is || std::memcmp(header, magic, sizeof(magic)) != 0 || get<std::uint32_t>(is) != version) {
+    throw ice::runtime_error("Invalid patch file.") << patch.u8string();
+  }
+
+  auto output = pack;
+  output += ".new";
+  try {
+    reader src(pack);
+    if (get<std::uint32_t>(is) != fingerprint(src)) {
+      throw ice::runtime_error("The patch does not apply to this pack.")
+        << "Pack:  " << pack.u8string() << '\n'
+        << "Patch: " << patch.u8string();
+    }
+
+    writer dst(output);
+    auto entries = get<std::uint32_t>(is);
+    for (std::uint32_t i = 0; i < entries; i++) {
+      std::string name;
+      name.resize(get<std::uint16_t>(is));
+      is.read(&name[0], name.size());
+      auto type = static_cast<operation>(get<std::uint8_t>(is));
+      auto level = get<std::uint8_t>(is);
+      auto size = get<std::uint64_t>(is);
+      auto crc = get<std::uint32_t>(is);
+      auto it = src.index.find(name);
+
+      if (type == operation::copy) {
+        if (it == src.index.end() || src.stats[it->second].m_crc32 != crc || src.stats[it->second].m_uncomp_size != size) {
+          throw ice::runtime_error("Patch entry does not match the pack.") << name;
+        }
+        if (!mz_zip_writer_add_from_zip_reader(&dst, &src, it->second)) {
+          throw ice::runtime_error("Could not copy archive entry.") << name;
+        }
+        continue;
+      }
+
+      auto payload_size = static_cast<std::size_t>(get<std::uint64_t>(is));
+      auto stored_size = static_cast<std::size_t>(get<std::uint64_t>(is));
+      std::vector<std::uint8_t> stored(stored_size);
+      is.read(reinterpret_cast<char*>(stored.data()), stored.size());
+      if (!is) {
+        throw ice::runtime_error("Unexpected end of patch file.");
+      }
+      std::vector<std::uint8_t> payload;
+      if (stored_size < payload_size) {
+        payload.resize(payload_size);
+        auto length = static_cast<mz_ulong>(payload.size());
+        if (mz_uncompress(payload.data(), &length, stored.data(), static_cast<mz_ulong>(stored.size())) != MZ_OK || length != payload_size) {
+          throw ice::runtime_error("Could not decompress patch entry.") << name;
+        }
+      } else {
+        payload = std::move(stored);
+      }
+
+      std::vector<std::uint8_t> data;
+      if (type == operation::delta) {
+        if (it == src.index.end()) {
+          throw ice::runtime_error("Patch entry does not match the pack.") << name;
+        }
+        data = undiff(src.extract(it->second), payload, static_cast<std::size_t>(size));
+      } else if (type == operation::data) {
+        data = std::move(payload);
+      } else {
+        throw ice::runtime_error("Invalid patch operation.") << name;
+      }
+      if (data.size() != size || crc32(data) != crc) {
+        throw ice::runtime_error("Patch entry checksum mismatch.") << name;
+      }
+      if (!mz_zip_writer_add_mem(&dst, name.c_str(), data.data(), data.size(), level)) {
+        throw ice::runtime_error("Could not add archive entry.") << name;
+      }
+    }
+    dst.finalize();
+  }
+  catch (...) {
+    std::error_code ec;
+    std::filesystem::remove(output, ec);
+    throw;
+  }
+
+  // Replace the pack.
+  std::error_code ec;
+  std::filesystem::rename(output, pack, ec);
+  if (ec) {
+    std::filesystem::remove(output, ec);
+    throw ice::runtime_error("Could not replace the pack.")
+      << pack.u8string() << '\n' << ec.message();
+  }
+}
+
+}  // namespace ice
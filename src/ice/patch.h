@@ -0,0 +1,18 @@
+#pragma once
+#include <filesystem>
+
+namespace ice {
+
+// Creates a patch that transforms the source pack into the target pack.
+// Unchanged entries are referenced, changed entries are encoded as block
+// copies from the source entry with literal data in between.
+void create_patch(const std::filesystem::path& source, const std::filesystem::path& target,
+  const std::filesystem::path& patch);
+
+// Applies a patch to the given pack.
+// The new pack is streamed to "<pack>.new" one entry at a time, every entry
+// is verified against its CRC-32 and the pack is replaced after all entries
+// were written. The pack must not be opened by an ice::archive instance.
+void apply_patch(const std::filesystem::path& pack, const std::filesystem::path& patch);
+
+}  // namespace ice
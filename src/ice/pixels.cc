@@ -0,0 +1,397 @@
+#include <ice/pixels.h>
+#include <algorithm>
+#include <limits>
+#include <cstring>
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define ICE_PIXELS_SSSE3 1
+#define ICE_PIXELS_F16C 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#include <tmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace ice {
+namespace {
+
+// Number of pixels that are converted to half floats on the stack before they are packed.
+constexpr std::size_t chunk_size = 256;
+
+// Largest value that can be represented as RGB9_E5: (2^9 - 1) / 2^9 * 2^(31 - 15).
+constexpr float rgb9e5_max = 65408.0f;
+
+// Converts a half float to an unsigned float with the given number of mantissa bits by rounding
+// the mantissa to nearest even. Finite values saturate instead of rounding up to infinity.
+std::uint32_t to_unsigned_float(std::uint16_t half, float value, unsigned bits) noexcept
+{
+  const auto shift = 10 - bits;
+  const auto finite = static_cast<std::uint32_t>(0x7C00 >> shift) - 1;
+  if (half & 0x8000) {
+    return 0;
+  }
+  if (half >= 0x7C00) {
+    if (half > 0x7C00) {
+      return 0x7FFu >> (11 - 5 - bits);
+    }
+    return value < std::numeric_limits<float>::infinity() ? finite : finite + 1;
+  }
+  const auto odd = (half >> shift) & 1;
+  const auto result = (half + (1u << (shift - 1)) - 1 + odd) >> shift;
+  return std::min(static_cast<std::uint32_t>(result), finite);
+}
+
+std::uint32_t pack_r11g11b10(const std::uint16_t* half, const float* value) noexcept
+{
+  const auto r = to_unsigned_float(half[0], value[0], 6);
+  const auto g = to_unsigned_float(half[1], value[1], 6);
+  const auto b = to_unsigned_float(half[2], value[2], 5);
+  return r | (g << 11) | (b << 22);
+}
+
+std::uint32_t pack_rgb9e5(float r, float g, float b) noexcept
+{
+  // Clamp to [0, max]. The comparisons are ordered so that NaN becomes zero.
+  const auto clamp = [](float value) {
+    return value > 0.0f ? (value < rgb9e5_max ? value : rgb9e5_max) : 0.0f;
+  };
+  r = clamp(r);
+  g = clamp(g);
+  b = clamp(b);
+  const auto max = std::max(std::max(r, g), b);
+
+  // The shared exponent is max(-16, floor(log2(max))) + 16, read from the float exponent.
+  std::uint32_t bits = 0;
+  std::memcpy(&bits, &max, sizeof(bits));
+  auto exponent = std::max(static_cast<std::int32_t>(bits >> 23) - 127, -16) + 16;
+  const auto scale = [](std::int32_t shared) {
+    const auto factor = static_cast<std::uint32_t>(151 - shared) << 23;
+    float value = 0.0f;
+    std::memcpy(&value, &factor, sizeof(value));
+    return value;
+  };
+  if (static_cast<std::uint32_t>(max * scale(exponent) + 0.5f) == 512) {
+    exponent++;
+  }
+  const auto factor = scale(exponent);
+  const auto rm = static_cast<std::uint32_t>(r * factor + 0.5f);
+  const auto gm = static_cast<std::uint32_t>(g * factor + 0.5f);
+  const auto bm = static_cast<std::uint32_t>(b * factor + 0.5f);
+  return rm | (gm << 9) | (bm << 18) | (static_cast<std::uint32_t>(exponent) << 27);
+}
+
+void expand_row(const std::uint8_t* src, std::uint8_t* dst, std::size_t cx, std::uint8_t value) noexcept
+{
+  for (std::size_t i = 0; i < cx; i++, src += 3, dst += 4) {
+    dst[0] = src[0];
+    dst[1] = src[1];
+    dst[2] = src[2];
+    dst[3] = value;
+  }
+}
+
+#ifdef ICE_PIXELS_SSSE3
+
+#ifdef __GNUC__
+#define ICE_TARGET_SSSE3 __attribute__((target("ssse3")))
+#else
+#define ICE_TARGET_SSSE3
+#endif
+
+bool has_ssse3()
+{
+#ifdef _MSC_VER
+  int info[4] = {};
+  __cpuid(info, 1);
+  const auto ecx = static_cast<unsigned>(info[2]);
+#else
+  unsigned eax = 0;
+  unsigned ebx = 0;
+  unsigned ecx = 0;
+  unsigned edx = 0;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+    return false;
+  }
+#endif
+  return (ecx & (1 << 9)) != 0;
+}
+
+// Expands 16 pixels (48 bytes) per iteration. The three loads are realigned so that every
+// store uses the same shuffle, which moves 12 bytes into place and clears the fourth bytes.
+ICE_TARGET_SSSE3 void expand_row_ssse3(const std::uint8_t* src, std::uint8_t* dst, std::size_t cx,
+  std::uint8_t value) noexcept
+{
+  const auto shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+  const auto fourth = _mm_set1_epi32(static_cast<int>(static_cast<std::uint32_t>(value) << 24));
+  std::size_t i = 0;
+  for (; i + 16 <= cx; i += 16, src += 48, dst += 64) {
+    const auto x0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 0));
+    const auto x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+    const auto x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 32));
+    const auto p0 = x0;
+    const auto p1 = _mm_alignr_epi8(x1, x0, 12);
+    const auto p2 = _mm_alignr_epi8(x2, x1, 8);
+    const auto p3 = _mm_srli_si128(x2, 4);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 0), _mm_or_si128(_mm_shuffle_epi8(p0, shuffle), fourth));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16), _mm_or_si128(_mm_shuffle_epi8(p1, shuffle), fourth));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 32), _mm_or_si128(_mm_shuffle_epi8(p2, shuffle), fourth));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 48), _mm_or_si128(_mm_shuffle_epi8(p3, shuffle), fourth));
+  }
+  expand_row(src, dst, cx - i, value);
+}
+
+#endif
+
+#ifdef ICE_PIXELS_F16C
+
+#ifdef __GNUC__
+#define ICE_TARGET_F16C __attribute__((target("avx,f16c")))
+#define ICE_TARGET_XSAVE __attribute__((target("xsave")))
+#else
+#define ICE_TARGET_F16C
+#define ICE_TARGET_XSAVE
+#endif
+
+// The F16C instructions are VEX encoded and require the operating system to save the AVX state.
+ICE_TARGET_XSAVE bool has_f16c()
+{
+#ifdef _MSC_VER
+  int info[4] = {};
+  __cpuid(info, 1);
+  const auto ecx = static_cast<unsigned>(info[2]);
+#else
+  unsigned eax = 0;
+  unsigned ebx = 0;
+  unsigned ecx = 0;
+  unsigned edx = 0;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+    return false;
+  }
+#endif
+  const auto features = (1u << 27) | (1u << 28) | (1u << 29);  // OSXSAVE, AVX and F16C
+  return (ecx & features) == features && (_xgetbv(0) & 6) == 6;
+}
+
+ICE_TARGET_F16C void to_half_f16c(const float* src, std::uint16_t* dst, std::size_t count) noexcept
+{
+  std::size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const auto value = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), value);
+  }
+  for (; i < count; i++) {
+    dst[i] = to_half(src[i]);
+  }
+}
+
+ICE_TARGET_F16C void from_half_f16c(const std::uint16_t* src, float* dst, std::size_t count) noexcept
+{
+  std::size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const auto value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(value));
+  }
+  for (; i < count; i++) {
+    dst[i] = from_half(src[i]);
+  }
+}
+
+#endif
+
+#if defined(_M_X64) || defined(__SSE2__)
+
+// Packs four pixels at once with the same operations as pack_rgb9e5.
+void to_rgb9e5_sse2(const float* src, std::uint32_t* dst, std::size_t count) noexcept
+{
+  const auto zero = _mm_setzero_ps();
+  const auto max = _mm_set1_ps(rgb9e5_max);
+  const auto half = _mm_set1_ps(0.5f);
+  const auto bias = _mm_set1_epi32(151);
+  const auto minimum = _mm_set1_epi32(-16 + 127);
+  const auto overflow = _mm_set1_epi32(512);
+  const auto clamp = [&](__m128 value) {
+    return _mm_min_ps(_mm_max_ps(value, zero), max);
+  };
+  const auto scale = [&](__m128i exponent) {
+    return _mm_castsi128_ps(_mm_slli_epi32(_mm_sub_epi32(bias, exponent), 23));
+  };
+  std::size_t i = 0;
+  for (; i + 4 <= count; i += 4, src += 12) {
+    const auto r = clamp(_mm_setr_ps(src[0], src[3], src[6], src[9]));
+    const auto g = clamp(_mm_setr_ps(src[1], src[4], src[7], src[10]));
+    const auto b = clamp(_mm_setr_ps(src[2], src[5], src[8], src[11]));
+    const auto m = _mm_max_ps(_mm_max_ps(r, g), b);
+
+    // Compute max(biased exponent, 111) - 111 without the SSE4.1 integer maximum.
+    auto exponent = _mm_srli_epi32(_mm_castps_si128(m), 23);
+    const auto small = _mm_cmplt_epi32(exponent, minimum);
+    exponent = _mm_or_si128(_mm_and_si128(small, minimum), _mm_andnot_si128(small, exponent));
+    exponent = _mm_sub_epi32(exponent, minimum);
+
+    const auto mantissa = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(m, scale(exponent)), half));
+    exponent = _mm_sub_epi32(exponent, _mm_cmpeq_epi32(mantissa, overflow));
+    const auto factor = scale(exponent);
+    const auto rm = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(r, factor), half));
+    const auto gm = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(g, factor), half));
+    const auto bm = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(b, factor), half));
+    auto value = _mm_or_si128(rm, _mm_slli_epi32(gm, 9));
+    value = _mm_or_si128(value, _mm_slli_epi32(bm, 18));
+    value = _mm_or_si128(value, _mm_slli_epi32(exponent, 27));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), value);
+  }
+  for (; i < count; i++, src += 3) {
+    dst[i] = pack_rgb9e5(src[0], src[1], src[2]);
+  }
+}
+
+#endif
+
+}  // namespace
+
+void copy_rows(const std::uint8_t* src, std::size_t src_stride, std::uint8_t* dst, std::size_t dst_stride,
+  std::size_t size, std::size_t rows) noexcept
+{
+  if (!size || !rows) {
+    return;
+  }
+  if (src_stride == size && dst_stride == size) {
+    std::memcpy(dst, src, size * rows);
+    return;
+  }
+  for (std::size_t i = 0; i < rows; i++, src += src_stride, dst += dst_stride) {
+    std::memcpy(dst, src, size);
+  }
+}
+
+void expand_rows(const std::uint8_t* src, std::size_t src_stride, std::uint8_t* dst, std::size_t dst_stride,
+  std::size_t cx, std::size_t rows, std::uint8_t value) noexcept
+{
+#ifdef ICE_PIXELS_SSSE3
+  static const auto ssse3 = has_ssse3();
+  if (ssse3) {
+    for (std::size_t i = 0; i < rows; i++, src += src_stride, dst += dst_stride) {
+      expand_row_ssse3(src, dst, cx, value);
+    }
+    return;
+  }
+#endif
+  for (std::size_t i = 0; i < rows; i++, src += src_stride, dst += dst_stride) {
+    expand_row(src, dst, cx, value);
+  }
+}
+
+// See "float->half variants" (Fabian Giesen, 2016).
+std::uint16_t to_half(float value) noexcept
+{
+  constexpr std::uint32_t infinity = 255 << 23;
+  constexpr std::uint32_t overflow = (127 + 16) << 23;
+  constexpr std::uint32_t magic = ((127 - 15) + (23 - 10) + 1) << 23;
+  std::uint32_t bits = 0;
+  std::memcpy(&bits, &value, sizeof(bits));
+  const auto sign = bits & 0x80000000;
+  bits ^= sign;
+  std::uint32_t half = 0;
+  if (bits >= overflow) {
+    half = bits > infinity ? 0x7E00 : 0x7C00;
+  } else if (bits < (113 << 23)) {
+    // Align the mantissa of the subnormal result with float addition.
+    float magic_value = 0.0f;
+    std::memcpy(&magic_value, &magic, sizeof(magic_value));
+    float aligned = 0.0f;
+    std::memcpy(&aligned, &bits, sizeof(aligned));
+    aligned += magic_value;
+    std::memcpy(&bits, &aligned, sizeof(bits));
+    half = bits - magic;
+  } else {
+    const auto odd = (bits >> 13) & 1;
+    bits += (static_cast<std::uint32_t>(15 - 127) << 23) + 0xFFF + odd;
+    half = bits >> 13;
+  }
+  return static_cast<std::uint16_t>(half | (sign >> 16));
+}
+
+// See "half->float variants" (Fabian Giesen, 2016).
+float from_half(std::uint16_t value) noexcept
+{
+  constexpr std::uint32_t shifted = 0x7C00 << 13;
+  constexpr std::uint32_t magic = 113 << 23;
+  std::uint32_t bits = (value & 0x7FFFu) << 13;
+  const auto exponent = bits & shifted;
+  bits += (127 - 15) << 23;
+  float result = 0.0f;
+  if (exponent == shifted) {
+    // Infinity or NaN.
+    bits += (128 - 16) << 23;
+    std::memcpy(&result, &bits, sizeof(result));
+  } else if (exponent == 0) {
+    // Zero or subnormal, renormalized with float subtraction.
+    bits += 1 << 23;
+    float magic_value = 0.0f;
+    std::memcpy(&magic_value, &magic, sizeof(magic_value));
+    std::memcpy(&result, &bits, sizeof(result));
+    result -= magic_value;
+  } else {
+    std::memcpy(&result, &bits, sizeof(result));
+  }
+  std::memcpy(&bits, &result, sizeof(bits));
+  bits |= static_cast<std::uint32_t>(value & 0x8000) << 16;
+  std::memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+void to_half(const float* src, std::uint16_t* dst, std::size_t count) noexcept
+{
+#ifdef ICE_PIXELS_F16C
+  static const auto f16c = has_f16c();
+  if (f16c) {
+    to_half_f16c(src, dst, count);
+    return;
+  }
+#endif
+  for (std::size_t i = 0; i < count; i++) {
+    dst[i] = to_half(src[i]);
+  }
+}
+
+void from_half(const std::uint16_t* src, float* dst, std::size_t count) noexcept
+{
+#ifdef ICE_PIXELS_F16C
+  static const auto f16c = has_f16c();
+  if (f16c) {
+    from_half_f16c(src, dst, count);
+    return;
+  }
+#endif
+  for (std::size_t i = 0; i < count; i++) {
+    dst[i] = from_half(src[i]);
+  }
+}
+
+void to_r11g11b10(const float* src, std::uint32_t* dst, std::size_t count) noexcept
+{
+  // Round to half floats first, which shares the exponent range, and then round the mantissas.
+  std::uint16_t half[chunk_size * 3];
+  for (std::size_t i = 0; i < count; i += chunk_size) {
+    const auto size = std::min(count - i, chunk_size);
+    to_half(src + i * 3, half, size * 3);
+    for (std::size_t j = 0; j < size; j++) {
+      dst[i + j] = pack_r11g11b10(half + j * 3, src + (i + j) * 3);
+    }
+  }
+}
+
+void to_rgb9e5(const float* src, std::uint32_t* dst, std::size_t count) noexcept
+{
+#if defined(_M_X64) || defined(__SSE2__)
+  to_rgb9e5_sse2(src, dst, count);
+#else
+  for (std::size_t i = 0; i < count; i++, src += 3) {
+    dst[i] = pack_rgb9e5(src[0], src[1], src[2]);
+  }
+#endif
+}
+
+}  // namespace ice
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace ice {
+
+// Copies rows of bytes between buffers with different strides (distances between rows in bytes).
+// Rows that are contiguous in both buffers are copied at once.
+void copy_rows(const std::uint8_t* src, std::size_t src_stride, std::uint8_t* dst, std::size_t dst_stride,
+  std::size_t size, std::size_t rows) noexcept;
+
+// Expands rows of 3 byte pixels to 4 byte pixels with a constant fourth byte (e.g. RGB to opaque RGBA).
+// Uses SSSE3 byte shuffles when the CPU supports them.
+void expand_rows(const std::uint8_t* src, std::size_t src_stride, std::uint8_t* dst, std::size_t dst_stride,
+  std::size_t cx, std::size_t rows, std::uint8_t value = 0xFF) noexcept;
+
+// Converts a float to a half float with round to nearest even.
+std::uint16_t to_half(float value) noexcept;
+
+// Converts a half float to a float.
+float from_half(std::uint16_t value) noexcept;
+
+// Converts floats to half floats with round to nearest even.
+// Uses the F16C instructions when the CPU supports them.
+void to_half(const float* src, std::uint16_t* dst, std::size_t count) noexcept;
+
+// Converts half floats to floats.
+// Uses the F16C instructions when the CPU supports them.
+void from_half(const std::uint16_t* src, float* dst, std::size_t count) noexcept;
+
+// Packs RGB floats into unsigned 11:11:10 floats (GL_UNSIGNED_INT_10F_11F_11F_REV, red in the low bits).
+// Negative values become zero and finite values saturate at the largest finite value.
+void to_r11g11b10(const float* src, std::uint32_t* dst, std::size_t count) noexcept;
+
+// Packs RGB floats into 9:9:9 mantissas with a shared 5 bit exponent (GL_UNSIGNED_INT_5_9_9_9_REV).
+// Follows the EXT_texture_shared_exponent conversion. Uses SSE2 when available.
+void to_rgb9e5(const float* src, std::uint32_t* dst, std::size_t count) noexcept;
+
+}  // namespace ice
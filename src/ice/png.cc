@@ -0,0 +1,206 @@
+#include <ice/png.h>
+#include <ice/codec.h>
+#include <ice/exception.h>
+#include <ice/jobs.h>
+#include <zlib.h>
+#include <algorithm>
+#include <cstring>
+
+namespace ice {
+namespace {
+
+constexpr std::size_t band_size = 256 * 1024;
+constexpr std::size_t window_size = 32 * 1024;
+
+void write_be(std::uint8_t* dst, std::uint32_t value) noexcept
+{
+  dst[0] = static_cast<std::uint8_t>(value >> 24);
+  dst[1] = static_cast<std::uint8_t>(value >> 16);
+  dst[2] = static_cast<std::uint8_t>(value >> 8);
+  dst[3] = static_cast<std::uint8_t>(value);
+}
+
+// Writes a chunk with the length, type, data and CRC-32 of the type and data. Returns the end of the chunk.
+std::uint8_t* write_chunk(std::uint8_t* dst, const char* type, const std::uint8_t* data, std::size_t size)
+{
+  write_be(dst, static_cast<std::uint32_t>(size));
+  std::memcpy(dst + 4, type, 4);
+  if (size) {
+    std::memcpy(dst + 8, data, size);
+  }
+  write_be(dst + 8 + size, ice::crc32(0, dst + 4, size + 4));
+  return dst + size + 12;
+}
+
+std::size_t pixel_size(png_format format) noexcept
+{
+  switch (format) {
+  case png_format::gray: return 1;
+  case png_format::gray_alpha: return 2;
+  case png_format::rgb: return 3;
+  case png_format::rgba: return 4;
+  case png_format::rgbx: return 4;
+  }
+  return 0;
+}
+
+std::uint8_t color_type(png_format format) noexcept
+{
+  switch (format) {
+  case png_format::gray: return 0;
+  case png_format::gray_alpha: return 4;
+  case png_format::rgb: return 2;
+  case png_format::rgba: return 6;
+  case png_format::rgbx: return 2;
+  }
+  return 0;
+}
+
+}  // namespace
+
+std::vector<std::uint8_t> encode_png(const std::uint8_t* data, std::size_t stride, std::size_t cx, std::size_t cy,
+  png_format format, bool flip, ice::jobs* jobs, int level)
+{
+  constexpr std::size_t max_size = 0x7FFFFFFF;
+  if (!data || cx < 1 || cy < 1 || cx > max_size || cy > max_size || !pixel_size(format)) {
+    throw ice::runtime_error("Invalid PNG image.") << "Size: " << cx << 'x' << cy;
+  }
+  const auto src_size = pixel_size(format);
+  const auto dst_size = format == png_format::rgbx ? std::size_t(3) : src_size;
+  const auto row = cx * dst_size;
+  const auto line = row + 1;
+
+  // Returns the source row in encoding order, or a copy without the fourth bytes of RGBX pixels.
+  const auto load = [&](std::size_t y, std::uint8_t* buffer) {
+    const auto src = data + stride * (flip ? cy - 1 - y : y);
+    if (format != png_format::rgbx) {
+      return src;
+    }
+    for (std::size_t x = 0; x < cx; x++) {
+      buffer[x * 3 + 0] = src[x * 4 + 0];
+      buffer[x * 3 + 1] = src[x * 4 + 1];
+      buffer[x * 3 + 2] = src[x * 4 + 2];
+    }
+    return static_cast<const std::uint8_t*>(buffer);
+  };
+
+  // Filter the rows. The Up filter only depends on the source rows, so ranges of rows are independent.
+  std::vector<std::uint8_t> filtered(line * cy);
+  const auto filter = [&](std::size_t begin, std::size_t end) {
+    std::vector<std::uint8_t> buffers(format == png_format::rgbx ? row * 2 : 0);
+    auto cur_buffer = buffers.data();
+    auto prev_buffer = buffers.data() + (buffers.empty() ? 0 : row);
+    const std::uint8_t* prev = begin > 0 ? load(begin - 1, prev_buffer) : nullptr;
+    for (auto y = begin; y < end; y++) {
+      const auto cur = load(y, cur_buffer);
+      auto dst = filtered.data() + line * y;
+      dst[0] = 2;
+      if (prev) {
+        for (std::size_t i = 0; i < row; i++) {
+          dst[i + 1] = static_cast<std::uint8_t>(cur[i] - prev[i]);
+        }
+      } else {
+        std::memcpy(dst + 1, cur, row);
+      }
+      std::swap(cur_buffer, prev_buffer);
+      prev = cur;
+    }
+  };
+  if (jobs) {
+    jobs->parallel_for(0, cy, filter);
+  } else {
+    filter(0, cy);
+  }
+
+  // Deflate bands of rows into IDAT chunks. The first chunk starts with the zlib header.
+  const auto band_rows = std::max(band_size / line, std::size_t(1));
+  const auto bands = (cy + band_rows - 1) / band_rows;
+  std::vector<std::vector<std::uint8_t>> chunks(bands);
+  std::vector<uLong> checksums(bands);
+  const auto deflate_bands = [&](std::size_t begin, std::size_t end) {
+    for (auto band = begin; band < end; band++) {
+      const auto offset = line * band_rows * band;
+      const auto size = std::min(line * band_rows, filtered.size() - offset);
+      const auto src = filtered.data() + offset;
+      const auto last = band + 1 == bands;
+
+      z_stream stream = {};
+      if (deflateInit2(&stream, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        throw ice::runtime_error("Could not initialize the PNG deflate stream.") << "Level: " << level;
+      }
+      if (offset > 0) {
+        const auto window = std::min(offset, window_size);
+        deflateSetDictionary(&stream, src - window, static_cast<uInt>(window));
+      }
+
+      // Sync flushes end on a byte boundary without the final block bit, so the next band can follow directly.
+      auto& chunk = chunks[band];
+      chunk.resize(deflateBound(&stream, static_cast<uLong>(size)) + 32);
+      std::memcpy(chunk.data() + 4, "IDAT", 4);
+      std::size_t header = 8;
+      if (band == 0) {
+        const std::uint8_t cmf = 0x78;
+        auto flg = static_cast<std::uint8_t>((level == 0 || level == 1 ? 0 : level < 6 ? 1 : level < 7 ? 2 : 3) << 6);
+        flg = static_cast<std::uint8_t>(flg + 31 - (cmf * 256 + flg) % 31);
+        chunk[header++] = cmf;
+        chunk[header++] = flg;
+      }
+      stream.next_in = const_cast<Bytef*>(src);
+      stream.avail_in = static_cast<uInt>(size);
+      stream.next_out = chunk.data() + header;
+      stream.avail_out = static_cast<uInt>(chunk.size() - header - 4);
+      const auto result = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+      const auto written = chunk.size() - header - 4 - stream.avail_out;
+      const auto complete = last ? result == Z_STREAM_END : result == Z_OK && stream.avail_out > 0;
+      deflateEnd(&stream);
+      if (!complete || stream.avail_in) {
+        throw ice::runtime_error("Could not deflate the PNG image data.") << "Result: " << result;
+      }
+      const auto data_size = header - 8 + written;
+      chunk.resize(data_size + 12);
+      write_be(chunk.data(), static_cast<std::uint32_t>(data_size));
+      write_be(chunk.data() + 8 + data_size, ice::crc32(0, chunk.data() + 4, data_size + 4));
+      checksums[band] = adler32(adler32(0, nullptr, 0), src, static_cast<uInt>(size));
+    }
+  };
+  if (jobs) {
+    jobs->parallel_for(0, bands, deflate_bands, 1);
+  } else {
+    deflate_bands(0, bands);
+  }
+
+  // Combine the band checksums into the Adler-32 checksum of the zlib stream.
+  auto checksum = checksums[0];
+  for (std::size_t band = 1; band < bands; band++) {
+    const auto size = std::min(line * band_rows, filtered.size() - line * band_rows * band);
+    checksum = adler32_combine(checksum, checksums[band], static_cast<z_off_t>(size));
+  }
+
+  // Write the signature, header, image data and end chunks.
+  static const std::uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+  std::uint8_t ihdr[13] = {};
+  write_be(ihdr, static_cast<std::uint32_t>(cx));
+  write_be(ihdr + 4, static_cast<std::uint32_t>(cy));
+  ihdr[8] = 8;
+  ihdr[9] = color_type(format);
+  std::uint8_t adler[4] = {};
+  write_be(adler, static_cast<std::uint32_t>(checksum));
+
+  std::size_t size = sizeof(signature) + sizeof(ihdr) + sizeof(adler) + 36;
+  for (const auto& chunk : chunks) {
+    size += chunk.size();
+  }
+  std::vector<std::uint8_t> png(size);
+  auto dst = png.data();
+  std::memcpy(dst, signature, sizeof(signature));
+  dst = write_chunk(dst + sizeof(signature), "IHDR", ihdr, sizeof(ihdr));
+  for (const auto& chunk : chunks) {
+    std::memcpy(dst, chunk.data(), chunk.size());
+    dst += chunk.size();
+  }
+  dst = write_chunk(dst, "IDAT", adler, sizeof(adler));
+  write_chunk(dst, "IEND", nullptr, 0);
+  return png;
+}
+
+}  // namespace ice
@@ -0,0 +1,27 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace ice {
+
+class jobs;
+
+// Pixel layouts of 8 bit source images.
+enum class png_format {
+  gray,        // 1 byte per pixel
+  gray_alpha,  // 2 bytes per pixel
+  rgb,         // 3 bytes per pixel
+  rgba,        // 4 bytes per pixel
+  rgbx,        // 4 bytes per pixel, encoded as RGB without the fourth byte (e.g. opaque frame buffers)
+};
+
+// Encodes an 8 bit image as PNG with the given zlib compression level (1 is the fastest).
+// Rows use the Up filter. The filtered rows are split into bands of about 256 KiB that are deflated
+// independently on the job scheduler: every band is primed with the last 32 KiB of the previous band and
+// ends on a byte boundary, so the bands form a single zlib stream and every band becomes one IDAT chunk.
+// Set flip for images with the bottom row first (e.g. OpenGL frame buffers). Throws ice::runtime_error.
+std::vector<std::uint8_t> encode_png(const std::uint8_t* data, std::size_t stride, std::size_t cx, std::size_t cy,
+  png_format format, bool flip = false, ice::jobs* jobs = nullptr, int level = 1);
+
+}  // namespace ice
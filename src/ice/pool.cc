@@ -0,0 +1,72 @@
+#include <ice/pool.h>
+#include <algorithm>
+#include <new>
+
+namespace ice {
+
+constexpr std::size_t pool::granularity;
+constexpr std::size_t pool::max_size;
+
+pool::pool(std::size_t chunk) :
+  chunk_(std::max(chunk, max_size + granularity))
+{
+  free_.fill(nullptr);
+}
+
+pool::~pool()
+{}
+
+void* pool::allocate(std::size_t size)
+{
+  stats_.allocations++;
+  if (size > max_size) {
+    stats_.fallbacks++;
+    return ::operator new(size);
+  }
+  const auto index = (std::max(size, std::size_t(1)) - 1) / granularity;
+  const auto bytes = (index + 1) * granularity;
+  stats_.used += bytes;
+  stats_.peak = std::max(stats_.peak, stats_.used);
+
+  // Reuse a free block.
+  if (auto block = free_[index]) {
+    free_[index] = block->next;
+    return block;
+  }
+
+  // Carve a new block from the current chunk.
+  if (static_cast<std::size_t>(end_ - cursor_) < bytes) {
+    chunks_.push_back(std::make_unique<std::uint8_t[]>(chunk_));
+    const auto base = reinterpret_cast<std::uintptr_t>(chunks_.back().get());
+    const auto aligned = (base + granularity - 1) & ~(granularity - 1);
+    cursor_ = chunks_.back().get() + (aligned - base);
+    end_ = chunks_.back().get() + chunk_;
+    stats_.chunks = chunks_.size();
+  }
+  auto block = cursor_;
+  cursor_ += bytes;
+  return block;
+}
+
+void pool::deallocate(void* p, std::size_t size) noexcept
+{
+  if (!p) {
+    return;
+  }
+  if (size > max_size) {
+    ::operator delete(p);
+    return;
+  }
+  const auto index = (std::max(size, std::size_t(1)) - 1) / granularity;
+  stats_.used -= (index + 1) * granularity;
+  auto block = static_cast<node*>(p);
+  block->next = free_[index];
+  free_[index] = block;
+}
+
+pool::statistics pool::stats() const noexcept
+{
+  return stats_;
+}
+
+}  // namespace ice
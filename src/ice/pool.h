@@ -0,0 +1,101 @@
+#pragma once
+#include <array>
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace ice {
+
+// Allocates small fixed size objects, e.g. shared GL object wrappers and container nodes, from free lists.
+// Sizes are rounded up to a multiple of 16 bytes and every size has its own free list. Blocks are carved
+// from large chunks that are only returned to the heap when the pool is destroyed. Objects that are larger
+// than max_size bytes are served from the heap. The alignment must not exceed 16. Not thread safe.
+class pool {
+public:
+  static constexpr std::size_t granularity = 16;
+  static constexpr std::size_t max_size = 256;
+
+  struct statistics {
+    std::size_t chunks = 0;         // number of allocated chunks
+    std::size_t used = 0;           // bytes in use
+    std::size_t peak = 0;           // most bytes in use at the same time
+    std::uint64_t allocations = 0;  // number of allocations
+    std::uint64_t fallbacks = 0;    // allocations that were served from the heap
+  };
+
+  explicit pool(std::size_t chunk = 64 * 1024);
+
+  pool(pool&& other) = delete;
+  pool(const pool& other) = delete;
+
+  pool& operator=(pool&& other) = delete;
+  pool& operator=(const pool& other) = delete;
+
+  // All objects must be deallocated before the pool is destroyed.
+  ~pool();
+
+  void* allocate(std::size_t size);
+  void deallocate(void* p, std::size_t size) noexcept;
+
+  statistics stats() const noexcept;
+
+private:
+  struct node {
+    node* next;
+  };
+
+  std::array<node*, max_size / granularity> free_;
+  std::vector<std::unique_ptr<std::uint8_t[]>> chunks_;
+  std::size_t chunk_ = 0;
+  std::uint8_t* cursor_ = nullptr;
+  std::uint8_t* end_ = nullptr;
+  statistics stats_;
+};
+
+// Allocator for standard containers and std::allocate_shared that allocates from a pool.
+template <typename T>
+class pool_allocator {
+public:
+  using value_type = T;
+
+  pool_allocator(ice::pool& pool) noexcept : pool_(&pool)
+  {}
+
+  template <typename U>
+  pool_allocator(const pool_allocator<U>& other) noexcept : pool_(other.pool())
+  {}
+
+  T* allocate(std::size_t n)
+  {
+    static_assert(alignof(T) <= ice::pool::granularity, "Pool allocations must not be aligned to more than 16 bytes.");
+    return static_cast<T*>(pool_->allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T* p, std::size_t n) noexcept
+  {
+    pool_->deallocate(p, n * sizeof(T));
+  }
+
+  ice::pool* pool() const noexcept
+  {
+    return pool_;
+  }
+
+private:
+  ice::pool* pool_ = nullptr;
+};
+
+template <typename T, typename U>
+inline bool operator==(const pool_allocator<T>& a, const pool_allocator<U>& b) noexcept
+{
+  return a.pool() == b.pool();
+}
+
+template <typename T, typename U>
+inline bool operator!=(const pool_allocator<T>& a, const pool_allocator<U>& b) noexcept
+{
+  return a.pool() != b.pool();
+}
+
+}  // namespace ice
@@ -0,0 +1,301 @@
+#include <ice/resample.h>
+#include <ice/exception.h>
+#include <ice/jobs.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define ICE_RESAMPLE_SIMD 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#include <smmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace ice {
+namespace {
+
+constexpr double pi = 3.14159265358979323846;
+
+double mitchell(double x) noexcept
+{
+  constexpr double b = 1.0 / 3.0;
+  constexpr double c = 1.0 / 3.0;
+  x = std::abs(x);
+  if (x < 1.0) {
+    return ((12.0 - 9.0 * b - 6.0 * c) * x * x * x + (-18.0 + 12.0 * b + 6.0 * c) * x * x + (6.0 - 2.0 * b)) / 6.0;
+  }
+  if (x < 2.0) {
+    return ((-b - 6.0 * c) * x * x * x + (6.0 * b + 30.0 * c) * x * x + (-12.0 * b - 48.0 * c) * x +
+      (8.0 * b + 24.0 * c)) / 6.0;
+  }
+  return 0.0;
+}
+
+double lanczos3(double x) noexcept
+{
+  x = std::abs(x);
+  if (x < 1e-8) {
+    return 1.0;
+  }
+  if (x < 3.0) {
+    return 3.0 * std::sin(pi * x) * std::sin(pi * x / 3.0) / (pi * pi * x * x);
+  }
+  return 0.0;
+}
+
+std::uint8_t to_byte(float value) noexcept
+{
+  return static_cast<std::uint8_t>(std::lrint(std::min(std::max(value, 0.0f), 255.0f)));
+}
+
+#ifdef ICE_RESAMPLE_SIMD
+
+#ifdef __GNUC__
+#define ICE_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define ICE_TARGET_AVX2 __attribute__((target("avx2")))
+#define ICE_TARGET_XSAVE __attribute__((target("xsave")))
+#else
+#define ICE_TARGET_SSE41
+#define ICE_TARGET_AVX2
+#define ICE_TARGET_XSAVE
+#endif
+
+void cpuid(int leaf, unsigned* info)
+{
+#ifdef _MSC_VER
+  int values[4] = {};
+  __cpuidex(values, leaf, 0);
+  for (auto i = 0; i < 4; i++) {
+    info[i] = static_cast<unsigned>(values[i]);
+  }
+#else
+  if (!__get_cpuid_count(static_cast<unsigned>(leaf), 0, &info[0], &info[1], &info[2], &info[3])) {
+    info[0] = info[1] = info[2] = info[3] = 0;
+  }
+#endif
+}
+
+bool has_sse41()
+{
+  unsigned info[4] = {};
+  cpuid(1, info);
+  return (info[2] & (1 << 19)) != 0;
+}
+
+// AVX2 requires the operating system to save the AVX state.
+ICE_TARGET_XSAVE bool has_avx2()
+{
+  unsigned info[4] = {};
+  cpuid(1, info);
+  const auto features = (1u << 27) | (1u << 28);  // OSXSAVE and AVX
+  if ((info[2] & features) != features || (_xgetbv(0) & 6) != 6) {
+    return false;
+  }
+  cpuid(7, info);
+  return (info[1] & (1 << 5)) != 0;
+}
+
+// Filters a row of four channel pixels with one vector per pixel.
+ICE_TARGET_SSE41 void filter_row_sse41(const std::uint8_t* src, float* dst, std::size_t cx,
+  const std::size_t* first, const float* weights, std::size_t taps) noexcept
+{
+  for (std::size_t x = 0; x < cx; x++, weights += taps) {
+    const auto pixels = src + first[x] * 4;
+    auto sum = _mm_setzero_ps();
+    for (std::size_t k = 0; k < taps; k++) {
+      std::int32_t pixel = 0;
+      std::memcpy(&pixel, pixels + k * 4, sizeof(pixel));
+      const auto value = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(pixel)));
+      sum = _mm_add_ps(sum, _mm_mul_ps(value, _mm_set1_ps(weights[k])));
+    }
+    _mm_storeu_ps(dst + x * 4, sum);
+  }
+}
+
+// Filters eight values of a row at once and converts them to bytes.
+ICE_TARGET_AVX2 void filter_column_avx2(const float* const* rows, const float* weights, std::size_t taps,
+  std::uint8_t* dst, std::size_t size) noexcept
+{
+  const auto zero = _mm256_setzero_ps();
+  const auto max = _mm256_set1_ps(255.0f);
+  std::size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    auto sum = _mm256_setzero_ps();
+    for (std::size_t k = 0; k < taps; k++) {
+      sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(rows[k] + i), _mm256_set1_ps(weights[k])));
+    }
+    const auto value = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(sum, zero), max));
+    const auto words = _mm_packs_epi32(_mm256_castsi256_si128(value), _mm256_extracti128_si256(value, 1));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(words, words));
+  }
+  for (; i < size; i++) {
+    auto sum = 0.0f;
+    for (std::size_t k = 0; k < taps; k++) {
+      sum += rows[k][i] * weights[k];
+    }
+    dst[i] = to_byte(sum);
+  }
+}
+
+// Filters four values of a row at once and converts them to bytes.
+void filter_column_sse2(const float* const* rows, const float* weights, std::size_t taps,
+  std::uint8_t* dst, std::size_t size) noexcept
+{
+  const auto zero = _mm_setzero_ps();
+  const auto max = _mm_set1_ps(255.0f);
+  std::size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    auto sum = _mm_setzero_ps();
+    for (std::size_t k = 0; k < taps; k++) {
+      sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(rows[k] + i), _mm_set1_ps(weights[k])));
+    }
+    const auto value = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(sum, zero), max));
+    const auto words = _mm_packs_epi32(value, value);
+    const auto bytes = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+    std::memcpy(dst + i, &bytes, sizeof(bytes));
+  }
+  for (; i < size; i++) {
+    auto sum = 0.0f;
+    for (std::size_t k = 0; k < taps; k++) {
+      sum += rows[k][i] * weights[k];
+    }
+    dst[i] = to_byte(sum);
+  }
+}
+
+#endif
+
+}  // namespace
+
+resampler::resampler(std::size_t src_cx, std::size_t src_cy, std::size_t cx, std::size_t cy, std::size_t channels,
+  resample_filter filter) :
+  src_cx_(src_cx), src_cy_(src_cy), cx_(cx), cy_(cy), channels_(channels)
+{
+  if (!src_cx || !src_cy || !cx || !cy || channels < 1 || channels > 4) {
+    throw ice::runtime_error("Invalid resampler size.")
+      << "Source: " << src_cx << 'x' << src_cy << "\nTarget: " << cx << 'x' << cy << "\nChannels: " << channels;
+  }
+  x_ = make_axis(src_cx, cx, filter);
+  y_ = make_axis(src_cy, cy, filter);
+}
+
+void resampler::run(const std::uint8_t* src, std::size_t src_stride, std::uint8_t* dst, std::size_t dst_stride,
+  ice::jobs* jobs) const
+{
+  std::vector<float> buffer(cx_ * channels_ * src_cy_);
+  if (jobs) {
+    jobs->parallel_for(0, src_cy_, [&](std::size_t begin, std::size_t end) {
+      filter_rows(src, src_stride, buffer.data(), begin, end);
+    });
+    jobs->parallel_for(0, cy_, [&](std::size_t begin, std::size_t end) {
+      filter_columns(buffer.data(), dst, dst_stride, begin, end);
+    });
+  } else {
+    filter_rows(src, src_stride, buffer.data(), 0, src_cy_);
+    filter_columns(buffer.data(), dst, dst_stride, 0, cy_);
+  }
+}
+
+// Pixel centers are at half integers. When downscaling, the filter is widened by the scale factor so that
+// every source pixel contributes. Source pixels outside of the image are clamped to the edge.
+resampler::axis resampler::make_axis(std::size_t src, std::size_t dst, resample_filter filter)
+{
+  const auto kernel = filter == resample_filter::mitchell ? mitchell : lanczos3;
+  const auto support = filter == resample_filter::mitchell ? 2.0 : 3.0;
+  const auto ratio = static_cast<double>(src) / static_cast<double>(dst);
+  const auto scale = std::max(ratio, 1.0);
+  const auto radius = support * scale;
+
+  axis axis;
+  axis.taps = std::min(src, static_cast<std::size_t>(std::ceil(radius * 2.0)) + 1);
+  axis.first.resize(dst);
+  axis.weights.resize(dst * axis.taps, 0.0f);
+  std::vector<double> weights(axis.taps);
+  for (std::size_t x = 0; x < dst; x++) {
+    const auto center = (static_cast<double>(x) + 0.5) * ratio;
+    const auto begin = static_cast<std::ptrdiff_t>(std::ceil(center - 0.5 - radius));
+    const auto end = static_cast<std::ptrdiff_t>(std::floor(center - 0.5 + radius));
+    const auto last = static_cast<std::ptrdiff_t>(src - 1);
+    const auto first = std::min(std::max(begin, std::ptrdiff_t(0)), static_cast<std::ptrdiff_t>(src - axis.taps));
+    std::fill(weights.begin(), weights.end(), 0.0);
+    auto sum = 0.0;
+    for (auto i = begin; i <= end; i++) {
+      const auto weight = kernel((static_cast<double>(i) + 0.5 - center) / scale);
+      weights[static_cast<std::size_t>(std::min(std::max(i, std::ptrdiff_t(0)), last) - first)] += weight;
+      sum += weight;
+    }
+    axis.first[x] = static_cast<std::size_t>(first);
+    for (std::size_t k = 0; k < axis.taps; k++) {
+      axis.weights[x * axis.taps + k] = static_cast<float>(sum != 0.0 ? weights[k] / sum : 0.0);
+    }
+  }
+  return axis;
+}
+
+void resampler::filter_rows(const std::uint8_t* src, std::size_t src_stride, float* buffer, std::size_t begin,
+  std::size_t end) const
+{
+#ifdef ICE_RESAMPLE_SIMD
+  static const auto sse41 = has_sse41();
+  if (sse41 && channels_ == 4) {
+    for (auto y = begin; y < end; y++) {
+      filter_row_sse41(src + src_stride * y, buffer + cx_ * 4 * y, cx_, x_.first.data(), x_.weights.data(), x_.taps);
+    }
+    return;
+  }
+#endif
+  for (auto y = begin; y < end; y++) {
+    const auto row = src + src_stride * y;
+    auto dst = buffer + cx_ * channels_ * y;
+    for (std::size_t x = 0; x < cx_; x++) {
+      const auto pixels = row + x_.first[x] * channels_;
+      const auto weights = &x_.weights[x * x_.taps];
+      for (std::size_t c = 0; c < channels_; c++) {
+        auto sum = 0.0f;
+        for (std::size_t k = 0; k < x_.taps; k++) {
+          sum += pixels[k * channels_ + c] * weights[k];
+        }
+        *dst++ = sum;
+      }
+    }
+  }
+}
+
+void resampler::filter_columns(const float* buffer, std::uint8_t* dst, std::size_t dst_stride, std::size_t begin,
+  std::size_t end) const
+{
+#ifdef ICE_RESAMPLE_SIMD
+  static const auto avx2 = has_avx2();
+#endif
+  const auto size = cx_ * channels_;
+  std::vector<const float*> rows(y_.taps);
+  for (auto y = begin; y < end; y++) {
+    for (std::size_t k = 0; k < y_.taps; k++) {
+      rows[k] = buffer + size * (y_.first[y] + k);
+    }
+    const auto weights = &y_.weights[y * y_.taps];
+    const auto row = dst + dst_stride * y;
+#ifdef ICE_RESAMPLE_SIMD
+    if (avx2) {
+      filter_column_avx2(rows.data(), weights, y_.taps, row, size);
+    } else {
+      filter_column_sse2(rows.data(), weights, y_.taps, row, size);
+    }
+#else
+    for (std::size_t i = 0; i < size; i++) {
+      auto sum = 0.0f;
+      for (std::size_t k = 0; k < y_.taps; k++) {
+        sum += rows[k][i] * weights[k];
+      }
+      row[i] = to_byte(sum);
+    }
+#endif
+  }
+}
+
+}  // namespace ice
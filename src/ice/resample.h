@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace ice {
+
+class jobs;
+
+enum class resample_filter {
+  mitchell,  // Mitchell-Netravali cubic (B = C = 1/3), soft with little ringing
+  lanczos3,  // three lobe Lanczos window, sharp with some ringing
+};
+
+// Separable resampler for 8 bit images with 1 to 4 interleaved channels.
+// The filter weights for both axes are computed once. Every run filters the source rows horizontally
+// into a float buffer and then filters the buffer vertically; both passes are split into bands of rows
+// on the job scheduler. Four channel rows are filtered horizontally with SSE4.1 and all rows vertically
+// with AVX2 or SSE2, depending on the CPU. Color channels should be premultiplied with alpha.
+class resampler {
+public:
+  resampler(std::size_t src_cx, std::size_t src_cy, std::size_t cx, std::size_t cy, std::size_t channels,
+    resample_filter filter = resample_filter::lanczos3);
+
+  // Resamples the source image into the target image. Thread safe.
+  // Without a job scheduler the passes run on the calling thread.
+  void run(const std::uint8_t* src, std::size_t src_stride, std::uint8_t* dst, std::size_t dst_stride,
+    ice::jobs* jobs = nullptr) const;
+
+private:
+  // Weights of one axis. Every target pixel has the same number of taps, starting at its first source pixel.
+  struct axis {
+    std::vector<std::size_t> first;
+    std::vector<float> weights;
+    std::size_t taps = 0;
+  };
+
+  static axis make_axis(std::size_t src, std::size_t dst, resample_filter filter);
+
+  void filter_rows(const std::uint8_t* src, std::size_t src_stride, float* buffer, std::size_t begin,
+    std::size_t end) const;
+
+  void filter_columns(const float* buffer, std::uint8_t* dst, std::size_t dst_stride, std::size_t begin,
+    std::size_t end) const;
+
+  std::size_t src_cx_ = 0;
+  std::size_t src_cy_ = 0;
+  std::size_t cx_ = 0;
+  std::size_t cy_ = 0;
+  std::size_t channels_ = 0;
+  axis x_;
+  axis y_;
+};
+
+}  // namespace ice
@@ -0,0 +1,299 @@
+#include <ice/scene.h>
+#include <ice/exception.h>
+#include <algorithm>
+#include <array>
+
+namespace ice {
+namespace {
+
+// Minimum number of entities per parallel transform update.
+constexpr std::size_t grain = 1024;
+
+}  // namespace
+
+constexpr scene::entity scene::none;
+
+std::uint64_t render_queue::make_key(std::uint8_t layer, std::uint16_t material, std::uint16_t mesh, float depth) noexcept
+{
+  constexpr auto depth_max = (1u << 24) - 1;
+  const auto clamped = std::min(std::max(depth, 0.0f), 1.0f);
+  const auto quantized = static_cast<std::uint32_t>(clamped * depth_max);
+  return
+    (static_cast<std::uint64_t>(layer) << 56) |
+    (static_cast<std::uint64_t>(material) << 40) |
+    (static_cast<std::uint64_t>(mesh) << 24) |
+    static_cast<std::uint64_t>(quantized);
+}
+
+void render_queue::sort()
+{
+  const auto size = items_.size();
+  if (size < 2) {
+    return;
+  }
+
+  // Count all digits in a single pass.
+  std::array<std::array<std::size_t, 256>, 8> counts = {};
+  for (const auto& item : items_) {
+    for (auto i = 0; i < 8; i++) {
+      counts[i][(item.key >> (i * 8)) & 0xFF]++;
+    }
+  }
+
+  // Distribute the items by every digit that is not the same for all items.
+  temp_.resize(size);
+  for (auto i = 0; i < 8; i++) {
+    auto& count = counts[i];
+    const auto shift = i * 8;
+    if (count[(items_.front().key >> shift) & 0xFF] == size) {
+      continue;
+    }
+    std::size_t offset = 0;
+    for (auto& value : count) {
+      const auto next = offset + value;
+      value = offset;
+      offset = next;
+    }
+    for (const auto& item : items_) {
+      temp_[count[(item.key >> shift) & 0xFF]++] = item;
+    }
+    items_.swap(temp_);
+  }
+}
+
+scene::scene(ice::jobs* jobs, float margin) : jobs_(jobs), bvh_(margin)
+{}
+
+scene::entity scene::create(entity parent)
+{
+  if (parent != none) {
+    check(parent);
+  }
+
+  // Reuse a destroyed entity or grow the component arrays.
+  entity entity = 0;
+  if (free_.empty()) {
+    entity = static_cast<scene::entity>(alive_.size());
+    parent_.push_back(none);
+    first_child_.push_back(none);
+    next_sibling_.push_back(none);
+    level_.push_back(0);
+    slot_.push_back(0);
+    local_x_.push_back(0.0f);
+    local_y_.push_back(0.0f);
+    local_z_.push_back(0.0f);
+    local_scale_.push_back(1.0f);
+    world_x_.push_back(0.0f);
+    world_y_.push_back(0.0f);
+    world_z_.push_back(0.0f);
+    world_scale_.push_back(1.0f);
+    radius_.push_back(0.0f);
+    mesh_.push_back(0);
+    material_.push_back(0);
+    proxy_.push_back(bvh::null);
+    drawable_.push_back(0);
+    alive_.push_back(0);
+    dirty_.push_back(0);
+    moved_.push_back(0);
+  } else {
+    entity = free_.back();
+    free_.pop_back();
+    local_x_[entity] = 0.0f;
+    local_y_[entity] = 0.0f;
+    local_z_[entity] = 0.0f;
+    local_scale_[entity] = 1.0f;
+    radius_[entity] = 0.0f;
+    mesh_[entity] = 0;
+    material_[entity] = 0;
+    proxy_[entity] = bvh::null;
+    drawable_[entity] = 0;
+  }
+
+  // Link the entity to the parent.
+  parent_[entity] = parent;
+  first_child_[entity] = none;
+  next_sibling_[entity] = none;
+  if (parent != none) {
+    next_sibling_[entity] = first_child_[parent];
+    first_child_[parent] = entity;
+  }
+
+  // Add the entity to its hierarchy level.
+  const auto level = parent == none ? 0 : level_[parent] + 1;
+  if (levels_.size() <= level) {
+    levels_.resize(level + 1);
+  }
+  level_[entity] = level;
+  slot_[entity] = static_cast<std::uint32_t>(levels_[level].size());
+  levels_[level].push_back(entity);
+
+  alive_[entity] = 1;
+  dirty_[entity] = 1;
+  moved_[entity] = 0;
+  changed_ = true;
+  size_++;
+  return entity;
+}
+
+void scene::destroy(entity entity)
+{
+  check(entity);
+
+  // Unlink the entity from the parent.
+  const auto parent = parent_[entity];
+  if (parent != none) {
+    if (first_child_[parent] == entity) {
+      first_child_[parent] = next_sibling_[entity];
+    } else {
+      auto sibling = first_child_[parent];
+      while (next_sibling_[sibling] != entity) {
+        sibling = next_sibling_[sibling];
+      }
+      next_sibling_[sibling] = next_sibling_[entity];
+    }
+  }
+
+  // Destroy the entity and its descendants.
+  std::vector<scene::entity> stack{ entity };
+  while (!stack.empty()) {
+    const auto current = stack.back();
+    stack.pop_back();
+    for (auto child = first_child_[current]; child != none; child = next_sibling_[child]) {
+      stack.push_back(child);
+    }
+    if (proxy_[current] != bvh::null) {
+      bvh_.remove(proxy_[current]);
+      proxy_[current] = bvh::null;
+    }
+    auto& level = levels_[level_[current]];
+    const auto last = level.back();
+    level[slot_[current]] = last;
+    slot_[last] = slot_[current];
+    level.pop_back();
+    drawable_[current] = 0;
+    alive_[current] = 0;
+    dirty_[current] = 0;
+    moved_[current] = 0;
+    free_.push_back(current);
+    size_--;
+  }
+}
+
+void scene::position(entity entity, float x, float y, float z)
+{
+  check(entity);
+  local_x_[entity] = x;
+  local_y_[entity] = y;
+  local_z_[entity] = z;
+  dirty_[entity] = 1;
+  changed_ = true;
+}
+
+void scene::scale(entity entity, float scale)
+{
+  check(entity);
+  local_scale_[entity] = scale;
+  dirty_[entity] = 1;
+  changed_ = true;
+}
+
+void scene::mesh(entity entity, std::uint16_t mesh, std::uint16_t material, float radius)
+{
+  check(entity);
+  mesh_[entity] = mesh;
+  material_[entity] = material;
+  radius_[entity] = radius;
+  drawable_[entity] = 1;
+
+  // Insert the bounds after the world transform is known.
+  dirty_[entity] = 1;
+  changed_ = true;
+}
+
+void scene::update()
+{
+  if (!changed_) {
+    return;
+  }
+  changed_ = false;
+
+  // Propagate the transforms level by level. Every entity only reads the world transform of its parent,
+  // which was written by the previous level.
+  for (const auto& level : levels_) {
+    const auto update = [&](std::size_t begin, std::size_t end) {
+      for (auto i = begin; i < end; i++) {
+        const auto entity = level[i];
+        const auto parent = parent_[entity];
+        if (!dirty_[entity] && (parent == none || !moved_[parent])) {
+          moved_[entity] = 0;
+          continue;
+        }
+        if (parent == none) {
+          world_x_[entity] = local_x_[entity];
+          world_y_[entity] = local_y_[entity];
+          world_z_[entity] = local_z_[entity];
+          world_scale_[entity] = local_scale_[entity];
+        } else {
+          const auto scale = world_scale_[parent];
+          world_x_[entity] = world_x_[parent] + scale * local_x_[entity];
+          world_y_[entity] = world_y_[parent] + scale * local_y_[entity];
+          world_z_[entity] = world_z_[parent] + scale * local_z_[entity];
+          world_scale_[entity] = scale * local_scale_[entity];
+        }
+        dirty_[entity] = 0;
+        moved_[entity] = 1;
+      }
+    };
+    if (jobs_ && level.size() > grain) {
+      jobs_->parallel_for(0, level.size(), update, grain);
+    } else {
+      update(0, level.size());
+    }
+  }
+
+  // Insert or update the culling bounds of moved meshes.
+  for (std::size_t i = 0, size = moved_.size(); i < size; i++) {
+    if (!moved_[i] || !drawable_[i]) {
+      continue;
+    }
+    const auto entity = static_cast<scene::entity>(i);
+    if (proxy_[entity] == bvh::null) {
+      proxy_[entity] = bvh_.insert(bounds(entity), entity);
+    } else {
+      bvh_.move(proxy_[entity], bounds(entity));
+    }
+  }
+}
+
+void scene::cull(const float* view_projection, render_queue& queue) const
+{
+  const auto m = view_projection;
+  bvh_.query(frustum::from_matrix(m), [&](std::uint32_t entity) {
+    // Sort by the normalized device depth of the origin.
+    const auto x = world_x_[entity];
+    const auto y = world_y_[entity];
+    const auto z = world_z_[entity];
+    const auto cz = m[2] * x + m[6] * y + m[10] * z + m[14];
+    const auto cw = m[3] * x + m[7] * y + m[11] * z + m[15];
+    const auto depth = cw > 0.0f ? cz / cw * 0.5f + 0.5f : 0.0f;
+    queue.push(render_queue::make_key(0, material_[entity], mesh_[entity], depth), entity);
+  });
+}
+
+void scene::check(entity entity) const
+{
+  if (entity >= alive_.size() || !alive_[entity]) {
+    throw ice::runtime_error("Invalid scene entity.") << entity;
+  }
+}
+
+aabb scene::bounds(entity entity) const noexcept
+{
+  const auto r = radius_[entity] * world_scale_[entity];
+  return{
+    { world_x_[entity] - r, world_y_[entity] - r, world_z_[entity] - r },
+    { world_x_[entity] + r, world_y_[entity] + r, world_z_[entity] + r },
+  };
+}
+
+}  // namespace ice
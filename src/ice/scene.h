@@ -0,0 +1,149 @@
+#pragma once
+#include <ice/bvh.h>
+#include <ice/jobs.h>
+#include <vector>
+#include <cstdint>
+
+namespace ice {
+
+// List of draws sorted by a 64 bit key.
+class render_queue {
+public:
+  struct item {
+    std::uint64_t key;
+    std::uint32_t entity;
+  };
+
+  // Creates a sort key that orders draws by layer, material and mesh to minimize state changes
+  // and front to back by the normalized depth in [0, 1] within a mesh.
+  // Bits: layer (63-56), material (55-40), mesh (39-24), depth (23-0).
+  static std::uint64_t make_key(std::uint8_t layer, std::uint16_t material, std::uint16_t mesh, float depth) noexcept;
+
+  void clear() noexcept
+  {
+    items_.clear();
+  }
+
+  void push(std::uint64_t key, std::uint32_t entity)
+  {
+    items_.push_back({ key, entity });
+  }
+
+  // Sorts the items by key with a stable LSD radix sort. Bytes that are equal for all keys are skipped.
+  void sort();
+
+  const std::vector<item>& items() const noexcept
+  {
+    return items_;
+  }
+
+private:
+  std::vector<item> items_;
+  std::vector<item> temp_;
+};
+
+// Scene graph with structure of arrays component storage.
+// Entities are indices into the component arrays and are reused after they are destroyed. World transforms
+// are propagated one hierarchy level at a time; entities of the same level are updated in parallel.
+// Entities with a mesh are kept in a bounding volume hierarchy for frustum culling.
+class scene {
+public:
+  using entity = std::uint32_t;
+
+  static constexpr entity none = 0xFFFFFFFF;
+
+  // Translation and uniform scale.
+  struct transform {
+    float x;
+    float y;
+    float z;
+    float scale;
+  };
+
+  // Creates a scene that propagates transforms with the given scheduler or on the calling thread.
+  // The margin enlarges the culling bounds of meshes so that small movements do not update the hierarchy.
+  explicit scene(ice::jobs* jobs = nullptr, float margin = 0.1f);
+
+  scene(scene&& other) = delete;
+  scene(const scene& other) = delete;
+
+  scene& operator=(scene&& other) = delete;
+  scene& operator=(const scene& other) = delete;
+
+  // Creates an entity with an identity transform relative to the parent.
+  entity create(entity parent = none);
+
+  // Destroys an entity and all its descendants.
+  void destroy(entity entity);
+
+  // Sets the local position and scale.
+  void position(entity entity, float x, float y, float z);
+  void scale(entity entity, float scale);
+
+  // Attaches a mesh with the given bounding sphere radius in model units.
+  // The mesh is culled after the next update.
+  void mesh(entity entity, std::uint16_t mesh, std::uint16_t material, float radius);
+
+  // Returns the world transform as of the last update.
+  transform world(entity entity) const noexcept
+  {
+    return{ world_x_[entity], world_y_[entity], world_z_[entity], world_scale_[entity] };
+  }
+
+  // Returns the number of entities.
+  std::size_t size() const noexcept
+  {
+    return size_;
+  }
+
+  // Propagates the changed transforms and updates the culling bounds.
+  void update();
+
+  // Adds the meshes that intersect the frustum of the column major view projection matrix to the queue.
+  // Does not clear or sort the queue.
+  void cull(const float* view_projection, render_queue& queue) const;
+
+private:
+  void check(entity entity) const;
+  aabb bounds(entity entity) const noexcept;
+
+  ice::jobs* jobs_ = nullptr;
+  ice::bvh bvh_;
+
+  // Hierarchy.
+  std::vector<entity> parent_;
+  std::vector<entity> first_child_;
+  std::vector<entity> next_sibling_;
+  std::vector<std::uint32_t> level_;
+  std::vector<std::uint32_t> slot_;
+  std::vector<std::vector<entity>> levels_;
+
+  // Local transforms.
+  std::vector<float> local_x_;
+  std::vector<float> local_y_;
+  std::vector<float> local_z_;
+  std::vector<float> local_scale_;
+
+  // World transforms.
+  std::vector<float> world_x_;
+  std::vector<float> world_y_;
+  std::vector<float> world_z_;
+  std::vector<float> world_scale_;
+
+  // Meshes.
+  std::vector<float> radius_;
+  std::vector<std::uint16_t> mesh_;
+  std::vector<std::uint16_t> material_;
+  std::vector<std::uint32_t> proxy_;
+  std::vector<std::uint8_t> drawable_;
+
+  // State.
+  std::vector<std::uint8_t> alive_;
+  std::vector<std::uint8_t> dirty_;  // local transform changed
+  std::vector<std::uint8_t> moved_;  // world transform changed in the last update
+  std::vector<entity> free_;
+  std::size_t size_ = 0;
+  bool changed_ = false;
+};
+
+}  // namespace ice
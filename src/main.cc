@@ -1,12 +1,45 @@
+#include "headless.h"
 #include "window.h"
+#include <ice/archive.h>
 #include <windows.h>
 #include <shellapi.h>
 #include <resource.h>
+#include <algorithm>
 #include <codecvt>
+#include <iostream>
 #include <locale>
 #include <string>
 #include <vector>
 #include <clocale>
+#include <cstdio>
+
+namespace {
+
+// Connects the standard output streams to the console of the parent process or to a new console.
+// The application uses the Windows subsystem and starts without a console. Redirected streams are kept.
+void attach_console()
+{
+  const auto redirected = [](DWORD handle) {
+    const auto type = GetFileType(GetStdHandle(handle));
+    return type == FILE_TYPE_DISK || type == FILE_TYPE_PIPE;
+  };
+  const auto out = redirected(STD_OUTPUT_HANDLE);
+  const auto err = redirected(STD_ERROR_HANDLE);
+  if ((out && err) || (!AttachConsole(ATTACH_PARENT_PROCESS) && !AllocConsole())) {
+    return;
+  }
+  FILE* file = nullptr;
+  if (!out) {
+    freopen_s(&file, "CONOUT$", "w", stdout);
+    std::cout.clear();
+  }
+  if (!err) {
+    freopen_s(&file, "CONOUT$", "w", stderr);
+    std::cerr.clear();
+  }
+}
+
+}  // namespace
 
 int main(int argc, char* argv[])
 {
@@ -26,20 +59,16 @@ int main(int argc, char* argv[])
     return 1;
   }
 
-  // Check if another instance of this application is already running.
-  auto event = CreateEvent(NULL, TRUE, FALSE, TEXT(PRODUCT));
-  if (event && GetLastError() == ERROR_ALREADY_EXISTS) {
-    if (auto hwnd = FindWindow(TEXT(PRODUCT), nullptr)) {
-      SetForegroundWindow(hwnd);
-      return 0;
-    }
-    MessageBox(nullptr, L"This application is already running.", TEXT(PROJECT" Error"), MB_OK | MB_ICONASTERISK | MB_SETFOREGROUND);
-    return 0;
-  }
-
   // Parse the command line arguments.
   auto samples = 8;
   auto fullscreen = false;
+  auto retained = false;
+  auto frames = 0;
+  auto objects = 1;
+  auto cx = 1280;
+  auto cy = 720;
+  std::string dump;
+  std::string trace;
   for (int i = 0; i < argc; i++) {
     if (argv[i] == std::string("-s") && i + 1 < argc) {
       samples = std::atoi(argv[++i]);
@@ -49,11 +78,89 @@ int main(int argc, char* argv[])
       fullscreen = true;
       continue;
     }
+    if (argv[i] == std::string("-d")) {
+      retained = true;
+      continue;
+    }
+    if (argv[i] == std::string("-b") && i + 1 < argc) {
+      frames = std::atoi(argv[++i]);
+      continue;
+    }
+    if (argv[i] == std::string("-r") && i + 1 < argc) {
+      std::sscanf(argv[++i], "%dx%d", &cx, &cy);
+      continue;
+    }
+    if (argv[i] == std::string("-o") && i + 1 < argc) {
+      dump = argv[++i];
+      continue;
+    }
+    if (argv[i] == std::string("-n") && i + 1 < argc) {
+      objects = std::max(std::atoi(argv[++i]), 1);
+      continue;
+    }
+    if (argv[i] == std::string("-t") && i + 1 < argc) {
+      trace = argv[++i];
+      continue;
+    }
+  }
+
+  // Record the first access of every data file to order the data pack.
+  if (!trace.empty()) {
+    try {
+      ice::archive::trace(std::filesystem::path(trace));
+    }
+    catch (const ice::exception& e) {
+      attach_console();
+      std::cerr << e.what() << std::endl;
+      if (auto info = e.info()) {
+        std::cerr << info << std::endl;
+      }
+      return 1;
+    }
+  }
+
+  // Render the given number of frames without a window and report the throughput.
+  if (frames > 0) {
+    attach_console();
+    try {
+      headless headless(window::data(), cx, cy, samples, static_cast<std::size_t>(objects));
+      auto stats = headless.run(static_cast<std::size_t>(frames), std::filesystem::path(dump));
+      std::cout << "frames: " << stats.frames << '\n'
+                << "time: " << stats.time.count() << " s\n"
+                << "fps: " << stats.frames / stats.time.count() << '\n'
+                << "cpu: " << stats.cpu.count() * 1000.0 / stats.frames << " ms/frame" << std::endl;
+      if (!dump.empty()) {
+        std::cout << "capture stalls: " << stats.stalls << std::endl;
+      }
+    }
+    catch (const ice::exception& e) {
+      std::cerr << e.what() << std::endl;
+      if (auto info = e.info()) {
+        std::cerr << info << std::endl;
+      }
+      return 1;
+    }
+    catch (const std::exception& e) {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  // Check if another instance of this application is already running.
+  auto event = CreateEvent(NULL, TRUE, FALSE, TEXT(PRODUCT));
+  if (event && GetLastError() == ERROR_ALREADY_EXISTS) {
+    if (auto hwnd = FindWindow(TEXT(PRODUCT), nullptr)) {
+      SetForegroundWindow(hwnd);
+      return 0;
+    }
+    MessageBox(nullptr, L"This application is already running.", TEXT(PROJECT" Error"), MB_OK | MB_ICONASTERISK | MB_SETFOREGROUND);
+    return 0;
   }
 
   // Create the main application window.
   window window;
-  window.create(samples, fullscreen);
+  window.create(samples, fullscreen, retained, static_cast<std::size_t>(objects));
 
   // Run the main message loop.
   MSG msg = {};
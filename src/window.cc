@@ -7,9 +7,17 @@
 #include <debug>
 #include <exception>
 #include <string>
+#include <vector>
 
 namespace {
 
+// Delay after the last size change before render targets are reallocated.
+constexpr UINT_PTR settle_timer = 1;
+constexpr UINT settle_delay = 200;
+
+// Message posted when the client reports damage in retained mode.
+constexpr UINT WM_DAMAGE = WM_APP + 1;
+
 std::filesystem::path application_path()
 {
   DWORD size = 0;
@@ -24,11 +32,21 @@ std::filesystem::path application_path()
 
 }  // namespace
 
-void window::create(int samples, bool fullscreen)
+std::filesystem::path window::data()
+{
+  if (IsDebuggerPresent()) {
+    return std::filesystem::canonical("../res/data");
+  }
+  return application_path() / "data.pak";
+}
+
+void window::create(int samples, bool fullscreen, bool retained, std::size_t objects)
 {
   // Store the settings.
   samples_ = samples;
   fullscreen_ = fullscreen;
+  retained_ = retained;
+  objects_ = objects;
 
   // Get the module instance.
   auto instance = GetModuleHandle(nullptr);
@@ -169,6 +187,19 @@ void window::on_create()
     throw ice::runtime_error("Could not attach the OpenGL ES 3 context to the display surface.");
   }
 
+  // Check the partial update support for the retained mode.
+  if (retained_) {
+    auto extensions = eglQueryString(display_, EGL_EXTENSIONS);
+    if (gl::has_extension(extensions, "EGL_KHR_swap_buffers_with_damage")) {
+      eglSwapBuffersWithDamage_ = reinterpret_cast<PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC>(
+        eglGetProcAddress("eglSwapBuffersWithDamageKHR"));
+    }
+    buffer_age_ = gl::has_extension(extensions, "EGL_EXT_buffer_age");
+    if (!buffer_age_) {
+      buffer_preserved_ = eglSurfaceAttrib(display_, surface_, EGL_SWAP_BEHAVIOR, EGL_BUFFER_PRESERVED) == EGL_TRUE;
+    }
+  }
+
   // Get the client size.
   RECT rc = {};
   GetClientRect(hwnd_, &rc);
@@ -176,30 +207,34 @@ void window::on_create()
   cy_ = std::max(1L, rc.bottom - rc.top);
 
   // Create render and frame buffers for multisampling support.
+  // Tiled GPUs can keep the samples in tile memory and resolve them implicitly
+  // when EXT_multisampled_render_to_texture is supported.
   if (samples_ > 1) {
-    glGenRenderbuffers(1, &rbo_);
-    glBindRenderbuffer(GL_RENDERBUFFER, rbo_);
-    glRenderbufferStorageMultisampleANGLE(GL_RENDERBUFFER, samples_, GL_BGRA8_EXT, cx_, cy_);
-    if (auto ec = gl::make_error()) {
-      throw ice::runtime_error("Could not create the multisample render buffer.")
-        << ec.message() << "\nSamples: " << samples_;
-    }
-
-    glGenFramebuffers(1, &fbo_);
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, rbo_);
-    if (auto ec = gl::make_error()) {
-      throw ice::runtime_error("Could not create the multisample frame buffer.")
-        << ec.message() << "\nSamples: " << samples_;
+    GLint max_samples = 0;
+    glGetIntegerv(GL_MAX_SAMPLES, &max_samples);
+    samples_ = std::min(samples_, std::max(max_samples, 1));
+    PFNGLFRAMEBUFFERTEXTURE2DMULTISAMPLEEXTPROC render_to_texture = nullptr;
+    if (gl::has_extension("GL_EXT_multisampled_render_to_texture")) {
+      render_to_texture = reinterpret_cast<PFNGLFRAMEBUFFERTEXTURE2DMULTISAMPLEEXTPROC>(
+        eglGetProcAddress("glFramebufferTexture2DMultisampleEXT"));
     }
+    format_ = render_to_texture ? GL_RGBA8 : GL_BGRA8_EXT;
+    targets_ = std::make_unique<gl::target_pool>(256, 60, render_to_texture);
+    reallocate();
   }
+  rx_ = cx_;
+  ry_ = cy_;
+
+  // Create a fence slot for every arena frame.
+  fences_.assign(arena_.frames(), nullptr);
 
   // Create the client.
-  auto path = application_path() / "data.pak";
-  if (IsDebuggerPresent()) {
-    path = std::filesystem::canonical("../res/data");
-  }
-  client_ = std::make_unique<client>(path, cx_, cy_, dpi);
+  client_ = std::make_unique<client>(data(), cx_, cy_, dpi, objects_);
+  client_->on_damage([this]() {
+    if (retained_ && !posted_) {
+      posted_ = PostMessage(hwnd_, WM_DAMAGE, 0, 0) != FALSE;
+    }
+  });
 
   // Show the window.
   ShowWindow(hwnd_, SW_SHOW);
@@ -215,14 +250,19 @@ void window::on_destroy()
   // Destroy the client.
   client_.reset();
 
-  // Destroy render and frame buffers.
-  if (samples_ > 1) {
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glDeleteFramebuffers(1, &fbo_);
-    glBindRenderbuffer(GL_RENDERBUFFER, 0);
-    glDeleteRenderbuffers(1, &rbo_);
+  // Destroy the frame fences.
+  for (auto& fence : fences_) {
+    if (fence) {
+      glDeleteSync(fence);
+      fence = nullptr;
+    }
   }
 
+  // Destroy render and frame buffers.
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  target_ = nullptr;
+  targets_.reset();
+
   // Destroy OpenGL ES 3.0 display, context and surface.
   eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
   eglDestroyContext(display_, context_);
@@ -240,21 +280,73 @@ void window::on_paint()
 {
   // Draw the client.
   if (client_) {
-    if (samples_ > 1) {
+    if (retained_) {
+      // Add the region that the system invalidated and skip unchanged frames.
+      RECT rc = {};
+      if (GetUpdateRect(hwnd_, &rc, FALSE)) {
+        client_->invalidate({ rc.left, cy_ - rc.bottom, rc.right - rc.left, rc.bottom - rc.top });
+      }
+      ValidateRect(hwnd_, nullptr);
+      if (!client_->dirty()) {
+        return;
+      }
+
+      // Partial updates need the previous frame in the back buffer and an unscaled target.
+      if (!preserved() || rx_ != cx_ || ry_ != cy_) {
+        client_->invalidate();
+      }
+    } else {
+      client_->invalidate();
+    }
+
+    // Reuse the oldest arena frame after the GPU finished the frame that used it.
+    fence_ = (fence_ + 1) % fences_.size();
+    if (auto& fence = fences_[fence_]) {
+      glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+      glDeleteSync(fence);
+      fence = nullptr;
+    }
+    arena_.begin();
+
+    // Collect the swap damage before the client clears it.
+    const auto box = client_->bounds();
+    const auto& damage = client_->damage();
+    const auto count = static_cast<EGLint>(damage.size());
+    ice::frame_vector<EGLint> rects(arena_);
+    if (retained_ && eglSwapBuffersWithDamage_) {
+      rects.reserve(damage.size() * 4);
+      for (const auto& region : damage) {
+        rects.insert(rects.end(), { region.x, region.y, region.cx, region.cy });
+      }
+    }
+
+    if (target_) {
       glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
-      glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+      glBindFramebuffer(GL_FRAMEBUFFER, target_->fbo);
     }
 
     client_->render();
 
-    if (samples_ > 1) {
-      glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo_);
-      glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-      glBlitFramebufferANGLE(0, 0, cx_, cy_, 0, 0, cx_, cy_, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    if (target_) {
+      resolve(box.x, box.y, box.cx, box.cy);
     }
 
+    // Discard the surface depth and stencil buffers instead of storing them.
+    const GLenum attachments[] = { GL_DEPTH, GL_STENCIL };
+    glInvalidateFramebuffer(GL_DRAW_FRAMEBUFFER, 2, attachments);
+
     // Post the surface color buffer to the native window.
-    eglSwapBuffers(display_, surface_);
+    if (retained_ && eglSwapBuffersWithDamage_) {
+      eglSwapBuffersWithDamage_(display_, surface_, rects.data(), count);
+    } else {
+      eglSwapBuffers(display_, surface_);
+    }
+    fences_[fence_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    // Recycle unused render targets.
+    if (targets_) {
+      targets_->frame();
+    }
 
     // Update the frame rate.
     if (!fullscreen_) {
@@ -287,11 +379,38 @@ void window::on_size(int cx, int cy)
     cx_ = std::max(1, cx);
     cy_ = std::max(1, cy);
     if (client_) {
-      if (samples_ > 1) {
-        glRenderbufferStorageMultisampleANGLE(GL_RENDERBUFFER, samples_, GL_BGRA8_EXT, cx_, cy_);
+      // Keep the render target while the size changes and render at a reduced
+      // scale when the window no longer fits. The target is reallocated after
+      // the size settled.
+      rx_ = cx_;
+      ry_ = cy_;
+      if (target_) {
+        if (target_->cx < cx_ || target_->cy < cy_) {
+          auto scale = std::min(static_cast<float>(target_->cx) / cx_, static_cast<float>(target_->cy) / cy_);
+          rx_ = std::max(1, static_cast<GLsizei>(cx_ * scale));
+          ry_ = std::max(1, static_cast<GLsizei>(cy_ * scale));
+        }
+        if (target_->cx != targets_->bucket(cx_) || target_->cy != targets_->bucket(cy_)) {
+          SetTimer(hwnd_, settle_timer, settle_delay, nullptr);
+        }
       }
-      client_->resize(cx_, cy_);
-      client_->render();
+      client_->resize(rx_, ry_);
+    }
+  }
+}
+
+void window::on_settle()
+{
+  // Reallocate the render target for the final window size.
+  KillTimer(hwnd_, settle_timer);
+  if (client_ && target_) {
+    if (target_->cx != targets_->bucket(cx_) || target_->cy != targets_->bucket(cy_)) {
+      reallocate();
+    }
+    if (rx_ != cx_ || ry_ != cy_) {
+      rx_ = cx_;
+      ry_ = cy_;
+      client_->resize(rx_, ry_);
     }
   }
 }
@@ -305,6 +424,54 @@ void window::on_dpi(int dpi, LPCRECT rc)
   }
 }
 
+bool window::preserved() const
+{
+  if (buffer_age_) {
+    EGLint age = 0;
+    eglQuerySurface(display_, surface_, EGL_BUFFER_AGE_EXT, &age);
+    return age == 1;
+  }
+  return buffer_preserved_;
+}
+
+void window::reallocate()
+{
+  // Return the current target to the pool, which deletes it when it is not reused.
+  if (target_) {
+    targets_->release(*target_);
+    target_ = nullptr;
+  }
+  target_ = &targets_->acquire(cx_, cy_, format_, samples_);
+}
+
+void window::resolve(GLint x, GLint y, GLsizei cx, GLsizei cy)
+{
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, target_->fbo);
+  if (rx_ == cx_ && ry_ == cy_) {
+    // Copy the region to the window surface.
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebufferANGLE(x, y, x + cx, y + cy, x, y, x + cx, y + cy, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+  } else {
+    // Multisample blits can not scale. Resolve the scaled frame into a transient
+    // target and stretch it to the window surface.
+    const auto& transient = targets_->acquire(rx_, ry_, format_, 1);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, transient.fbo);
+    glBlitFramebufferANGLE(0, 0, rx_, ry_, 0, 0, rx_, ry_, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, transient.fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, rx_, ry_, 0, 0, cx_, cy_, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, target_->fbo);
+    targets_->release(transient);
+  }
+
+  // Discard the samples. The render to texture samples are discarded implicitly
+  // and invalidating the attachment would discard the resolved texture as well.
+  if (target_->rbo) {
+    const GLenum attachments[] = { GL_COLOR_ATTACHMENT0 };
+    glInvalidateFramebuffer(GL_READ_FRAMEBUFFER, 1, attachments);
+  }
+}
+
 LRESULT window::handle(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
 {
   // Handle windows messages.
@@ -324,6 +491,19 @@ LRESULT window::handle(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
     case WM_SIZE:
       on_size(LOWORD(lparam), HIWORD(lparam));
       return 0;
+    case WM_DAMAGE:
+      posted_ = false;
+      on_paint();
+      return 0;
+    case WM_EXITSIZEMOVE:
+      on_settle();
+      return 0;
+    case WM_TIMER:
+      if (wparam == settle_timer) {
+        on_settle();
+        return 0;
+      }
+      break;
     case WM_ERASEBKGND:
       return 1;
     case WM_GETMINMAXINFO:
@@ -1,38 +1,70 @@
 #pragma once
 #include "client.h"
+#include <gl/target.h>
+#include <ice/arena.h>
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
+#include <GLES2/gl2ext.h>
 #include <windows.h>
+#include <filesystem>
 #include <memory>
+#include <vector>
 
 class window {
 public:
-  void create(int samples, bool fullscreen);
+  // Returns the client data path.
+  static std::filesystem::path data();
+
+  // Creates the main application window.
+  // In retained mode frames are only rendered when the client reports damage.
+  void create(int samples, bool fullscreen, bool retained = false, std::size_t objects = 1);
 
   void on_create();
   void on_destroy();
   void on_paint();
   void on_size(int cx, int cy);
+  void on_settle();
   void on_dpi(int dpi, LPCRECT rc);
 
 private:
   LRESULT handle(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam);
 
+  // Returns true if the surface back buffer still holds the previous frame.
+  bool preserved() const;
+
+  // Acquires a render target for the current window size.
+  void reallocate();
+
+  // Resolves a region of the multisample frame buffer into the window surface.
+  void resolve(GLint x, GLint y, GLsizei cx, GLsizei cy);
+
   HWND hwnd_ = nullptr;
   HDC hdc_ = nullptr;
   bool fullscreen_ = false;
+  bool retained_ = false;
+  bool posted_ = false;
+  std::size_t objects_ = 1;
 
   EGLDisplay display_ = EGL_NO_DISPLAY;
   EGLSurface surface_ = EGL_NO_SURFACE;
   EGLContext context_ = EGL_NO_CONTEXT;
+  PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC eglSwapBuffersWithDamage_ = nullptr;
+  bool buffer_age_ = false;
+  bool buffer_preserved_ = false;
 
   GLsizei samples_ = 0;
-  GLuint rbo_ = 0;
-  GLuint fbo_ = 0;
+  GLenum format_ = GL_BGRA8_EXT;
+  std::unique_ptr<gl::target_pool> targets_;
+  const gl::render_target* target_ = nullptr;
   GLsizei cx_ = 1;
   GLsizei cy_ = 1;
+  GLsizei rx_ = 1;  // render size, smaller than the window size until a resize settled
+  GLsizei ry_ = 1;
 
   std::unique_ptr<client> client_;
+  ice::frame_arena arena_;        // transient data of the last two frames
+  std::vector<GLsync> fences_;    // GPU fences of the arena frames, reused in the same order
+  std::size_t fence_ = 0;
   client::clock::time_point time_point_;
   client::clock::duration::rep frames_ = 0;
 };
@@ -0,0 +1,196 @@
+#include <ice/jobs.h>
+#include <ice/resample.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdlib>
+
+namespace {
+
+using clock = std::chrono::high_resolution_clock;
+
+// Simulates a unit of work of about one microsecond.
+float work(std::size_t index)
+{
+  auto value = static_cast<float>(index);
+  for (auto i = 0; i < 64; i++) {
+    value = std::sqrt(value * 1.0001f + 1.0f);
+  }
+  return value;
+}
+
+// Measures a parallel for loop over the given number of elements.
+double parallel_for(ice::jobs& jobs, std::vector<float>& data)
+{
+  const auto start = clock::now();
+  jobs.parallel_for(0, data.size(), [&data](std::size_t begin, std::size_t end) {
+    for (auto i = begin; i < end; i++) {
+      data[i] = work(i);
+    }
+  });
+  return std::chrono::duration<double>(clock::now() - start).count();
+}
+
+// Measures independent jobs with a final job that depends on all of them.
+double fan_out(ice::jobs& jobs, std::size_t count)
+{
+  std::atomic<std::size_t> sum{ 0 };
+  std::vector<ice::jobs::handle> handles;
+  handles.reserve(count);
+  const auto start = clock::now();
+  for (std::size_t i = 0; i < count; i++) {
+    handles.push_back(jobs.run([&sum, i]() {
+      auto value = 0.0f;
+      for (std::size_t j = 0; j < 16; j++) {
+        value += work(i * 16 + j);
+      }
+      sum.fetch_add(value > 0.0f ? 1 : 0, std::memory_order_relaxed);
+    }));
+  }
+  jobs.wait(jobs.run([]() {}, handles));
+  const auto time = std::chrono::duration<double>(clock::now() - start).count();
+  if (sum != count) {
+    throw std::runtime_error("Invalid job result.");
+  }
+  return time;
+}
+
+double lanczos3(double x)
+{
+  const auto pi = 3.14159265358979323846;
+  x = std::abs(x);
+  if (x < 1e-8) {
+    return 1.0;
+  }
+  return x < 3.0 ? 3.0 * std::sin(pi * x) * std::sin(pi * x / 3.0) / (pi * pi * x * x) : 0.0;
+}
+
+// Resamples an RGBA image with a separable Lanczos filter that evaluates the kernel for every tap.
+void resample_naive(const std::vector<std::uint8_t>& src, std::size_t src_cx, std::size_t src_cy,
+  std::vector<std::uint8_t>& dst, std::size_t cx, std::size_t cy)
+{
+  const auto pass = [](const float* src, std::size_t src_size, std::size_t src_step, std::size_t size,
+    float* dst, std::size_t dst_step) {
+    const auto ratio = static_cast<double>(src_size) / static_cast<double>(size);
+    const auto scale = std::max(ratio, 1.0);
+    const auto radius = 3.0 * scale;
+    for (std::size_t x = 0; x < size; x++) {
+      const auto center = (static_cast<double>(x) + 0.5) * ratio;
+      double sum[4] = {};
+      auto total = 0.0;
+      for (auto i = static_cast<long>(std::ceil(center - 0.5 - radius)); i <= static_cast<long>(std::floor(center - 0.5 + radius)); i++) {
+        const auto weight = lanczos3((static_cast<double>(i) + 0.5 - center) / scale);
+        const auto index = static_cast<std::size_t>(std::min(std::max(i, 0L), static_cast<long>(src_size) - 1));
+        for (auto c = 0; c < 4; c++) {
+          sum[c] += src[index * src_step + c] * weight;
+        }
+        total += weight;
+      }
+      for (auto c = 0; c < 4; c++) {
+        dst[x * dst_step + c] = static_cast<float>(sum[c] / total);
+      }
+    }
+  };
+  std::vector<float> input(src.begin(), src.end());
+  std::vector<float> rows(cx * src_cy * 4);
+  std::vector<float> column(cy * 4);
+  for (std::size_t y = 0; y < src_cy; y++) {
+    pass(&input[y * src_cx * 4], src_cx, 4, cx, &rows[y * cx * 4], 4);
+  }
+  for (std::size_t x = 0; x < cx; x++) {
+    pass(&rows[x * 4], src_cy, cx * 4, cy, column.data(), 4);
+    for (std::size_t y = 0; y < cy; y++) {
+      for (auto c = 0; c < 4; c++) {
+        const auto value = std::lrint(std::min(std::max(column[y * 4 + c], 0.0f), 255.0f));
+        dst[(y * cx + x) * 4 + c] = static_cast<std::uint8_t>(value);
+      }
+    }
+  }
+}
+
+// Compares the naive resampler with ice::resampler on one thread and on all threads.
+void resample(std::size_t threads)
+{
+  const std::size_t src_cx = 2048;
+  const std::size_t src_cy = 2048;
+  std::vector<std::uint8_t> src(src_cx * src_cy * 4);
+  for (std::size_t i = 0; i < src.size(); i++) {
+    src[i] = static_cast<std::uint8_t>((i * 7 + i / 8191) & 0xFF);
+  }
+  std::cout << "\nresample       naive    single  speedup  threaded  speedup  max error" << std::endl;
+  for (const auto size : { std::size_t(3072), std::size_t(1536), std::size_t(512) }) {
+    std::vector<std::uint8_t> expected(size * size * 4);
+    std::vector<std::uint8_t> result(size * size * 4);
+    auto start = clock::now();
+    resample_naive(src, src_cx, src_cy, expected, size, size);
+    const auto naive = std::chrono::duration<double>(clock::now() - start).count();
+
+    start = clock::now();
+    const ice::resampler resampler(src_cx, src_cy, size, size, 4);
+    resampler.run(src.data(), src_cx * 4, result.data(), size * 4);
+    const auto single = std::chrono::duration<double>(clock::now() - start).count();
+
+    ice::jobs jobs(threads - 1);
+    start = clock::now();
+    resampler.run(src.data(), src_cx * 4, result.data(), size * 4, &jobs);
+    const auto threaded = std::chrono::duration<double>(clock::now() - start).count();
+
+    auto error = 0;
+    for (std::size_t i = 0; i < result.size(); i++) {
+      error = std::max(error, std::abs(static_cast<int>(result[i]) - static_cast<int>(expected[i])));
+    }
+    std::cout << std::setw(4) << size << 'x' << std::left << std::setw(4) << size << std::right << std::fixed
+              << std::setprecision(1) << std::setw(8) << naive * 1000.0 << " ms"
+              << std::setw(7) << single * 1000.0 << " ms" << std::setw(8) << naive / single << 'x'
+              << std::setw(7) << threaded * 1000.0 << " ms" << std::setw(8) << naive / threaded << 'x'
+              << std::setw(11) << error << std::endl;
+  }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  try {
+    const auto cores = static_cast<std::size_t>(std::max(std::thread::hardware_concurrency(), 1u));
+    const auto threads = argc > 1 ? static_cast<std::size_t>(std::max(std::atoi(argv[1]), 1)) : cores;
+    const std::size_t elements = 1024 * 1024;
+    const std::size_t count = 64 * 1024;
+    std::vector<float> data(elements);
+
+    std::cout << "threads  parallel_for  speedup      jobs/s  speedup" << std::endl;
+    auto base_for = 0.0;
+    auto base_jobs = 0.0;
+    for (std::size_t n = 1; n <= threads; n++) {
+      ice::jobs jobs(n - 1);
+      auto time_for = parallel_for(jobs, data);
+      auto time_jobs = fan_out(jobs, count);
+      for (auto i = 0; i < 2; i++) {
+        time_for = std::min(time_for, parallel_for(jobs, data));
+        time_jobs = std::min(time_jobs, fan_out(jobs, count));
+      }
+      if (n == 1) {
+        base_for = time_for;
+        base_jobs = time_jobs;
+      }
+      std::cout << std::setw(7) << n << std::fixed << std::setprecision(1)
+                << std::setw(11) << time_for * 1000.0 << " ms" << std::setw(8) << base_for / time_for << 'x'
+                << std::setw(12) << std::setprecision(0) << count / time_jobs
+                << std::setw(8) << std::setprecision(1) << base_jobs / time_jobs << 'x' << std::endl;
+    }
+    resample(threads);
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,178 @@
+#include <ice/exception.h>
+#include <ice/mesh.h>
+#include <array>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+namespace {
+
+int usage()
+{
+  std::cerr << "usage: mesh <input.obj> <output.mesh> [lods]" << std::endl;
+  return 2;
+}
+
+// Resolves a one-based or negative (relative) OBJ index.
+std::size_t resolve(long index, std::size_t size, std::size_t line)
+{
+  const auto value = index < 0 ? static_cast<long>(size) + index : index - 1;
+  if (index == 0 || value < 0 || static_cast<std::size_t>(value) >= size) {
+    throw ice::runtime_error("Invalid OBJ index.") << "Line: " << line << "\nIndex: " << index;
+  }
+  return static_cast<std::size_t>(value);
+}
+
+// Reads the triangles of a Wavefront OBJ file. Polygons are triangulated as fans.
+// Vertex colors are read from the "v x y z r g b" extension.
+ice::mesh_source load(const std::filesystem::path& filename)
+{
+  std::ifstream is(filename);
+  if (!is) {
+    throw ice::runtime_error("Could not open file for reading.") << filename.u8string();
+  }
+
+  std::vector<std::array<float, 3>> positions;
+  std::vector<std::array<float, 4>> colors;
+  std::vector<std::array<float, 3>> normals;
+  std::vector<std::array<float, 2>> uvs;
+  std::map<std::array<long, 3>, std::uint32_t> vertices;
+  std::vector<std::array<long, 3>> order;
+  std::vector<std::uint32_t> indices;
+  auto has_color = false;
+  auto has_normal = true;
+  auto has_uv = true;
+
+  std::string line;
+  for (std::size_t number = 1; std::getline(is, line); number++) {
+    std::istringstream ss(line);
+    std::string type;
+    ss >> type;
+    if (type == "v") {
+      std::array<float, 3> p = {};
+      std::array<float, 4> c = { 1.0f, 1.0f, 1.0f, 1.0f };
+      ss >> p[0] >> p[1] >> p[2];
+      if (ss >> c[0] >> c[1] >> c[2]) {
+        has_color = true;
+      }
+      positions.push_back(p);
+      colors.push_back(c);
+    } else if (type == "vn") {
+      std::array<float, 3> n = {};
+      ss >> n[0] >> n[1] >> n[2];
+      normals.push_back(n);
+    } else if (type == "vt") {
+      std::array<float, 2> t = {};
+      ss >> t[0] >> t[1];
+      uvs.push_back(t);
+    } else if (type == "f") {
+      // Parse the v, v/t, v//n and v/t/n references and add every unique combination once.
+      std::vector<std::uint32_t> face;
+      std::string reference;
+      while (ss >> reference) {
+        std::array<long, 3> key = { -1, -1, -1 };
+        std::istringstream rs(reference);
+        std::string part;
+        for (auto i = 0; i < 3 && std::getline(rs, part, '/'); i++) {
+          if (!part.empty()) {
+            const auto size = i == 0 ? positions.size() : i == 1 ? uvs.size() : normals.size();
+            key[i] = static_cast<long>(resolve(std::strtol(part.c_str(), nullptr, 10), size, number));
+          }
+        }
+        if (key[0] < 0) {
+          throw ice::runtime_error("Invalid OBJ face.") << "Line: " << number;
+        }
+        has_uv = has_uv && key[1] >= 0;
+        has_normal = has_normal && key[2] >= 0;
+        const auto result = vertices.emplace(key, static_cast<std::uint32_t>(order.size()));
+        if (result.second) {
+          order.push_back(key);
+        }
+        face.push_back(result.first->second);
+      }
+      for (std::size_t i = 2; i < face.size(); i++) {
+        indices.insert(indices.end(), { face[0], face[i - 1], face[i] });
+      }
+    }
+  }
+
+  ice::mesh_source source;
+  for (const auto& key : order) {
+    source.positions.insert(source.positions.end(), positions[key[0]].begin(), positions[key[0]].end());
+    if (has_color) {
+      source.colors.insert(source.colors.end(), colors[key[0]].begin(), colors[key[0]].end());
+    }
+    if (has_uv) {
+      source.uvs.insert(source.uvs.end(), uvs[key[1]].begin(), uvs[key[1]].end());
+    }
+    if (has_normal) {
+      source.normals.insert(source.normals.end(), normals[key[2]].begin(), normals[key[2]].end());
+    }
+  }
+  source.indices = std::move(indices);
+  return source;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  if (argc < 3) {
+    return usage();
+  }
+  try {
+    const auto lods = argc > 3 ? std::atoi(argv[3]) : 4;
+    if (lods < 1) {
+      return usage();
+    }
+    const auto source = load(std::filesystem::path(argv[1]));
+    const auto data = ice::build_mesh(source, static_cast<std::size_t>(lods));
+
+    std::ofstream os(std::filesystem::path(argv[2]), std::ios::binary);
+    os.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    if (!os) {
+      throw ice::runtime_error("Could not write file.") << argv[2];
+    }
+
+    // Report the vertex sizes and the cache efficiency of every level of detail.
+    const ice::mesh_view mesh(data.data(), data.size());
+    const auto& header = mesh.header();
+    const auto floats = 3 + source.normals.size() / (source.positions.size() / 3) +
+      source.uvs.size() / (source.positions.size() / 3) + source.colors.size() / (source.positions.size() / 3);
+    std::cout << "vertices: " << header.vertices << " x " << header.stride << " bytes (" << floats * 4 << " unquantized)\n"
+              << "radius: " << header.radius << '\n'
+              << "acmr: " << std::fixed << std::setprecision(3)
+              << ice::mesh_acmr(source.indices.data(), source.indices.size(), source.positions.size() / 3) << " unoptimized\n";
+    std::vector<std::uint32_t> indices;
+    for (std::uint32_t i = 0; i < header.lods; i++) {
+      const auto& lod = mesh.lods()[i];
+      indices.resize(lod.count);
+      for (std::uint32_t j = 0; j < lod.count; j++) {
+        const auto src = mesh.indices() + (lod.first + j) * header.index_size;
+        indices[j] = header.index_size == 2 ? *reinterpret_cast<const std::uint16_t*>(src) : *reinterpret_cast<const std::uint32_t*>(src);
+      }
+      std::cout << "lod " << i << ": " << lod.count / 3 << " triangles, error " << lod.error
+                << ", acmr " << ice::mesh_acmr(indices.data(), indices.size(), header.vertices) << '\n';
+    }
+    std::cout << std::flush;
+  }
+  catch (const ice::exception& e) {
+    std::cerr << e.what() << std::endl;
+    if (auto info = e.info()) {
+      std::cerr << info << std::endl;
+    }
+    return 1;
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,523 @@
+#include <ice/exception.h>
+#include <ice/net/download.h>
+#include <ice/net/pool.h>
+#include <ice/net/transport.h>
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+#include <openssl/sha.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+int usage()
+{
+  std::cerr << "usage: net soak [seconds] [loss] [latency ms] [jitter ms]\n"
+            << "       net tls [handshakes]\n"
+            << "       net download [MiB]" << std::endl;
+  return 2;
+}
+
+// Returns the given percentile of the samples.
+double percentile(std::vector<double>& samples, double p)
+{
+  if (samples.empty()) {
+    return 0.0;
+  }
+  const auto n = static_cast<std::size_t>(p * static_cast<double>(samples.size() - 1));
+  std::nth_element(samples.begin(), samples.begin() + n, samples.end());
+  return samples[n];
+}
+
+// Sends reliable and unreliable messages between two transports over 127.0.0.1 and reports the
+// packet rate and the delivery latency. Fails if a reliable message is lost or delivered out of order.
+void soak(double seconds, double loss, double latency, double jitter)
+{
+  using ice::net::transport;
+  transport::options options;
+  options.loss = loss;
+  options.latency = std::chrono::microseconds(static_cast<std::int64_t>(latency * 1000.0));
+  options.jitter = std::chrono::microseconds(static_cast<std::int64_t>(jitter * 1000.0));
+  transport server(options);
+  transport client(options);
+
+  // Messages carry a sequence number and the send time.
+  struct payload {
+    std::uint32_t sequence;
+    std::int64_t time;
+  };
+  constexpr std::uint8_t unreliable = 0;
+  constexpr std::uint8_t reliable = 2;
+  constexpr std::uint32_t window = 1024;
+
+  const auto peer = client.connect("127.0.0.1", server.port());
+  transport::peer remote = 0;
+  std::uint32_t sent = 0;
+  std::uint32_t received = 0;
+  std::uint64_t unreliable_sent = 0;
+  std::uint64_t unreliable_received = 0;
+  std::vector<double> latencies;
+
+  auto start = transport::clock::now();
+  auto connected = false;
+  while (transport::clock::now() - start < std::chrono::duration<double>(seconds)) {
+    client.update();
+    server.update();
+    if (!remote) {
+      server.accept(remote);
+    }
+    if (!connected && client.connected(peer)) {
+      connected = true;
+      start = transport::clock::now();
+    }
+
+    // Keep a bounded number of reliable messages in flight.
+    if (connected) {
+      for (auto i = 0; i < 16 && sent - received < window; i++, sent++) {
+        payload data = {};
+        data.sequence = sent;
+        data.time = transport::clock::now().time_since_epoch().count();
+        client.send(peer, reliable, &data, sizeof(data));
+        client.send(peer, unreliable, &data, sizeof(data));
+        unreliable_sent++;
+      }
+    }
+
+    transport::message message;
+    while (server.receive(message)) {
+      payload data = {};
+      if (message.data.size() != sizeof(data)) {
+        throw std::runtime_error("Invalid message size.");
+      }
+      std::memcpy(&data, message.data.data(), sizeof(data));
+      if (message.channel == reliable) {
+        if (data.sequence != received) {
+          throw std::runtime_error("Reliable message out of order: " + std::to_string(data.sequence) +
+            " instead of " + std::to_string(received));
+        }
+        received++;
+        const auto time = transport::clock::now().time_since_epoch().count() - data.time;
+        latencies.push_back(std::chrono::duration<double, std::milli>(transport::clock::duration(time)).count());
+      } else {
+        unreliable_received++;
+      }
+    }
+    while (client.receive(message)) {
+    }
+    std::this_thread::yield();
+  }
+  if (!connected) {
+    throw std::runtime_error("Could not connect over 127.0.0.1.");
+  }
+  const auto time = std::chrono::duration<double>(transport::clock::now() - start).count();
+
+  const auto cs = client.stats(peer);
+  const auto ss = server.stats(remote);
+  std::cout << std::fixed << std::setprecision(0)
+            << "packets/s:     " << (cs.packets_sent + ss.packets_sent) / time << '\n'
+            << "messages/s:    " << received / time << " reliable, " << unreliable_received / time << " unreliable\n"
+            << "delivered:     " << received << " of " << sent << " reliable, " << unreliable_received << " of "
+            << unreliable_sent << " unreliable\n"
+            << "lost packets:  " << cs.packets_lost << " (" << cs.messages_resent << " messages resent)\n"
+            << std::setprecision(2)
+            << "latency p50:   " << percentile(latencies, 0.5) << " ms\n"
+            << "latency p99:   " << percentile(latencies, 0.99) << " ms\n"
+            << "rtt p99:       " << std::chrono::duration<double, std::milli>(cs.rtt_p99).count() << " ms" << std::endl;
+}
+
+// Accepts TLS connections on 127.0.0.1 with a self-signed certificate and keeps them open until the client
+// closes them. The session cache and session tickets of the context are enabled by default.
+class tls_server {
+public:
+  explicit tls_server(asio::io_service& io) :
+    context_(asio::ssl::context::sslv23_server),
+    acceptor_(io, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0))
+  {
+    certificate();
+    accept();
+  }
+
+  std::uint16_t port() const
+  {
+    return acceptor_.local_endpoint().port();
+  }
+
+private:
+  using stream = asio::ssl::stream<asio::ip::tcp::socket>;
+
+  // Creates a P-256 key and a self-signed certificate for the context.
+  void certificate()
+  {
+    std::unique_ptr<EVP_PKEY, void (*)(EVP_PKEY*)> key(EVP_PKEY_new(), EVP_PKEY_free);
+    std::unique_ptr<X509, void (*)(X509*)> x509(X509_new(), X509_free);
+    auto ec_key = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
+    if (!key || !x509 || !ec_key || !EC_KEY_generate_key(ec_key) || !EVP_PKEY_assign_EC_KEY(key.get(), ec_key)) {
+      EC_KEY_free(ec_key);
+      throw ice::runtime_error("Could not create the server key.");
+    }
+    auto name = X509_get_subject_name(x509.get());
+    X509_set_version(x509.get(), 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(x509.get()), 1);
+    X509_gmtime_adj(X509_get_notBefore(x509.get()), 0);
+    X509_gmtime_adj(X509_get_notAfter(x509.get()), 24 * 60 * 60);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0);
+    X509_set_issuer_name(x509.get(), name);
+    X509_set_pubkey(x509.get(), key.get());
+    if (!X509_sign(x509.get(), key.get(), EVP_sha256()) ||
+      SSL_CTX_use_certificate(context_.native_handle(), x509.get()) != 1 ||
+      SSL_CTX_use_PrivateKey(context_.native_handle(), key.get()) != 1) {
+      throw ice::runtime_error("Could not create the server certificate.");
+    }
+  }
+
+  void accept()
+  {
+    auto s = std::make_shared<stream>(acceptor_.get_io_service(), context_);
+    acceptor_.async_accept(s->lowest_layer(), [this, s](const std::error_code& ec) {
+      if (ec) {
+        return;
+      }
+      s->async_handshake(asio::ssl::stream_base::server, [s](const std::error_code& ec) {
+        if (ec) {
+          return;
+        }
+        auto buffer = std::make_shared<std::array<char, 1>>();
+        s->async_read_some(asio::buffer(*buffer), [s, buffer](const std::error_code&, std::size_t) {});
+      });
+      accept();
+    });
+  }
+
+  asio::ssl::context context_;
+  asio::ip::tcp::acceptor acceptor_;
+};
+
+// Opens connections to the server one after another through a pool and closes them after the handshake.
+// Returns the handshakes per second and the number of connections whose TLS session was reused.
+double handshakes(asio::io_service& io, std::uint16_t port, bool resume, std::size_t count, std::size_t& resumed)
+{
+  ice::net::pool::options options;
+  options.verify = false;
+  options.resume = resume;
+  ice::net::pool pool(io, options);
+
+  std::size_t done = 0;
+  std::error_code error;
+  std::function<void()> next = [&]() {
+    pool.acquire("127.0.0.1", std::to_string(port), [&](const std::error_code& ec, std::shared_ptr<ice::net::connection> c) {
+      if (ec) {
+        error = ec;
+        return;
+      }
+      if (SSL_session_reused(c->stream().native_handle()) == 1) {
+        resumed++;
+      }
+      pool.release(c, false);
+      if (++done < count) {
+        next();
+      }
+    });
+  };
+  const auto start = std::chrono::steady_clock::now();
+  next();
+  while (done < count && !error) {
+    io.run_one();
+  }
+  const auto time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  if (error) {
+    throw ice::runtime_error("Could not connect to the TLS server.") << error.message();
+  }
+  return count / time;
+}
+
+// Measures full and resumed TLS handshakes against a local server. Client and server share one thread.
+// Fails unless every connection after the first one resumes the session when resumption is enabled.
+void tls(std::size_t count)
+{
+  SSL_library_init();
+  asio::io_service io;
+  tls_server server(io);
+
+  std::size_t full_resumed = 0;
+  const auto full = handshakes(io, server.port(), false, count, full_resumed);
+  if (full_resumed != 0) {
+    throw ice::runtime_error("Resumed a TLS session with resumption disabled.") << "Resumed: " << full_resumed;
+  }
+
+  std::size_t resumed = 0;
+  const auto fast = handshakes(io, server.port(), true, count, resumed);
+  if (resumed != count - 1) {
+    throw ice::runtime_error("TLS sessions were not resumed.") << "Resumed: " << resumed << " of " << count - 1;
+  }
+
+  std::cout << std::fixed << std::setprecision(0)
+            << "full:     " << full << " handshakes/s\n"
+            << "resumed:  " << fast << " handshakes/s (" << resumed << " of " << count << " connections resumed)\n"
+            << std::setprecision(1)
+            << "speedup:  " << fast / full << 'x' << std::endl;
+}
+
+// Serves a file over plain HTTP on 127.0.0.1 with range requests. Closes the first connections right after
+// accepting them and drops every nth range response halfway through the body to exercise download retries.
+class http_server {
+public:
+  http_server(asio::io_service& io, const std::vector<std::uint8_t>& data, std::size_t refuse, std::size_t drop) :
+    acceptor_(io, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0)),
+    data_(data), refuse_(refuse), drop_(drop)
+  {
+    accept();
+  }
+
+  std::uint16_t port() const
+  {
+    return acceptor_.local_endpoint().port();
+  }
+
+  // Returns the number of closed connections.
+  std::size_t refused() const noexcept
+  {
+    return refused_;
+  }
+
+  // Returns the number of responses that were cut off.
+  std::size_t dropped() const noexcept
+  {
+    return dropped_;
+  }
+
+private:
+  struct session {
+    explicit session(asio::io_service& io) : socket(io) {}
+    asio::ip::tcp::socket socket;
+    asio::streambuf input;
+    std::string output;
+  };
+
+  void accept()
+  {
+    auto s = std::make_shared<session>(acceptor_.get_io_service());
+    acceptor_.async_accept(s->socket, [this, s](const std::error_code& ec) {
+      if (ec) {
+        return;
+      }
+      if (refused_ < refuse_) {
+        refused_++;
+        s->socket.close();
+      } else {
+        read(s);
+      }
+      accept();
+    });
+  }
+
+  void read(std::shared_ptr<session> s)
+  {
+    asio::async_read_until(s->socket, s->input, "\r\n\r\n", [this, s](const std::error_code& ec, std::size_t size) {
+      if (ec) {
+        return;
+      }
+      const auto begin = asio::buffers_begin(s->input.data());
+      std::string header(begin, begin + static_cast<std::ptrdiff_t>(size));
+      s->input.consume(size);
+      respond(s, header);
+    });
+  }
+
+  void respond(std::shared_ptr<session> s, const std::string& header)
+  {
+    std::ostringstream oss;
+    std::size_t begin = 0;
+    std::size_t end = 0;
+    auto drop = false;
+    if (header.compare(0, 5, "HEAD ") == 0) {
+      oss << "HTTP/1.1 200 OK\r\nContent-Length: " << data_.size() << "\r\nAccept-Ranges: bytes\r\n\r\n";
+    } else {
+      unsigned long long first = 0;
+      unsigned long long last = 0;
+      const auto range = header.find("Range: bytes=");
+      if (range == std::string::npos ||
+        std::sscanf(header.c_str() + range, "Range: bytes=%llu-%llu", &first, &last) != 2 ||
+        first > last || last >= data_.size()) {
+        oss << "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Length: 0\r\n\r\n";
+      } else {
+        begin = static_cast<std::size_t>(first);
+        end = static_cast<std::size_t>(last + 1);
+        oss << "HTTP/1.1 206 Partial Content\r\nContent-Length: " << end - begin << "\r\n"
+            << "Content-Range: bytes " << first << '-' << last << '/' << data_.size() << "\r\n\r\n";
+        if (drop_ && ++responses_ % drop_ == 0) {
+          end = begin + (end - begin) / 2;
+          drop = true;
+        }
+      }
+    }
+    s->output = oss.str();
+    s->output.append(data_.begin() + begin, data_.begin() + end);
+    asio::async_write(s->socket, asio::buffer(s->output), [this, s, drop](const std::error_code& ec, std::size_t) {
+      if (ec) {
+        return;
+      }
+      if (drop) {
+        dropped_++;
+        s->socket.close();
+        return;
+      }
+      read(s);
+    });
+  }
+
+  asio::ip::tcp::acceptor acceptor_;
+  const std::vector<std::uint8_t>& data_;
+  std::size_t refuse_ = 0;
+  std::size_t drop_ = 0;
+  std::size_t refused_ = 0;
+  std::size_t dropped_ = 0;
+  std::size_t responses_ = 0;
+};
+
+// Downloads the data from a flaky local server and returns the result, the cause and the time in seconds.
+double fetch(const std::vector<std::uint8_t>& data, const std::string& sha256, const std::filesystem::path& file,
+  std::size_t refuse, std::size_t drop, std::size_t retries, std::error_code& ec, std::error_code& cause,
+  std::size_t& dropped)
+{
+  asio::io_service io;
+  http_server server(io, data, refuse, drop);
+  std::thread thread([&]() {
+    io.run();
+  });
+
+  ice::net::download::options options;
+  options.host = "127.0.0.1";
+  options.port = std::to_string(server.port());
+  options.tls = false;
+  options.chunk = 256 * 1024;
+  options.retries = retries;
+
+  std::promise<std::pair<std::error_code, std::error_code>> result;
+  const auto start = std::chrono::steady_clock::now();
+  {
+    ice::net::download download(options);
+    download.start("/file", file, sha256, {}, [&](std::error_code ec, std::error_code cause) {
+      result.set_value({ ec, cause });
+    });
+    std::tie(ec, cause) = result.get_future().get();
+  }
+  const auto time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  io.stop();
+  thread.join();
+  dropped = server.dropped();
+  return time;
+}
+
+// Downloads a file from a local HTTP server that refuses the first connections and cuts off responses.
+// Fails unless the download succeeds after backing off with enough retries and reports the connection
+// error behind too_many_failures without them.
+void download(std::size_t size)
+{
+  std::vector<std::uint8_t> data(size);
+  std::mt19937 random;
+  std::generate(data.begin(), data.end(), [&]() {
+    return static_cast<std::uint8_t>(random());
+  });
+  std::uint8_t digest[SHA256_DIGEST_LENGTH] = {};
+  SHA256(data.data(), data.size(), digest);
+  std::ostringstream sha256;
+  for (auto c : digest) {
+    sha256 << std::hex << std::setw(2) << std::setfill('0') << static_cast<unsigned>(c);
+  }
+  const auto file = std::filesystem::temp_directory_path() / "ice-net-download.bin";
+  std::error_code remove_ec;
+  std::filesystem::remove(file, remove_ec);
+
+  // The first connections fail one after another, so the retries back off by 200, 400 and 800 ms.
+  constexpr std::size_t refuse = 3;
+  constexpr double backoff = 1.4;
+  std::error_code ec;
+  std::error_code cause;
+  std::size_t dropped = 0;
+  const auto time = fetch(data, sha256.str(), file, refuse, 16, 8, ec, cause, dropped);
+  if (ec) {
+    throw ice::runtime_error("Could not download the file.") << ec.message() << "\nCause: " << cause.message();
+  }
+  std::ifstream is(file, std::ios::binary);
+  std::vector<std::uint8_t> copy((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+  is.close();
+  std::filesystem::remove(file, remove_ec);
+  if (copy != data) {
+    throw ice::runtime_error("The downloaded file does not match the served data.");
+  }
+  if (time < backoff) {
+    throw ice::runtime_error("The download did not back off.") << "Time: " << time << " s";
+  }
+  std::cout << std::fixed << std::setprecision(2)
+            << "download:  " << size / (1024.0 * 1024.0) / time << " MiB/s in " << time << " s (" << refuse
+            << " refused connections, " << dropped << " dropped responses, " << backoff << " s backoff)\n";
+
+  // Give up before the server accepts a connection.
+  const auto fail_time = fetch(data, sha256.str(), file, refuse, 0, refuse - 1, ec, cause, dropped);
+  std::filesystem::remove(file, remove_ec);
+  std::filesystem::path part = file;
+  std::filesystem::remove(part += ".part", remove_ec);
+  if (ec != ice::net::download_errc::too_many_failures || !cause) {
+    throw ice::runtime_error("The download did not give up after too many failures.")
+      << "Error: " << ec.message() << "\nCause: " << cause.message();
+  }
+  std::cout << "give up:   " << fail_time << " s after " << refuse << " failures (cause: " << cause.category().name()
+            << ' ' << cause.value() << ", " << cause.message() << ')' << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2) {
+    return usage();
+  }
+  try {
+    std::string command = argv[1];
+    const auto arg = [&](int index, double value) {
+      return argc > index ? std::atof(argv[index]) : value;
+    };
+    if (command == "soak" && argc <= 6) {
+      soak(arg(2, 10.0), arg(3, 0.0), arg(4, 0.0), arg(5, 0.0));
+    } else if (command == "tls" && argc <= 3) {
+      tls(static_cast<std::size_t>(std::max(arg(2, 200.0), 2.0)));
+    } else if (command == "download" && argc <= 3) {
+      download(static_cast<std::size_t>(std::max(arg(2, 16.0), 1.0) * 1024 * 1024));
+    } else {
+      return usage();
+    }
+  }
+  catch (const ice::exception& e) {
+    std::cerr << e.what() << std::endl;
+    if (auto info = e.info()) {
+      std::cerr << info << std::endl;
+    }
+    return 1;
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
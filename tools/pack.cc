@@ -0,0 +1,121 @@
+#include <ice/archive.h>
+#include <ice/codec.h>
+#include <ice/exception.h>
+#include <ice/pack.h>
+#include <ice/patch.h>
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+namespace {
+
+int usage()
+{
+  std::cerr << "usage: pack create <directory> <pack> [trace]\n"
+            << "       pack diff <source> <target> <patch>\n"
+            << "       pack apply <pack> <patch>\n"
+            << "       pack bench <pack> [iterations]" << std::endl;
+  return 2;
+}
+
+void report(const std::string& name, std::uint64_t bytes, std::chrono::duration<double> time)
+{
+  std::cout << std::left << std::setw(12) << name << std::right << std::fixed << std::setprecision(1)
+            << std::setw(10) << bytes / time.count() / 1000000.0 << " MB/s" << std::endl;
+}
+
+// Measures the decompression throughput of every codec and the CRC-32 throughput over all pack entries.
+void bench(const std::filesystem::path& pack, int iterations)
+{
+  using clock = std::chrono::high_resolution_clock;
+  ice::archive archive(pack);
+  const auto files = archive.list();
+
+  std::vector<ice::archive::buffer> buffers;
+  for (const auto& name : ice::codecs()) {
+    archive.codec(name);
+    buffers.clear();
+    std::uint64_t bytes = 0;
+    const auto start = clock::now();
+    for (int i = 0; i < iterations; i++) {
+      buffers.clear();
+      for (const auto& file : files) {
+        buffers.push_back(archive.load<ice::archive::buffer>(std::filesystem::path(file)));
+        bytes += buffers.back()->size();
+      }
+    }
+    report(name, bytes, clock::now() - start);
+  }
+
+  // Every checksum must match the checksum of the same buffer in the first iteration of the first loop.
+  std::vector<std::uint32_t> checksums;
+  const auto check = [&](std::size_t index, std::uint32_t crc) {
+    if (crc != checksums[index]) {
+      throw ice::runtime_error("CRC-32 mismatch.") << "Buffer: " << index;
+    }
+  };
+
+  std::uint64_t bytes = 0;
+  auto start = clock::now();
+  for (int i = 0; i < iterations; i++) {
+    for (std::size_t j = 0; j < buffers.size(); j++) {
+      const auto crc = ice::crc32(0, buffers[j]->data(), buffers[j]->size());
+      if (i == 0) {
+        checksums.push_back(crc);
+      }
+      check(j, crc);
+      bytes += buffers[j]->size();
+    }
+  }
+  report("crc32", bytes, clock::now() - start);
+
+  bytes = 0;
+  start = clock::now();
+  for (int i = 0; i < iterations; i++) {
+    for (std::size_t j = 0; j < buffers.size(); j++) {
+      check(j, ice::crc32_table(0, buffers[j]->data(), buffers[j]->size()));
+      bytes += buffers[j]->size();
+    }
+  }
+  report("crc32 table", bytes, clock::now() - start);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2) {
+    return usage();
+  }
+  try {
+    std::string command = argv[1];
+    if (command == "create" && (argc == 4 || argc == 5)) {
+      ice::create_pack(argv[2], argv[3], argc == 5 ? argv[4] : "");
+    } else if (command == "diff" && argc == 5) {
+      ice::create_patch(argv[2], argv[3], argv[4]);
+    } else if (command == "apply" && argc == 4) {
+      ice::apply_patch(argv[2], argv[3]);
+    } else if (command == "bench" && (argc == 3 || argc == 4)) {
+      bench(argv[2], argc == 4 ? std::max(std::atoi(argv[3]), 1) : 10);
+    } else {
+      return usage();
+    }
+  }
+  catch (const ice::exception& e) {
+    std::cerr << e.what() << std::endl;
+    if (auto info = e.info()) {
+      std::cerr << info << std::endl;
+    }
+    return 1;
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}